@@ -4,6 +4,10 @@ import android.support.annotation.Keep;
 
 import java.io.Closeable;
 import java.io.File;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.ShortBuffer;
+import java.util.Locale;
 
 public class OpenJTalk implements Closeable {
 
@@ -11,6 +15,71 @@ public class OpenJTalk implements Closeable {
         System.loadLibrary("open-jtalk");
     }
 
+    //-----------------------------------------------------------------
+    //  Interfaces
+    //-----------------------------------------------------------------
+
+    public interface AudioListener {
+        /**
+         * Receives a block of synthesized 16bit PCM samples.
+         * The buffer refers to native memory and is valid only during this call.
+         */
+        void onAudio(ShortBuffer samples);
+    }
+
+    public interface RequestListener {
+        /**
+         * Called once per submitted request on the synthesis thread.
+         * success is false when the request failed or was cancelled.
+         */
+        void onComplete(int id, boolean success);
+    }
+
+    /**
+     * Time in milliseconds spent in each stage of the last utterance and the
+     * work done. Stages that did not run, e.g. text analysis on a label cache
+     * hit, are 0.
+     */
+    @Keep
+    public static class Stats {
+        public double text2mecab;
+        public double mecab;
+        public double mecab2njd;
+        public double njdPronunciation;
+        public double njdDigit;
+        public double njdAccentPhrase;
+        public double njdAccentType;
+        public double njdUnvoicedVowel;
+        public double njdLongVowel;
+        public double njd2jpcommon;
+        public double makeLabel;
+        public double flite;
+        public double stateSequence;
+        public double parameterSequence;
+        public double sampleSequence;
+        public int labels;
+        public int states;
+        public int frames;
+        public int samples;
+        public int latticeNodes;
+        public int questions;
+        public int gvIterations;
+
+        @Override
+        public String toString() {
+            return String.format(Locale.US,
+                    "text2mecab=%.2f mecab=%.2f mecab2njd=%.2f njd=%.2f/%.2f/%.2f/%.2f/%.2f/%.2f"
+                            + " njd2jpcommon=%.2f makeLabel=%.2f flite=%.2f"
+                            + " state=%.2f parameter=%.2f sample=%.2f"
+                            + " labels=%d states=%d frames=%d samples=%d latticeNodes=%d questions=%d"
+                            + " gvIterations=%d",
+                    text2mecab, mecab, mecab2njd, njdPronunciation, njdDigit, njdAccentPhrase,
+                    njdAccentType, njdUnvoicedVowel, njdLongVowel, njd2jpcommon, makeLabel, flite,
+                    stateSequence, parameterSequence, sampleSequence,
+                    labels, states, frames, samples, latticeNodes, questions, gvIterations);
+        }
+    }
+
     //-----------------------------------------------------------------
     //  Instance variables
     //-----------------------------------------------------------------
@@ -105,6 +174,94 @@ public class OpenJTalk implements Closeable {
         nativeSetAudioBufferSize(instance, value);
     }
 
+    /**
+     * Memory budget in bytes for cached text analysis results; 0 disables the cache.
+     */
+    public int getLabelCacheSize() {
+        return nativeGetLabelCacheSize(instance);
+    }
+
+    public void setLabelCacheSize(int value) {
+        nativeSetLabelCacheSize(instance, value);
+    }
+
+    public long getLabelCacheHits() {
+        return nativeGetLabelCacheHits(instance);
+    }
+
+    public long getLabelCacheMisses() {
+        return nativeGetLabelCacheMisses(instance);
+    }
+
+    /**
+     * Number of full-context labels whose decision tree results are kept; 0 disables the cache.
+     */
+    public int getPdfCacheSize() {
+        return nativeGetPdfCacheSize(instance);
+    }
+
+    public void setPdfCacheSize(int value) {
+        nativeSetPdfCacheSize(instance, value);
+    }
+
+    public long getPdfCacheHits() {
+        return nativeGetPdfCacheHits(instance);
+    }
+
+    public long getPdfCacheMisses() {
+        return nativeGetPdfCacheMisses(instance);
+    }
+
+    /**
+     * Number of threads parameter generation runs on; 1 (the default) uses the calling
+     * thread only. Larger values have not been shown to be faster, so leave it at 1 unless
+     * it measures faster on the target device.
+     */
+    public int getNumThreads() {
+        return nativeGetNumThreads(instance);
+    }
+
+    public void setNumThreads(int value) {
+        nativeSetNumThreads(instance, value);
+    }
+
+    /**
+     * Relative change of the GV objective under which a dimension stops iterating; 0 always runs all iterations.
+     */
+    public double getGvTolerance() {
+        return nativeGetGvTolerance(instance);
+    }
+
+    public void setGvTolerance(double value) {
+        nativeSetGvTolerance(instance, value);
+    }
+
+    /**
+     * Frames of parameters generated ahead of the audio being synthesized, so that the first
+     * chunk does not wait for the whole utterance; 0 generates the whole utterance at once.
+     * Fewer frames than 5 band widths of the dynamic windows (15 for windows of +-1 frame)
+     * are raised to that. An utterance not longer than the lookahead is generated at once.
+     */
+    public int getLookahead() {
+        return nativeGetLookahead(instance);
+    }
+
+    public void setLookahead(int value) {
+        nativeSetLookahead(instance, value);
+    }
+
+    public Stats getLastStats() {
+        return nativeGetLastStats(instance);
+    }
+
+    public long getWaveCacheHits() {
+        return nativeGetWaveCacheHits(instance);
+    }
+
+    public long getWaveCacheMisses() {
+        return nativeGetWaveCacheMisses(instance);
+    }
+
     //-----------------------------------------------------------------
     //  Operations
     //-----------------------------------------------------------------
@@ -113,6 +270,15 @@ public class OpenJTalk implements Closeable {
         return nativeLoad(instance, lang, (dict != null) ? dict.getAbsolutePath() : null, voice.getAbsolutePath());
     }
 
+    /**
+     * Stores synthesized speech in dir, using at most maxBytes, so that a text
+     * spoken again under the same conditions is played without synthesis.
+     * A null dir disables the cache.
+     */
+    public boolean setWaveCache(File dir, long maxBytes) {
+        return nativeSetWaveCache(instance, (dir != null) ? dir.getAbsolutePath() : null, maxBytes);
+    }
+
     public boolean talk(String text) {
         return talk(text, null, null);
     }
@@ -121,6 +287,84 @@ public class OpenJTalk implements Closeable {
         return nativeTalk(instance, text, (waveFile != null) ? waveFile.getAbsolutePath() : null, (logFile != null) ? logFile.getAbsolutePath() : null);
     }
 
+    /**
+     * Synthesizes text and returns 16bit PCM samples, or null on failure.
+     * Nothing is played through the audio device.
+     */
+    public short[] talkToBuffer(String text) {
+        return nativeTalkToBuffer(instance, text);
+    }
+
+    /**
+     * Synthesizes each text in one native call. An element of the result
+     * is null when the corresponding text could not be synthesized.
+     * Nothing is played through the audio device.
+     */
+    public short[][] talkBatch(String[] texts) {
+        return nativeTalkBatch(instance, texts);
+    }
+
+    public boolean talk(String text, AudioListener listener) {
+        return talk(text, listener, getSamplingFrequency() / 20);
+    }
+
+    public boolean talk(String text, AudioListener listener, int bufferSize) {
+        return nativeTalkStream(instance, text, listener, bufferSize);
+    }
+
+    /**
+     * Synthesizes text of any length sentence by sentence, so that memory
+     * use is bounded by the longest sentence. Audio is delivered to the
+     * listener as each sentence is synthesized. Returns false if any sentence
+     * with something to say fails, even though the others are still played.
+     */
+    public boolean talkDocument(String text, AudioListener listener) {
+        return talkDocument(text, listener, getSamplingFrequency() / 20);
+    }
+
+    public boolean talkDocument(String text, AudioListener listener, int bufferSize) {
+        return nativeTalkDocument(instance, text, listener, bufferSize);
+    }
+
+    /**
+     * Queues text for synthesis on a native worker thread and plays it
+     * through the audio device. Requests are synthesized sentence by
+     * sentence like talkDocument(). Returns a request id, or 0 on failure.
+     * One call runs on an instance at a time: load(), the talk methods and
+     * the property accessors wait while the worker synthesizes a request,
+     * and the worker waits for them. A property changed while requests are
+     * pending applies to those that start after it. cancel() and submit()
+     * never wait for synthesis.
+     */
+    public int submit(String text, RequestListener listener) {
+        return nativeSubmit(instance, text, null, listener, 0);
+    }
+
+    public int submit(String text, AudioListener audio, RequestListener listener) {
+        return submit(text, audio, listener, getSamplingFrequency() / 20);
+    }
+
+    public int submit(String text, AudioListener audio, RequestListener listener, int bufferSize) {
+        return nativeSubmit(instance, text, audio, listener, bufferSize);
+    }
+
+    /**
+     * Drops a pending request or stops the one being synthesized.
+     */
+    public boolean cancel(int id) {
+        return nativeCancel(instance, id);
+    }
+
+    @Keep
+    private static void dispatchComplete(RequestListener listener, int id, boolean success) {
+        listener.onComplete(id, success);
+    }
+
+    @Keep
+    private static void dispatchAudio(AudioListener listener, ByteBuffer buffer) {
+        listener.onAudio(buffer.order(ByteOrder.nativeOrder()).asShortBuffer());
+    }
+
     //-----------------------------------------------------------------
     //  natives
     //-----------------------------------------------------------------
@@ -161,7 +405,55 @@ public class OpenJTalk implements Closeable {
 
     private native static void nativeSetAudioBufferSize(long instance, int value);
 
+    private native static int nativeGetLabelCacheSize(long instance);
+
+    private native static void nativeSetLabelCacheSize(long instance, int value);
+
+    private native static long nativeGetLabelCacheHits(long instance);
+
+    private native static long nativeGetLabelCacheMisses(long instance);
+
+    private native static int nativeGetPdfCacheSize(long instance);
+
+    private native static void nativeSetPdfCacheSize(long instance, int value);
+
+    private native static long nativeGetPdfCacheHits(long instance);
+
+    private native static long nativeGetPdfCacheMisses(long instance);
+
+    private native static int nativeGetNumThreads(long instance);
+
+    private native static void nativeSetNumThreads(long instance, int value);
+
+    private native static double nativeGetGvTolerance(long instance);
+
+    private native static void nativeSetGvTolerance(long instance, double value);
+
+    private native static int nativeGetLookahead(long instance);
+
+    private native static void nativeSetLookahead(long instance, int value);
+
+    private native static Stats nativeGetLastStats(long instance);
+
+    private native static boolean nativeSetWaveCache(long instance, String dir, long size);
+
+    private native static long nativeGetWaveCacheHits(long instance);
+
+    private native static long nativeGetWaveCacheMisses(long instance);
+
     private native static boolean nativeLoad(long instance, String lang, String dirMecab, String fnVoice);
 
     private native static boolean nativeTalk(long instance, String text, String waveFile, String logFile);
+
+    private native static boolean nativeTalkStream(long instance, String text, AudioListener listener, int bufferSize);
+
+    private native static boolean nativeTalkDocument(long instance, String text, AudioListener listener, int bufferSize);
+
+    private native static short[] nativeTalkToBuffer(long instance, String text);
+
+    private native static short[][] nativeTalkBatch(long instance, String[] texts);
+
+    private native static int nativeSubmit(long instance, String text, AudioListener audio, RequestListener listener, int bufferSize);
+
+    private native static boolean nativeCancel(long instance, int id);
 }
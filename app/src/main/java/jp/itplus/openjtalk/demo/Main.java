@@ -50,6 +50,8 @@ public final class Main {
     public interface TalkInterface {
         void talk(String msg);
 
+        void stop();
+
         void setTalkFinishedListener(TalkFinishedListener listener);
     }
 
@@ -64,7 +66,7 @@ public final class Main {
         IDLE;
     }
 
-    public static class MainActivity extends Activity implements Handler.Callback, TalkInterface, LanguageSelectListener {
+    public static class MainActivity extends Activity implements Handler.Callback, TalkInterface, LanguageSelectListener, OpenJTalk.RequestListener {
 
         private enum Messages {
             INITIALIZE,
@@ -93,6 +95,7 @@ public final class Main {
         private Exception error;
         private TalkFinishedListener talkFinished;
         private String lang;
+        private int request;
 
         @Override
         public void onCreate(Bundle state) {
@@ -161,7 +164,24 @@ public final class Main {
 
         @Override
         public void talk(String text) {
-            handler.obtainMessage(Messages.TALK.value(), text).sendToTarget();
+            if (DEBUG_TALK) {
+                handler.obtainMessage(Messages.TALK.value(), text).sendToTarget();
+                return;
+            }
+            request = jtalk.submit(text, this);
+            if (request == 0)
+                notifyTalkFinished(false);
+        }
+
+        @Override
+        public void stop() {
+            if (request != 0)
+                jtalk.cancel(request);
+        }
+
+        @Override
+        public void onComplete(int id, boolean success) {
+            notifyTalkFinished(success);
         }
 
         @Override
@@ -226,18 +246,18 @@ public final class Main {
         }
 
         private void doTalk(String text) {
-            if (DEBUG_TALK) {
-                File dir = new File(getFilesDir(), "log");
-                dir.mkdirs();
-                boolean success = jtalk.talk(text, new File(dir, "wave.riff"), new File(dir, "log.txt"));
-                ui.obtainMessage(Messages.UI_TALK_FINISHED.value(), success ? 1 : 0, 0).sendToTarget();
-            } else {
-                boolean success = jtalk.talk(text);
-                ui.obtainMessage(Messages.UI_TALK_FINISHED.value(), success ? 1 : 0, 0).sendToTarget();
-            }
+            File dir = new File(getFilesDir(), "log");
+            dir.mkdirs();
+            boolean success = jtalk.talk(text, new File(dir, "wave.riff"), new File(dir, "log.txt"));
+            notifyTalkFinished(success);
+        }
+
+        private void notifyTalkFinished(boolean success) {
+            ui.obtainMessage(Messages.UI_TALK_FINISHED.value(), success ? 1 : 0, 0).sendToTarget();
         }
 
         private void doTalkFinished(boolean success) {
+            request = 0;
             if (talkFinished != null)
                 talkFinished.onTalkFinished(success);
         }
@@ -333,6 +353,7 @@ public final class Main {
         TextView error;
         Button button;
         ProgressBar progress;
+        boolean talking;
 
         @Override
         public void onAttach(Activity context) {
@@ -363,7 +384,10 @@ public final class Main {
 
         @Override
         public void onClick(View v) {
-            if (talk != null) {
+            if (talking) {
+                if (talk != null)
+                    talk.stop();
+            } else if (talk != null) {
                 setEnabled(false);
                 error.setText(null);
                 talk.setTalkFinishedListener(this);
@@ -392,7 +416,8 @@ public final class Main {
         }
 
         private void setEnabled(boolean enabled) {
-            button.setEnabled(enabled);
+            talking = !enabled;
+            button.setText(enabled ? R.string.button_talk : R.string.button_stop);
             text.setEnabled(enabled);
             progress.setVisibility(enabled ? View.GONE : View.VISIBLE);
         }
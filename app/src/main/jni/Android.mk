@@ -24,7 +24,8 @@ LOCAL_SRC_FILES := \
 	$(SRC_DIR)/lib/HTS_sstream.c \
 	$(SRC_DIR)/lib/HTS_vocoder.c
 LOCAL_C_INCLUDES := $(SRC_DIR)/include $(SRC_DIR)/lib
-LOCAL_CFLAGS := -std=c99 $(MY_CFLAGS)
+# dimension loops of parameter generation are written to be vectorized
+LOCAL_CFLAGS := -std=c99 -ftree-vectorize $(MY_CFLAGS)
 include $(BUILD_STATIC_LIBRARY)
 
 #==== OpenJTalk ==============================================================
@@ -71,7 +72,7 @@ LOCAL_SRC_FILES := \
 LOCAL_CFLAGS := $(MY_CFLAGS) \
 	-DHAVE_CONFIG_H \
 	-DCHARSET_UTF_8 -DDIC_VERSION=102 \
-	-DMECAB_WITHOUT_MUTEX_LOCK \
+	-DHAVE_GCC_ATOMIC_OPS \
 	-DMECAB_DEFAULT_RC="dummy"
 include $(BUILD_STATIC_LIBRARY)
 
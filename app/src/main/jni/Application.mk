@@ -1,3 +1,4 @@
-APP_STL := stlport_static
+APP_STL := c++_static
+APP_CPPFLAGS := -std=c++11
 #APP_ABI := armeabi-v7a
 APP_ABI := all
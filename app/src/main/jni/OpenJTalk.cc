@@ -1,4 +1,15 @@
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <atomic>
 #include <android/log.h>
 
 #include "OpenJTalk.h"
@@ -54,16 +65,166 @@ extern void unregister_cmu_us_kal(cst_voice* vox);
 
 static const int MAXBUFLEN = 1024;
 
+//------------------------------------------------------------------------
+//	Sentence splitting
+//------------------------------------------------------------------------
+
+static const char* const SENTENCE_ENDS[] = {
+	"\xe3\x80\x82", "\xef\xbc\x8e", "\xef\xbc\x81", "\xef\xbc\x9f",	// 。．！？
+	"!", "?", "\n", 0
+};
+static const char* const BREATH_GROUPS[] = {
+	"\xe3\x80\x81", "\xef\xbc\x8c", "\xe3\x80\x80",	// 、，and ideographic space
+	",", ";", ":", " ", "\t", 0
+};
+static const char* const CLOSINGS[] = {
+	"\xe3\x80\x8d", "\xe3\x80\x8f", "\xef\xbc\x89",	// 」』）
+	")", "\"", "'", " ", "\t", "\n", 0
+};
+
+static int
+match_any(const char* p, const char* const* list)
+{
+	for (int i = 0; list[i] != 0; i++) {
+		int n = strlen(list[i]);
+		if (strncmp(p, list[i], n) == 0)
+			return n;
+	}
+	return 0;
+}
+
+static int
+utf8_length(const char* p)
+{
+	unsigned char c = (unsigned char)*p;
+	int n = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+	for (int i = 1; i < n; i++) {
+		if (p[i] == '\0')
+			return i;
+	}
+	return n;
+}
+
+// returns the end of the sentence starting at text. A sentence longer than
+// max_len bytes is cut at its last breath group, or at a character boundary.
+static const char*
+next_sentence(const char* text, int max_len)
+{
+	const char* p = text;
+	const char* breath = 0;
+	while (*p != '\0' && p - text < max_len) {
+		int n = match_any(p, SENTENCE_ENDS);
+		if (n == 0 && *p == '.' && (p[1] == '\0' || strchr(" \t\r\n", p[1]) != 0))
+			n = 1;
+		if (n > 0) {
+			p += n;
+			while (p - text < max_len && (n = match_any(p, CLOSINGS)) > 0)
+				p += n;
+			return p;
+		}
+		n = match_any(p, BREATH_GROUPS);
+		if (n > 0) {
+			p += n;
+			breath = p;
+		} else {
+			p += utf8_length(p);
+		}
+	}
+	if (*p != '\0' && breath != 0)
+		return breath;
+	return p;
+}
+
+// leading and trailing white space does not change the speech
+static void
+trim_text(const char* text, const char** start, size_t* length)
+{
+	while (*text != '\0' && strchr(" \t\r\n", *text) != 0)
+		text++;
+	size_t n = strlen(text);
+	while (n > 0 && strchr(" \t\r\n", text[n - 1]) != 0)
+		n--;
+	*start = text;
+	*length = n;
+}
+
+// same layout as HTS_Engine_save_riff (the device is little endian)
+static void
+save_riff(FILE* fp, const short* samples, int count, int freq)
+{
+	int data_size = count * sizeof(short);
+	int header[] = { data_size + 36, 16, 0x00010001, freq, freq * (int)sizeof(short),
+		(int)((sizeof(short) * 8) << 16 | sizeof(short)) };
+	fwrite("RIFF", 1, 4, fp);
+	fwrite(&header[0], sizeof(int), 1, fp);
+	fwrite("WAVEfmt ", 1, 8, fp);
+	fwrite(&header[1], sizeof(int), 5, fp);
+	fwrite("data", 1, 4, fp);
+	fwrite(&data_size, sizeof(int), 1, fp);
+	fwrite(samples, sizeof(short), count, fp);
+}
+
+// milliseconds since *t, which is advanced to now
+static double
+lap(struct timespec* t)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double ms = (now.tv_sec - t->tv_sec) * 1000.0 + (now.tv_nsec - t->tv_nsec) / 1000000.0;
+	*t = now;
+	return ms;
+}
+
+// holds a mutex until the end of the scope
+class Lock
+{
+	pthread_mutex_t* _mutex;
+
+public:
+	Lock(pthread_mutex_t* mutex) : _mutex(mutex) { pthread_mutex_lock(_mutex); }
+	~Lock() { pthread_mutex_unlock(_mutex); }
+};
+
+class LabelCache;
+class WaveCache;
+
 class OpenJTalk
 {
 public:
+	// time in milliseconds spent in each stage and the work done for the
+	// last utterance; stages that did not run are 0
+	struct Stats {
+		double text2mecab;
+		double mecab;
+		double mecab2njd;
+		double njdPronunciation;
+		double njdDigit;
+		double njdAccentPhrase;
+		double njdAccentType;
+		double njdUnvoicedVowel;
+		double njdLongVowel;
+		double njd2jpcommon;
+		double makeLabel;
+		double flite;
+		double stateSequence;
+		double parameterSequence;
+		double sampleSequence;
+		int labels;
+		int states;
+		int frames;
+		int samples;
+		int latticeNodes;
+		int questions;
+		int gvIterations;
+	};
+
 	struct Grammar {
 		virtual ~Grammar() {}
 		virtual bool canTalk(const char* label) { return true; }
 		virtual char** labels() = 0;
 		virtual int count() = 0;
 		virtual int minCount() = 0;
-		virtual bool parse(const char* text) = 0;
+		virtual bool parse(const char* text, const std::atomic<bool>* stop, Stats* stats) = 0;
 		virtual void reset() {}
 		virtual void log(FILE* fp) {}
 		static Grammar* load(const char* lang, const char* dict_dir);
@@ -71,13 +232,50 @@ public:
 	friend class JPGrammar;
 	friend class FliteGrammar;
 
+	typedef void (*CompleteCallback)(void* user_data, int id, bool success);
+	typedef void (*BatchCallback)(void* user_data, int index, const short* buff, int size);
+
 private:
+	struct Request {
+		int id;
+		char* text;
+		HTS_AudioCallback callback;
+		CompleteCallback complete;
+		void* user_data;
+		int buff_size;
+		Request* next;
+	};
+
 	//------------------------------------------------------------------------
 	//	Instance variables
 	//------------------------------------------------------------------------
 
 	HTS_Engine _engine;
 	Grammar* _grammar;
+	LabelCache* _labelCache;
+	WaveCache* _waveCache;
+	int _pdfCacheSize;	// labels whose decision tree results the engine keeps
+	int _numThreads;	// threads the engine solves parameter dimensions on
+	double _gvTolerance;	// relative GV objective change that ends iteration
+	int _lookahead;		// frames generated ahead of synthesis, 0 for whole utterance
+	char* _voiceId;		// lang, dictionary and voice file identity
+	Stats _stats;
+	std::atomic<bool> _stop;	// set by stop() and cancel() from other threads
+
+	// guards everything above; every public call except stop(), submit()
+	// and cancel() holds it throughout, and so does the worker for each
+	// request. recursive, as calls nest and listeners may call back
+	pthread_mutex_t _engineMutex;
+
+	// asynchronous requests, guarded by _mutex
+	pthread_mutex_t _mutex;
+	pthread_cond_t _cond;
+	pthread_t _thread;
+	bool _running;
+	bool _quit;
+	Request* _requests;
+	int _lastId;
+	int _current;
 	
 public:
 	//------------------------------------------------------------------------
@@ -107,6 +305,24 @@ public:
 	void setVolume(double v);
 	int audioBufferSize();
 	void setAudioBufferSize(int size);
+	int sampleCount();
+	int labelCacheSize();
+	void setLabelCacheSize(int size);
+	long labelCacheHits();
+	long labelCacheMisses();
+	int pdfCacheSize();
+	void setPdfCacheSize(int size);
+	long pdfCacheHits();
+	long pdfCacheMisses();
+	int numThreads();
+	void setNumThreads(int n);
+	double gvTolerance();
+	void setGvTolerance(double t);
+	int lookahead();
+	void setLookahead(int frames);
+	long waveCacheHits();
+	long waveCacheMisses();
+	Stats lastStats();
 
 	//------------------------------------------------------------------------
 	//	Operations
@@ -114,7 +330,38 @@ public:
 
 	bool load(const char* lang, const char* dict, const char* voice);
 
+	// keep synthesized speech in dir, up to size bytes; dir 0 disables it
+	bool setWaveCache(const char* dir, long size);
+
 	bool talk(const char* txt, const char* wave, const char* log);
+	bool talk(const char* txt, HTS_AudioCallback callback, void* user_data, int buff_size);
+	bool talkDocument(const char* txt, HTS_AudioCallback callback, void* user_data, int buff_size);
+	void stop();
+
+	// synthesize speech and keep it until refresh() is called; play is
+	// false when it is only read back with samples()
+	bool synthesize(const char* txt, bool useCache = true, bool play = true);
+	int samples(short* buff, int size);
+	void refresh();
+
+	// synthesize texts in turn; buff is 0 for items that failed
+	int talkBatch(const char** txts, int count, BatchCallback callback, void* user_data);
+
+	// queue a request for the worker thread; complete is always called once
+	int submit(const char* txt, HTS_AudioCallback callback, CompleteCallback complete,
+		void* user_data, int buff_size);
+	bool cancel(int id);
+
+private:
+	void release();
+	void recycle();
+	bool silent(const char* sentence);
+	size_t waveKey(const char* txt, char* key);
+	bool playCached(const char* txt, const char* wave, bool* success);
+	void storeCached(const char* txt);
+	static void* worker(void* arg);
+	void run();
+	void shutdown();
 };
 
 //------------------------------------------------------------------------
@@ -123,6 +370,7 @@ public:
 
 class JPGrammar : public OpenJTalk::Grammar
 {
+	mecab_model_t* _model;
 	Mecab _mecab;
 	NJD _njd;
 	JPCommon _jpcommon;
@@ -142,7 +390,7 @@ public:
 	}
 	virtual int minCount() { return 2; }
 
-	virtual bool parse(const char* text);
+	virtual bool parse(const char* text, const std::atomic<bool>* stop, OpenJTalk::Stats* stats);
 	virtual void reset();
 	virtual void log(FILE* fp);
 
@@ -165,7 +413,7 @@ public:
 	virtual int count() { return _count; }
 	virtual int minCount() { return 1; }
 
-	virtual bool parse(const char* text);
+	virtual bool parse(const char* text, const std::atomic<bool>* stop, OpenJTalk::Stats* stats);
 	virtual void reset();
 
 	static Grammar* load(const char* dict_dir);
@@ -174,20 +422,181 @@ private:
 	void createLabel(cst_item* item, char* label);
 };
 
+//------------------------------------------------------------------------
+//	Dictionary - MeCab models shared by all JPGrammar instances
+//------------------------------------------------------------------------
+
+class Dictionary
+{
+	char* _path;
+	mecab_model_t* _model;
+	int _users;
+	Dictionary* _next;
+
+	static Dictionary* _dictionaries;
+	static pthread_mutex_t _mutex;
+
+	Dictionary(const char* path);
+	~Dictionary();
+
+public:
+	static mecab_model_t* attach(const char* path);
+	static void detach(mecab_model_t* model);
+};
+
+//------------------------------------------------------------------------
+//	Voice - HTS voices shared by all OpenJTalk instances
+//------------------------------------------------------------------------
+
+class Voice
+{
+	char* _path;
+	HTS_Engine _engine;
+	int _users;
+	Voice* _next;
+
+	static Voice* _voices;
+	static pthread_mutex_t _mutex;
+
+	Voice(const char* path);
+	~Voice();
+
+public:
+	static bool attach(HTS_Engine* engine, const char* path);
+	static void detach(HTS_Engine* engine);
+
+private:
+	static void release(HTS_Engine* engine);
+};
+
+//------------------------------------------------------------------------
+//	LabelCache - recently used full-context labels keyed by text
+//------------------------------------------------------------------------
+
+class LabelCache
+{
+	struct Entry {
+		char* text;
+		char** labels;
+		int count;
+		size_t size;
+		unsigned int hash;
+		Entry* prev;		// LRU list, most recently used first
+		Entry* next;
+		Entry* chain;		// hash bucket
+	};
+
+	size_t _budget;
+	size_t _size;
+	Entry* _head;
+	Entry* _tail;
+	Entry** _buckets;
+	int _bucketCount;
+	int _count;
+	long _hits;
+	long _misses;
+
+public:
+	LabelCache(size_t budget);
+	~LabelCache();
+
+	size_t budget() { return _budget; }
+	void setBudget(size_t budget);
+	long hits() { return _hits; }
+	long misses() { return _misses; }
+
+	bool find(const char* text, char*** labels, int* count);
+	void add(const char* text, char** labels, int count);
+	void clear();
+
+private:
+	static unsigned int hash(const char* text, size_t length);
+	Entry** lookup(const char* text, size_t length, unsigned int hash);
+	void unlink(Entry* entry);
+	void remove(Entry* entry);
+	void grow();
+};
+
+static const size_t LABEL_CACHE_SIZE = 256 * 1024;
+
+// full-context labels (about 500 bytes each) of which HTS keeps PDF indices
+static const int PDF_CACHE_SIZE = 2048;
+
+//------------------------------------------------------------------------
+//	WaveCache - synthesized speech stored in files named by key hash
+//------------------------------------------------------------------------
+
+class WaveCache
+{
+	struct Header {
+		char magic[4];		// "OJTW"
+		int version;
+		int keySize;
+		int count;			// samples following the key
+	};
+
+	char* _dir;
+	size_t _limit;
+	size_t _size;
+	long _hits;
+	long _misses;
+
+public:
+	struct Wave {
+		void* addr;
+		size_t length;
+		const short* samples;
+		int count;
+	};
+
+	WaveCache(const char* dir, size_t limit);
+	~WaveCache();
+
+	long hits() { return _hits; }
+	long misses() { return _misses; }
+
+	bool open(const char* key, size_t size, Wave* wave);
+	void close(Wave* wave);
+	void store(const char* key, size_t size, const short* samples, int count);
+
+private:
+	void path(char* buff, size_t buff_size, const char* key, size_t size);
+	static size_t offset(size_t size);
+	void evict();
+};
+
 //------------------------------------------------------------------------
 //	Constructors
 //------------------------------------------------------------------------
 
 OpenJTalk::OpenJTalk()
-	: _grammar(0)
+	: _grammar(0), _labelCache(new LabelCache(LABEL_CACHE_SIZE)), _waveCache(0),
+	  _pdfCacheSize(PDF_CACHE_SIZE), _numThreads(1), _gvTolerance(0.0), _lookahead(0), _voiceId(0),
+	  _stop(false), _running(false), _quit(false),
+	  _requests(0), _lastId(0), _current(0)
 {
+	memset(&_stats, 0, sizeof(_stats));
 	HTS_Engine_initialize(&_engine);
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&_engineMutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, NULL);
 }
 
 OpenJTalk::~OpenJTalk()
 {
+	shutdown();
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+	pthread_mutex_destroy(&_engineMutex);
+	delete _labelCache;
+	delete _waveCache;
+	free(_voiceId);
 	delete _grammar;
-	HTS_Engine_clear(&_engine);
+	Voice::detach(&_engine);
 }
 
 //------------------------------------------------------------------------
@@ -196,121 +605,293 @@ OpenJTalk::~OpenJTalk()
 
 int OpenJTalk::samplingFrequency()
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_sampling_frequency(&_engine);
 }
 
 void OpenJTalk::setSamplingFrequency(int freq)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_sampling_frequency(&_engine, freq);
 }
 
 double OpenJTalk::alpha()
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_alpha(&_engine);
 }
 
 void OpenJTalk::setAlpha(double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_alpha(&_engine, value);
 }
 
 double OpenJTalk::beta()
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_beta(&_engine);
 }
 
 void OpenJTalk::setBeta(double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_beta(&_engine, value);
 }
 
 void OpenJTalk::setSpeed(double speed)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_speed(&_engine, speed);
 }
 
 void OpenJTalk::addHalfTone(double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_add_half_tone(&_engine, value);
 }
 
 double OpenJTalk::msdThreshold(int index)
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_msd_threshold(&_engine, index);
 }
 
 void OpenJTalk::setMsdThreshold(int index, double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_msd_threshold(&_engine, index, value);
 }
 
 double OpenJTalk::gvWeight(int index)
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_gv_weight(&_engine, index);
 }
 
 void OpenJTalk::setGvWeight(int index, double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_gv_weight(&_engine, index, value);
 }
 
 double OpenJTalk::volume()
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_volume(&_engine);
 }
 
 void OpenJTalk::setVolume(double value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_volume(&_engine, value);
 }
 
 int OpenJTalk::audioBufferSize()
 {
+	Lock lock(&_engineMutex);
 	return HTS_Engine_get_audio_buff_size(&_engine);
 }
 
 void OpenJTalk::setAudioBufferSize(int value)
 {
+	Lock lock(&_engineMutex);
 	HTS_Engine_set_audio_buff_size(&_engine, value);
 }
 
+int OpenJTalk::sampleCount()
+{
+	Lock lock(&_engineMutex);
+	return HTS_Engine_get_nsamples(&_engine);
+}
+
+int OpenJTalk::labelCacheSize()
+{
+	Lock lock(&_engineMutex);
+	return (int)_labelCache->budget();
+}
+
+void OpenJTalk::setLabelCacheSize(int size)
+{
+	Lock lock(&_engineMutex);
+	_labelCache->setBudget(size > 0 ? size : 0);
+}
+
+long OpenJTalk::labelCacheHits()
+{
+	Lock lock(&_engineMutex);
+	return _labelCache->hits();
+}
+
+long OpenJTalk::labelCacheMisses()
+{
+	Lock lock(&_engineMutex);
+	return _labelCache->misses();
+}
+
+int OpenJTalk::pdfCacheSize()
+{
+	Lock lock(&_engineMutex);
+	return _pdfCacheSize;
+}
+
+// kept here too, as loading a voice resets the engine
+void OpenJTalk::setPdfCacheSize(int size)
+{
+	Lock lock(&_engineMutex);
+	_pdfCacheSize = size > 0 ? size : 0;
+	HTS_Engine_set_pdf_cache_size(&_engine, _pdfCacheSize);
+}
+
+long OpenJTalk::pdfCacheHits()
+{
+	Lock lock(&_engineMutex);
+	return (long)HTS_Engine_get_pdf_cache_hits(&_engine);
+}
+
+long OpenJTalk::pdfCacheMisses()
+{
+	Lock lock(&_engineMutex);
+	return (long)HTS_Engine_get_pdf_cache_misses(&_engine);
+}
+
+int OpenJTalk::numThreads()
+{
+	Lock lock(&_engineMutex);
+	return _numThreads;
+}
+
+// kept here too, as loading a voice resets the engine
+void OpenJTalk::setNumThreads(int n)
+{
+	Lock lock(&_engineMutex);
+	_numThreads = n > 1 ? n : 1;
+	HTS_Engine_set_num_threads(&_engine, _numThreads);
+}
+
+double OpenJTalk::gvTolerance()
+{
+	Lock lock(&_engineMutex);
+	return _gvTolerance;
+}
+
+// kept here too, as loading a voice resets the engine
+void OpenJTalk::setGvTolerance(double t)
+{
+	Lock lock(&_engineMutex);
+	_gvTolerance = t > 0.0 ? t : 0.0;
+	HTS_Engine_set_gv_tolerance(&_engine, _gvTolerance);
+}
+
+int OpenJTalk::lookahead()
+{
+	Lock lock(&_engineMutex);
+	return _lookahead;
+}
+
+// kept here too, as loading a voice resets the engine
+void OpenJTalk::setLookahead(int frames)
+{
+	Lock lock(&_engineMutex);
+	_lookahead = frames > 0 ? frames : 0;
+	HTS_Engine_set_lookahead(&_engine, _lookahead);
+}
+
+long OpenJTalk::waveCacheHits()
+{
+	Lock lock(&_engineMutex);
+	return _waveCache != 0 ? _waveCache->hits() : 0;
+}
+
+long OpenJTalk::waveCacheMisses()
+{
+	Lock lock(&_engineMutex);
+	return _waveCache != 0 ? _waveCache->misses() : 0;
+}
+
+OpenJTalk::Stats OpenJTalk::lastStats()
+{
+	Lock lock(&_engineMutex);
+	return _stats;
+}
+
 //------------------------------------------------------------------------
 //	Operations
 //------------------------------------------------------------------------
 
 bool OpenJTalk::load(const char* lang, const char* dict, const char* voice)
 {
+	Lock lock(&_engineMutex);
 	LOGV(TAG, "OpenJTalk.load lang=%s,dict=%s,voice=%s", lang, dict, voice);
 
 	// load grammar
 	delete _grammar;
 	_grammar = 0;
+	_labelCache->clear();
+	free(_voiceId);
+	_voiceId = 0;
 	Grammar* grammar = Grammar::load(lang, dict);
 	if (grammar == 0)
 		return false;
-	if (HTS_Engine_load(&_engine, (char**)&voice, 1) != TRUE) {
+	if (!Voice::attach(&_engine, voice)) {
 		LOGD(TAG, "HTS_Engine_load failed");
 		delete grammar;
 		return false;
 	}
+	HTS_Engine_set_pdf_cache_size(&_engine, _pdfCacheSize);
+	HTS_Engine_set_num_threads(&_engine, _numThreads);
+	HTS_Engine_set_gv_tolerance(&_engine, _gvTolerance);
+	HTS_Engine_set_lookahead(&_engine, _lookahead);
 	if (grammar->canTalk(HTS_Engine_get_fullcontext_label_format(&_engine))) {
 		_grammar = grammar;
+		// a voice file replaced in place must not hit the wave cache
+		struct stat st;
+		if (stat(voice, &st) != 0)
+			memset(&st, 0, sizeof(st));
+		const char* format = "%s\n%s\n%s\n%lld\n%lld";
+		size_t size = snprintf(0, 0, format, lang, dict != 0 ? dict : "", voice,
+			(long long)st.st_size, (long long)st.st_mtime) + 1;
+		_voiceId = (char*)malloc(size);
+		if (_voiceId != 0)
+			snprintf(_voiceId, size, format, lang, dict != 0 ? dict : "", voice,
+				(long long)st.st_size, (long long)st.st_mtime);
 		return true;
 	}
 	delete grammar;
 	return false;
 }
 
-bool OpenJTalk::talk(const char* text, const char* wave, const char* log)
+bool OpenJTalk::setWaveCache(const char* dir, long size)
 {
-	if (_grammar == 0 || !_grammar->parse(text))
+	Lock lock(&_engineMutex);
+	LOGV(TAG, "OpenJTalk.setWaveCache dir=%s,size=%ld", dir, size);
+	delete _waveCache;
+	_waveCache = 0;
+	if (dir == 0 || size <= 0)
+		return true;
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		LOGD(TAG, "OpenJTalk.setWaveCache mkdir failed: %s", dir);
 		return false;
+	}
+	_waveCache = new WaveCache(dir, (size_t)size);
+	return true;
+}
 
-	bool success = false;
-	int n = _grammar->count();
-	if (n > _grammar->minCount()) {
-		char** labels = _grammar->labels();
-		success = HTS_Engine_synthesize_from_strings(&_engine, labels, n);
+bool OpenJTalk::talk(const char* text, const char* wave, const char* log)
+{
+	Lock lock(&_engineMutex);
+	// the analysis log needs the grammar state, so bypass the caches
+	bool success;
+	if (log == 0 && playCached(text, wave, &success)) {
+		refresh();
+		return success;
+	}
+	success = synthesize(text, log == 0);
+	if (success && log == 0)
+		storeCached(text);
+	// the files are written whenever the labels reached the engine, even
+	// if synthesis failed
+	if (_grammar != 0 && _stats.labels > _grammar->minCount()) {
 		if (wave != 0) {
 			FILE* fp = fopen(wave, "w");
 			if (fp != 0) {
@@ -331,125 +912,579 @@ bool OpenJTalk::talk(const char* text, const char* wave, const char* log)
 				fclose(fp);
 			}
 		}
-		LOGV(TAG, "OpenJTalk.talk HTS_Engine_synthesize: %s",
-			success ? "SUCCESS" : "ERROR");
-		HTS_Engine_refresh(&_engine);
 	}
-	_grammar->reset();
+	refresh();
 	return success;
 }
 
-//------------------------------------------------------------------------
-//	Grammar
-//------------------------------------------------------------------------
-
-OpenJTalk::Grammar*
-OpenJTalk::Grammar::load(const char* lang, const char* dict_dir)
+bool OpenJTalk::talk(const char* text, HTS_AudioCallback callback, void* user_data, int buff_size)
 {
-	if (strncasecmp(lang, "ja", 2) == 0)
-		return JPGrammar::load(dict_dir);
-	else
-		return FliteGrammar::load(dict_dir);
+	Lock lock(&_engineMutex);
+	LOGV(TAG, "OpenJTalk.talk stream buffer=%d", buff_size);
+	HTS_Engine_set_audio_callback(&_engine, callback, user_data, buff_size);
+	bool success = talk(text, 0, 0);
+	HTS_Engine_set_audio_callback(&_engine, 0, 0, 0);
+	return success;
 }
 
-//------------------------------------------------------------------------
-//	Grammar - JPGrammar
-//------------------------------------------------------------------------
-
-OpenJTalk::Grammar*
-JPGrammar::load(const char* dict_dir)
+// true when the sentence just given to synthesize() had nothing to say:
+// only white space, or only the pauses the grammar always adds
+bool OpenJTalk::silent(const char* sentence)
 {
-	JPGrammar* grammar = new JPGrammar();
-	if (Mecab_load(&grammar->_mecab, dict_dir) != TRUE) {
-		LOGD(TAG, "Mecab_load failed");
-		delete grammar;
-		return 0;
-	}
-	return grammar;
+	const char* start;
+	size_t length;
+	trim_text(sentence, &start, &length);
+	return length == 0 || (_stats.labels > 0 && _stats.labels <= _grammar->minCount());
 }
 
-JPGrammar::JPGrammar()
+// synthesize sentence by sentence so that memory stays bounded by the
+// longest sentence while audio is delivered continuously. fails when any
+// sentence with something to say fails, the others are still played
+bool OpenJTalk::talkDocument(const char* text, HTS_AudioCallback callback, void* user_data, int buff_size)
 {
-	Mecab_initialize(&_mecab);
-	NJD_initialize(&_njd);
-	JPCommon_initialize(&_jpcommon);
+	Lock lock(&_engineMutex);
+	LOGV(TAG, "OpenJTalk.talkDocument stream buffer=%d", buff_size);
+	HTS_Engine_set_audio_callback(&_engine, callback, user_data, buff_size);
+	char sentence[MAXBUFLEN + 8];
+	bool spoken = false;
+	bool failed = false;
+	const char* p = text;
+	while (*p != '\0' && !_stop) {
+		const char* end = next_sentence(p, MAXBUFLEN);
+		memcpy(sentence, p, end - p);
+		sentence[end - p] = '\0';
+		p = end;
+		bool played;
+		if (playCached(sentence, 0, &played)) {
+			spoken = spoken || played;
+			failed = failed || !played;
+			continue;
+		}
+		if (synthesize(sentence)) {
+			spoken = true;
+			storeCached(sentence);
+		} else if (!_stop && !silent(sentence)) {
+			LOGD(TAG, "OpenJTalk.talkDocument failed sentence ending at %d", (int)(end - text));
+			failed = true;
+		}
+		release();
+	}
+	HTS_Engine_set_audio_callback(&_engine, 0, 0, 0);
+	bool success = spoken && !failed && !_stop;
+	_stop = false;
+	return success;
 }
 
-JPGrammar::~JPGrammar()
+void OpenJTalk::stop()
 {
-	Mecab_clear(&_mecab);
-	NJD_clear(&_njd);
-	JPCommon_clear(&_jpcommon);
+	// _stop covers text analysis, the HTS stop flag covers vocoding
+	_stop = true;
+	HTS_Engine_set_stop_flag(&_engine, TRUE);
 }
 
-bool
-JPGrammar::canTalk(const char* format)
+bool OpenJTalk::synthesize(const char* text, bool useCache, bool play)
 {
-	if (strcmp(format, "HTS_TTS_JPN") != 0) {
-		LOGD(TAG, "HTS_Engine_fulltext_label_format is not 'HTS_TTS_JPN'");
+	Lock lock(&_engineMutex);
+	memset(&_stats, 0, sizeof(_stats));
+	if (_grammar == 0)
 		return false;
+
+	char** labels;
+	int n;
+	if (!useCache || !_labelCache->find(text, &labels, &n)) {
+		if (!_grammar->parse(text, &_stop, &_stats) || _stop)
+			return false;
+		labels = _grammar->labels();
+		n = _grammar->count();
+		if (useCache && n > _grammar->minCount())
+			_labelCache->add(text, labels, n);
 	}
-	return true;
+
+	bool success = false;
+	_stats.labels = n;
+	if (n > _grammar->minCount()) {
+		// run the synthesis steps one by one so that stop() is honoured
+		// between them; the first step resets the HTS stop flag.
+		// labels are kept by the grammar or the label cache until release()
+		// refreshes the engine, so HTS refers to them instead of copying.
+		struct timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		HTS_Engine_set_label_storage(&_engine, HTS_LABEL_BORROW);
+		HTS_Engine_set_audio_output(&_engine, play ? TRUE : FALSE);
+		success = HTS_Engine_generate_state_sequence_from_strings(&_engine, labels, n) == TRUE;
+		_stats.stateSequence = lap(&t);
+		_stats.states = HTS_Engine_get_total_state(&_engine);
+		_stats.questions = HTS_Engine_get_total_question(&_engine);
+		success = success && !_stop && HTS_Engine_generate_parameter_sequence(&_engine) == TRUE;
+		_stats.parameterSequence = lap(&t);
+		_stats.gvIterations = HTS_Engine_get_total_gv_iteration(&_engine);
+		success = success && !_stop && HTS_Engine_generate_sample_sequence(&_engine) == TRUE;
+		_stats.sampleSequence = lap(&t);
+		_stats.frames = HTS_Engine_get_total_frame(&_engine);
+		_stats.samples = HTS_Engine_get_nsamples(&_engine);
+		success = success && !_stop;
+		LOGV(TAG, "OpenJTalk.talk HTS_Engine_synthesize: %s",
+			success ? "SUCCESS" : _stop ? "STOPPED" : "ERROR");
+	}
+	return success;
 }
 
-bool
-JPGrammar::parse(const char* text)
+int OpenJTalk::samples(short* buff, int size)
 {
-	char buff[MAXBUFLEN];
-	text2mecab(buff, text);
-	Mecab_analysis(&_mecab, buff);
-	mecab2njd(&_njd, Mecab_get_feature(&_mecab), Mecab_get_size(&_mecab));
-	njd_set_pronunciation(&_njd);
-	njd_set_digit(&_njd);
-	njd_set_accent_phrase(&_njd);
-	njd_set_accent_type(&_njd);
-	njd_set_unvoiced_vowel(&_njd);
-	njd_set_long_vowel(&_njd);
-	njd2jpcommon(&_jpcommon, &_njd);
-	JPCommon_make_label(&_jpcommon);
-	return true;
+	Lock lock(&_engineMutex);
+	int n = sampleCount();
+	if (n > size)
+		n = size;
+	for (int i = 0; i < n; i++) {
+		double x = HTS_Engine_get_generated_speech(&_engine, i);
+		if (x > 32767.0)
+			buff[i] = 32767;
+		else if (x < -32768.0)
+			buff[i] = -32768;
+		else
+			buff[i] = (short)x;
+	}
+	return n;
 }
 
-void
-JPGrammar::reset()
+void OpenJTalk::refresh()
 {
-	JPCommon_refresh(&_jpcommon);
-	NJD_refresh(&_njd);
-	Mecab_refresh(&_mecab);
+	Lock lock(&_engineMutex);
+	release();
+	_stop = false;
 }
 
-void
-JPGrammar::log(FILE* fp)
+// same as refresh() but a pending stop request is kept
+void OpenJTalk::release()
 {
-	fprintf(fp, "[Text analysis result]\n");
-	NJD_fprint(&_njd, fp);
+	HTS_Engine_refresh(&_engine);
+	if (_grammar != 0)
+		_grammar->reset();
 }
 
-//------------------------------------------------------------------------
-//	Grammar - FliteGrammar
-//------------------------------------------------------------------------
+// same as release() but the engine keeps its buffers for the next text
+void OpenJTalk::recycle()
+{
+	HTS_Engine_reset(&_engine);
+	if (_grammar != 0)
+		_grammar->reset();
+}
 
-OpenJTalk::Grammar*
-FliteGrammar::load(const char* dict_dir)
+static void
+append(char* buff, size_t* size, const void* data, size_t length)
 {
-	cst_voice* voice = register_cmu_us_kal(dict_dir);
-	if (voice == 0) {
-		LOGD(TAG, "register_cmu_us_kal failed");
-		return 0;
-	}
-	return new FliteGrammar(voice);
+	if (buff != 0)
+		memcpy(buff + *size, data, length);
+	*size += length;
 }
 
-FliteGrammar::~FliteGrammar()
+// bytes identifying the speech for text: the voice, every condition that
+// changes the waveform and the text itself. key may be 0 to get the size.
+size_t OpenJTalk::waveKey(const char* text, char* key)
 {
-	reset();
-	unregister_cmu_us_kal(_voice);
+	HTS_Condition* c = &_engine.condition;
+	size_t nstream = HTS_Engine_get_nstream(&_engine);
+	size_t nvoices = HTS_Engine_get_nvoices(&_engine);
+	size_t size = 0;
+	append(key, &size, _voiceId, strlen(_voiceId) + 1);
+	append(key, &size, &c->sampling_frequency, sizeof(c->sampling_frequency));
+	append(key, &size, &c->fperiod, sizeof(c->fperiod));
+	append(key, &size, &c->volume, sizeof(c->volume));
+	append(key, &size, c->msd_threshold, nstream * sizeof(double));
+	append(key, &size, c->gv_weight, nstream * sizeof(double));
+	append(key, &size, &c->gv_tolerance, sizeof(c->gv_tolerance));
+	append(key, &size, &c->lookahead, sizeof(c->lookahead));
+	append(key, &size, &c->phoneme_alignment_flag, sizeof(c->phoneme_alignment_flag));
+	append(key, &size, &c->speed, sizeof(c->speed));
+	append(key, &size, &c->stage, sizeof(c->stage));
+	append(key, &size, &c->use_log_gain, sizeof(c->use_log_gain));
+	append(key, &size, &c->alpha, sizeof(c->alpha));
+	append(key, &size, &c->beta, sizeof(c->beta));
+	append(key, &size, &c->additional_half_tone, sizeof(c->additional_half_tone));
+	append(key, &size, c->duration_iw, nvoices * sizeof(double));
+	for (size_t i = 0; i < nvoices; i++) {
+		append(key, &size, c->parameter_iw[i], nstream * sizeof(double));
+		append(key, &size, c->gv_iw[i], nstream * sizeof(double));
+	}
+	const char* start;
+	size_t length;
+	trim_text(text, &start, &length);
+	append(key, &size, start, length);
+	return size;
 }
 
-bool
-FliteGrammar::parse(const char* text)
+// plays the speech for text from the wave cache, returns false on a miss
+bool OpenJTalk::playCached(const char* text, const char* wave, bool* success)
 {
-	reset();
+	if (_waveCache == 0 || _voiceId == 0 || _stop)
+		return false;
+	size_t size = waveKey(text, 0);
+	char* key = (char*)malloc(size);
+	if (key == 0)
+		return false;
+	waveKey(text, key);
+	WaveCache::Wave cached;
+	bool hit = _waveCache->open(key, size, &cached);
+	free(key);
+	if (!hit)
+		return false;
+	memset(&_stats, 0, sizeof(_stats));
+	_stats.samples = cached.count;
+
+	// same stop protocol as synthesize(): reset the HTS flag, then recheck
+	HTS_Engine_set_stop_flag(&_engine, FALSE);
+	*success = !_stop && HTS_Engine_play_speech(&_engine, cached.samples, cached.count) == TRUE
+		&& !_stop;
+	LOGV(TAG, "OpenJTalk.playCached samples=%d %s", cached.count, *success ? "SUCCESS" : "STOPPED");
+	if (wave != 0) {
+		FILE* fp = fopen(wave, "w");
+		if (fp != 0) {
+			LOGV(TAG, "OpenJTalk.talk save riff to=%s", wave);
+			save_riff(fp, cached.samples, cached.count, samplingFrequency());
+			fclose(fp);
+		}
+	}
+	_waveCache->close(&cached);
+	return true;
+}
+
+void OpenJTalk::storeCached(const char* text)
+{
+	if (_waveCache == 0 || _voiceId == 0)
+		return;
+	int n = sampleCount();
+	size_t size = waveKey(text, 0);
+	char* key = (char*)malloc(size);
+	short* buff = (short*)malloc(n * sizeof(short));
+	if (key != 0 && buff != 0) {
+		waveKey(text, key);
+		_waveCache->store(key, size, buff, samples(buff, n));
+	}
+	free(buff);
+	free(key);
+}
+
+int OpenJTalk::talkBatch(const char** texts, int count, BatchCallback callback, void* user_data)
+{
+	Lock lock(&_engineMutex);
+	short* buff = 0;
+	int size = 0;
+	int success = 0;
+	for (int i = 0; i < count && !_stop; i++) {
+		if (texts[i] != 0 && synthesize(texts[i], true, false)) {
+			int n = sampleCount();
+			if (n > size) {
+				short* p = (short*)realloc(buff, n * sizeof(short));
+				if (p == 0) {
+					release();
+					break;
+				}
+				buff = p;
+				size = n;
+			}
+			callback(user_data, i, buff, samples(buff, n));
+			success++;
+		} else {
+			callback(user_data, i, 0, 0);
+		}
+		recycle();
+	}
+	release();
+	free(buff);
+	_stop = false;
+	LOGV(TAG, "OpenJTalk.talkBatch %d/%d", success, count);
+	return success;
+}
+
+int OpenJTalk::submit(const char* text, HTS_AudioCallback callback, CompleteCallback complete,
+	void* user_data, int buff_size)
+{
+	Request* request = new Request();
+	request->text = strdup(text);
+	request->callback = callback;
+	request->complete = complete;
+	request->user_data = user_data;
+	request->buff_size = buff_size;
+	request->next = 0;
+
+	pthread_mutex_lock(&_mutex);
+	if (!_running) {
+		if (pthread_create(&_thread, NULL, worker, this) != 0) {
+			pthread_mutex_unlock(&_mutex);
+			LOGD(TAG, "OpenJTalk.submit pthread_create failed");
+			free(request->text);
+			delete request;
+			return 0;
+		}
+		_running = true;
+	}
+	if (++_lastId <= 0)
+		_lastId = 1;
+	request->id = _lastId;
+	Request** link = &_requests;
+	while (*link != 0)
+		link = &(*link)->next;
+	*link = request;
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	LOGV(TAG, "OpenJTalk.submit id=%d", request->id);
+	return request->id;
+}
+
+bool OpenJTalk::cancel(int id)
+{
+	Request* request = 0;
+	pthread_mutex_lock(&_mutex);
+	bool current = id > 0 && id == _current;
+	if (current) {
+		stop();
+	} else {
+		Request** link = &_requests;
+		while (*link != 0 && (*link)->id != id)
+			link = &(*link)->next;
+		request = *link;
+		if (request != 0)
+			*link = request->next;
+	}
+	bool found = current || request != 0;
+	pthread_mutex_unlock(&_mutex);
+	LOGV(TAG, "OpenJTalk.cancel id=%d %s", id, found ? "cancelled" : "not found");
+
+	if (request != 0) {
+		if (request->complete != 0)
+			request->complete(request->user_data, request->id, false);
+		free(request->text);
+		delete request;
+	}
+	return found;
+}
+
+void* OpenJTalk::worker(void* arg)
+{
+	((OpenJTalk*)arg)->run();
+	return 0;
+}
+
+void OpenJTalk::run()
+{
+	pthread_mutex_lock(&_mutex);
+	while (!_quit) {
+		if (_requests == 0) {
+			pthread_cond_wait(&_cond, &_mutex);
+			continue;
+		}
+		// take the engine before the request becomes current, so that
+		// cancel() never stops a call of another thread. _engineMutex is
+		// always locked before _mutex
+		pthread_mutex_unlock(&_mutex);
+		pthread_mutex_lock(&_engineMutex);
+		pthread_mutex_lock(&_mutex);
+		Request* request = _requests;
+		if (request == 0 || _quit) {
+			pthread_mutex_unlock(&_engineMutex);
+			continue;
+		}
+		_requests = request->next;
+		_current = request->id;
+		_stop = false;
+		pthread_mutex_unlock(&_mutex);
+
+		bool success = talkDocument(request->text, request->callback, request->user_data,
+			request->buff_size);
+		LOGV(TAG, "OpenJTalk.run id=%d %s", request->id, success ? "done" : "failed");
+
+		// talkDocument() has reset the stop flag, but a cancel() may have
+		// set it again since; once not current, nothing can set it
+		pthread_mutex_lock(&_mutex);
+		_current = 0;
+		_stop = false;
+		pthread_mutex_unlock(&_mutex);
+		pthread_mutex_unlock(&_engineMutex);
+		if (request->complete != 0)
+			request->complete(request->user_data, request->id, success);
+		free(request->text);
+		delete request;
+		pthread_mutex_lock(&_mutex);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void OpenJTalk::shutdown()
+{
+	pthread_mutex_lock(&_mutex);
+	if (!_running) {
+		pthread_mutex_unlock(&_mutex);
+		return;
+	}
+	_quit = true;
+	if (_current != 0)
+		stop();
+	Request* requests = _requests;
+	_requests = 0;
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	pthread_join(_thread, NULL);
+	_running = false;
+
+	while (requests != 0) {
+		Request* request = requests;
+		requests = request->next;
+		if (request->complete != 0)
+			request->complete(request->user_data, request->id, false);
+		free(request->text);
+		delete request;
+	}
+}
+
+//------------------------------------------------------------------------
+//	Grammar
+//------------------------------------------------------------------------
+
+OpenJTalk::Grammar*
+OpenJTalk::Grammar::load(const char* lang, const char* dict_dir)
+{
+	if (strncasecmp(lang, "ja", 2) == 0)
+		return JPGrammar::load(dict_dir);
+	else
+		return FliteGrammar::load(dict_dir);
+}
+
+//------------------------------------------------------------------------
+//	Grammar - JPGrammar
+//------------------------------------------------------------------------
+
+OpenJTalk::Grammar*
+JPGrammar::load(const char* dict_dir)
+{
+	JPGrammar* grammar = new JPGrammar();
+	grammar->_model = Dictionary::attach(dict_dir);
+	if (grammar->_model == 0 ||
+		Mecab_load_from_model(&grammar->_mecab, grammar->_model) != TRUE) {
+		LOGD(TAG, "Mecab_load failed");
+		delete grammar;
+		return 0;
+	}
+	return grammar;
+}
+
+JPGrammar::JPGrammar()
+	: _model(0)
+{
+	Mecab_initialize(&_mecab);
+	NJD_initialize(&_njd);
+	JPCommon_initialize(&_jpcommon);
+}
+
+JPGrammar::~JPGrammar()
+{
+	Mecab_clear(&_mecab);
+	NJD_clear(&_njd);
+	JPCommon_clear(&_jpcommon);
+	if (_model != 0)
+		Dictionary::detach(_model);
+}
+
+bool
+JPGrammar::canTalk(const char* format)
+{
+	if (strcmp(format, "HTS_TTS_JPN") != 0) {
+		LOGD(TAG, "HTS_Engine_fulltext_label_format is not 'HTS_TTS_JPN'");
+		return false;
+	}
+	return true;
+}
+
+bool
+JPGrammar::parse(const char* text, const std::atomic<bool>* stop, OpenJTalk::Stats* stats)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	char stack_buff[MAXBUFLEN];
+	char* buff = stack_buff;
+	size_t size = text2mecab_n(buff, MAXBUFLEN, text) + 1;
+	if (size > MAXBUFLEN) {
+		buff = (char*)malloc(size);
+		if (buff == 0)
+			return false;
+		text2mecab_n(buff, size, text);
+	}
+	stats->text2mecab = lap(&t);
+	bool success = !*stop && Mecab_analysis(&_mecab, buff) == TRUE;
+	stats->mecab = lap(&t);
+	stats->latticeNodes = Mecab_get_lattice_size(&_mecab);
+	if (buff != stack_buff)
+		free(buff);
+	if (!success || *stop)
+		return false;
+	mecab2njd(&_njd, Mecab_get_feature(&_mecab), Mecab_get_size(&_mecab));
+	stats->mecab2njd = lap(&t);
+	njd_set_pronunciation(&_njd);
+	stats->njdPronunciation = lap(&t);
+	njd_set_digit(&_njd);
+	stats->njdDigit = lap(&t);
+	njd_set_accent_phrase(&_njd);
+	stats->njdAccentPhrase = lap(&t);
+	njd_set_accent_type(&_njd);
+	stats->njdAccentType = lap(&t);
+	if (*stop)
+		return false;
+	njd_set_unvoiced_vowel(&_njd);
+	stats->njdUnvoicedVowel = lap(&t);
+	njd_set_long_vowel(&_njd);
+	stats->njdLongVowel = lap(&t);
+	njd2jpcommon(&_jpcommon, &_njd);
+	stats->njd2jpcommon = lap(&t);
+	if (*stop)
+		return false;
+	JPCommon_make_label(&_jpcommon);
+	stats->makeLabel = lap(&t);
+	return !*stop;
+}
+
+void
+JPGrammar::reset()
+{
+	JPCommon_refresh(&_jpcommon);
+	NJD_refresh(&_njd);
+	Mecab_refresh(&_mecab);
+}
+
+void
+JPGrammar::log(FILE* fp)
+{
+	fprintf(fp, "[Text analysis result]\n");
+	NJD_fprint(&_njd, fp);
+}
+
+//------------------------------------------------------------------------
+//	Grammar - FliteGrammar
+//------------------------------------------------------------------------
+
+OpenJTalk::Grammar*
+FliteGrammar::load(const char* dict_dir)
+{
+	cst_voice* voice = register_cmu_us_kal(dict_dir);
+	if (voice == 0) {
+		LOGD(TAG, "register_cmu_us_kal failed");
+		return 0;
+	}
+	return new FliteGrammar(voice);
+}
+
+FliteGrammar::~FliteGrammar()
+{
+	reset();
+	unregister_cmu_us_kal(_voice);
+}
+
+bool
+FliteGrammar::parse(const char* text, const std::atomic<bool>* stop, OpenJTalk::Stats* stats)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	reset();
+	if (*stop)
+		return false;
 	_u = flite_synth_text(text, _voice);
 	if (_u == 0) {
 		LOGD(TAG, "flite_synth_text failed");
@@ -467,7 +1502,8 @@ FliteGrammar::parse(const char* text)
 		createLabel(s, _labels[i]);
 		i++;
 	}
-	return true;
+	stats->flite = lap(&t);
+	return !*stop;
 }
 
 void
@@ -478,6 +1514,7 @@ FliteGrammar::reset()
 			if (_labels[i] != 0)
 				free(_labels[i]);
 		}
+		free(_labels);
 		_labels = 0;
 	}
 	_count = 0;
@@ -623,10 +1660,626 @@ FliteGrammar::createLabel(cst_item* item, char* label)
    }
 }
 
+//------------------------------------------------------------------------
+//	Dictionary
+//------------------------------------------------------------------------
+
+Dictionary* Dictionary::_dictionaries = 0;
+pthread_mutex_t Dictionary::_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+Dictionary::Dictionary(const char* path)
+	: _model(0), _users(0), _next(0)
+{
+	_path = strdup(path);
+}
+
+Dictionary::~Dictionary()
+{
+	if (_model != 0)
+		mecab_model_destroy(_model);
+	free(_path);
+}
+
+mecab_model_t*
+Dictionary::attach(const char* path)
+{
+	if (path == 0 || *path == '\0')
+		return 0;
+	pthread_mutex_lock(&_mutex);
+	Dictionary* dict = _dictionaries;
+	while (dict != 0 && strcmp(dict->_path, path) != 0)
+		dict = dict->_next;
+	if (dict == 0) {
+		dict = new Dictionary(path);
+		char* argv[] = { (char*)"mecab", (char*)"-d", dict->_path };
+		dict->_model = mecab_model_new(3, argv);
+		if (dict->_model == 0) {
+			LOGD(TAG, "mecab_model_new failed: %s", path);
+			delete dict;
+			pthread_mutex_unlock(&_mutex);
+			return 0;
+		}
+		LOGV(TAG, "Dictionary.attach loaded %s", path);
+		dict->_next = _dictionaries;
+		_dictionaries = dict;
+	}
+	dict->_users++;
+	pthread_mutex_unlock(&_mutex);
+	return dict->_model;
+}
+
+void
+Dictionary::detach(mecab_model_t* model)
+{
+	pthread_mutex_lock(&_mutex);
+	Dictionary** link = &_dictionaries;
+	while (*link != 0 && (*link)->_model != model)
+		link = &(*link)->_next;
+	Dictionary* dict = *link;
+	if (dict != 0 && --dict->_users == 0) {
+		LOGV(TAG, "Dictionary.detach unloaded %s", dict->_path);
+		*link = dict->_next;
+		delete dict;
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+//------------------------------------------------------------------------
+//	Voice
+//------------------------------------------------------------------------
+
+Voice* Voice::_voices = 0;
+pthread_mutex_t Voice::_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+Voice::Voice(const char* path)
+	: _users(0), _next(0)
+{
+	_path = strdup(path);
+	HTS_Engine_initialize(&_engine);
+}
+
+Voice::~Voice()
+{
+	HTS_Engine_clear(&_engine);
+	free(_path);
+}
+
+bool
+Voice::attach(HTS_Engine* engine, const char* path)
+{
+	pthread_mutex_lock(&_mutex);
+	release(engine);
+	Voice* voice = _voices;
+	while (voice != 0 && strcmp(voice->_path, path) != 0)
+		voice = voice->_next;
+	if (voice == 0) {
+		voice = new Voice(path);
+		if (HTS_Engine_load(&voice->_engine, &voice->_path, 1) != TRUE) {
+			delete voice;
+			pthread_mutex_unlock(&_mutex);
+			return false;
+		}
+		LOGV(TAG, "Voice.attach loaded %s", path);
+		// read ahead the mapped voice while the rest of load() runs
+		HTS_Engine_prefetch(&voice->_engine);
+		voice->_next = _voices;
+		_voices = voice;
+	}
+	HTS_Engine_load_from_engine(engine, &voice->_engine);
+	voice->_users++;
+	pthread_mutex_unlock(&_mutex);
+	return true;
+}
+
+void
+Voice::detach(HTS_Engine* engine)
+{
+	pthread_mutex_lock(&_mutex);
+	release(engine);
+	pthread_mutex_unlock(&_mutex);
+}
+
+void
+Voice::release(HTS_Engine* engine)
+{
+	Voice** link = &_voices;
+	while (*link != 0 && (engine->ms == 0 || (*link)->_engine.ms != engine->ms))
+		link = &(*link)->_next;
+	HTS_Engine_clear(engine);
+	Voice* voice = *link;
+	if (voice != 0 && --voice->_users == 0) {
+		LOGV(TAG, "Voice.release unloaded %s", voice->_path);
+		*link = voice->_next;
+		delete voice;
+	}
+}
+
+//------------------------------------------------------------------------
+//	LabelCache
+//------------------------------------------------------------------------
+
+LabelCache::LabelCache(size_t budget)
+	: _budget(budget), _size(0), _head(0), _tail(0),
+	  _buckets(0), _bucketCount(0), _count(0), _hits(0), _misses(0)
+{
+	grow();
+}
+
+LabelCache::~LabelCache()
+{
+	clear();
+	free(_buckets);
+}
+
+void
+LabelCache::setBudget(size_t budget)
+{
+	_budget = budget;
+	while (_size > _budget && _tail != 0)
+		remove(_tail);
+}
+
+bool
+LabelCache::find(const char* text, char*** labels, int* count)
+{
+	if (_budget == 0 || _bucketCount == 0)
+		return false;
+	const char* start;
+	size_t length;
+	trim_text(text, &start, &length);
+	Entry* entry = *lookup(start, length, hash(start, length));
+	if (entry == 0) {
+		_misses++;
+		return false;
+	}
+	_hits++;
+	if (entry != _head) {
+		unlink(entry);
+		entry->next = _head;
+		_head->prev = entry;
+		_head = entry;
+	}
+	*labels = entry->labels;
+	*count = entry->count;
+	return true;
+}
+
+void
+LabelCache::add(const char* text, char** labels, int count)
+{
+	const char* start;
+	size_t length;
+	trim_text(text, &start, &length);
+	unsigned int h = hash(start, length);
+	if (_budget == 0 || _bucketCount == 0 || *lookup(start, length, h) != 0)
+		return;
+
+	// labels are packed behind their pointer array
+	size_t size = count * sizeof(char*);
+	for (int i = 0; i < count; i++)
+		size += strlen(labels[i]) + 1;
+	if (sizeof(Entry) + length + 1 + size > _budget)
+		return;
+	Entry* entry = (Entry*)malloc(sizeof(Entry));
+	entry->text = (char*)malloc(length + 1);
+	entry->labels = (char**)malloc(size);
+	if (entry->text == 0 || entry->labels == 0) {
+		free(entry->text);
+		free(entry->labels);
+		free(entry);
+		return;
+	}
+	memcpy(entry->text, start, length);
+	entry->text[length] = '\0';
+	char* p = (char*)(entry->labels + count);
+	for (int i = 0; i < count; i++) {
+		strcpy(p, labels[i]);
+		entry->labels[i] = p;
+		p += strlen(p) + 1;
+	}
+	entry->count = count;
+	entry->size = sizeof(Entry) + length + 1 + size;
+	entry->hash = h;
+
+	while (_size + entry->size > _budget && _tail != 0)
+		remove(_tail);
+	if (_count >= _bucketCount)
+		grow();
+	Entry** bucket = &_buckets[h % _bucketCount];
+	entry->chain = *bucket;
+	*bucket = entry;
+	entry->prev = 0;
+	entry->next = _head;
+	if (_head != 0)
+		_head->prev = entry;
+	_head = entry;
+	if (_tail == 0)
+		_tail = entry;
+	_size += entry->size;
+	_count++;
+}
+
+void
+LabelCache::clear()
+{
+	while (_tail != 0)
+		remove(_tail);
+}
+
+unsigned int
+LabelCache::hash(const char* text, size_t length)
+{
+	unsigned int h = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+		h = (h ^ (unsigned char)text[i]) * 16777619u;
+	return h;
+}
+
+LabelCache::Entry**
+LabelCache::lookup(const char* text, size_t length, unsigned int hash)
+{
+	Entry** link = &_buckets[hash % _bucketCount];
+	while (*link != 0 && ((*link)->hash != hash ||
+		strncmp((*link)->text, text, length) != 0 || (*link)->text[length] != '\0'))
+		link = &(*link)->chain;
+	return link;
+}
+
+void
+LabelCache::unlink(Entry* entry)
+{
+	if (entry->prev != 0)
+		entry->prev->next = entry->next;
+	else
+		_head = entry->next;
+	if (entry->next != 0)
+		entry->next->prev = entry->prev;
+	else
+		_tail = entry->prev;
+	entry->prev = entry->next = 0;
+}
+
+void
+LabelCache::remove(Entry* entry)
+{
+	Entry** link = lookup(entry->text, strlen(entry->text), entry->hash);
+	*link = entry->chain;
+	unlink(entry);
+	_size -= entry->size;
+	_count--;
+	free(entry->text);
+	free(entry->labels);
+	free(entry);
+}
+
+void
+LabelCache::grow()
+{
+	int count = _bucketCount > 0 ? _bucketCount * 2 : 64;
+	Entry** buckets = (Entry**)calloc(count, sizeof(Entry*));
+	if (buckets == 0)
+		return;
+	for (int i = 0; i < _bucketCount; i++) {
+		Entry* entry = _buckets[i];
+		while (entry != 0) {
+			Entry* chain = entry->chain;
+			entry->chain = buckets[entry->hash % count];
+			buckets[entry->hash % count] = entry;
+			entry = chain;
+		}
+	}
+	free(_buckets);
+	_buckets = buckets;
+	_bucketCount = count;
+}
+
+//------------------------------------------------------------------------
+//	WaveCache
+//------------------------------------------------------------------------
+
+static const int WAVE_CACHE_VERSION = 1;
+
+WaveCache::WaveCache(const char* dir, size_t limit)
+	: _limit(limit), _size(0), _hits(0), _misses(0)
+{
+	_dir = strdup(dir);
+	evict();
+}
+
+WaveCache::~WaveCache()
+{
+	free(_dir);
+}
+
+// maps the file stored for key; the samples stay valid until close()
+bool
+WaveCache::open(const char* key, size_t size, Wave* wave)
+{
+	char name[MAXBUFLEN];
+	path(name, sizeof(name), key, size);
+	wave->addr = MAP_FAILED;
+	int fd = ::open(name, O_RDONLY);
+	if (fd >= 0) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size >= offset(size)) {
+			wave->length = st.st_size;
+			wave->addr = mmap(0, wave->length, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+	}
+	if (wave->addr != MAP_FAILED) {
+		const Header* header = (const Header*)wave->addr;
+		if (memcmp(header->magic, "OJTW", 4) == 0 && header->version == WAVE_CACHE_VERSION
+			&& header->keySize == (int)size && header->count >= 0
+			&& wave->length == offset(size) + header->count * sizeof(short)
+			&& memcmp(header + 1, key, size) == 0) {
+			wave->samples = (const short*)((const char*)wave->addr + offset(size));
+			wave->count = header->count;
+			// the modification time orders files for eviction
+			utimes(name, NULL);
+			_hits++;
+			return true;
+		}
+		munmap(wave->addr, wave->length);
+	}
+	_misses++;
+	return false;
+}
+
+void
+WaveCache::close(Wave* wave)
+{
+	munmap(wave->addr, wave->length);
+}
+
+void
+WaveCache::store(const char* key, size_t size, const short* samples, int count)
+{
+	size_t length = offset(size) + count * sizeof(short);
+	if (count <= 0 || length > _limit)
+		return;
+	// written under a temporary name so that readers never see a partial file
+	char name[MAXBUFLEN];
+	char temp[MAXBUFLEN];
+	path(name, sizeof(name), key, size);
+	snprintf(temp, sizeof(temp), "%s/.tmpXXXXXX", _dir);
+	int fd = mkstemp(temp);
+	if (fd < 0) {
+		LOGD(TAG, "WaveCache.store mkstemp failed: %s", temp);
+		return;
+	}
+	Header header;
+	memcpy(header.magic, "OJTW", 4);
+	header.version = WAVE_CACHE_VERSION;
+	header.keySize = (int)size;
+	header.count = count;
+	char padding[8] = { 0 };
+	bool success = write(fd, &header, sizeof(header)) == sizeof(header)
+		&& write(fd, key, size) == (ssize_t)size
+		&& write(fd, padding, offset(size) - sizeof(header) - size) >= 0
+		&& write(fd, samples, count * sizeof(short)) == (ssize_t)(count * sizeof(short));
+	::close(fd);
+	if (!success || rename(temp, name) != 0) {
+		LOGD(TAG, "WaveCache.store failed: %s", name);
+		unlink(temp);
+		return;
+	}
+	_size += length;
+	if (_size > _limit)
+		evict();
+}
+
+void
+WaveCache::path(char* buff, size_t buff_size, const char* key, size_t size)
+{
+	unsigned long long h = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ (unsigned char)key[i]) * 1099511628211ull;
+	snprintf(buff, buff_size, "%s/%016llx.pcm", _dir, h);
+}
+
+// samples start at an 8 byte boundary behind the header and key
+size_t
+WaveCache::offset(size_t size)
+{
+	return (sizeof(Header) + size + 7) & ~(size_t)7;
+}
+
+struct WaveFile {
+	char* name;
+	size_t size;
+	time_t mtime;
+};
+
+static int
+compare_mtime(const void* a, const void* b)
+{
+	time_t x = ((const WaveFile*)a)->mtime;
+	time_t y = ((const WaveFile*)b)->mtime;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// rescans the directory, which other instances may share, and removes the
+// least recently used files until the total fits the limit
+void
+WaveCache::evict()
+{
+	DIR* dir = opendir(_dir);
+	if (dir == 0)
+		return;
+	WaveFile* files = 0;
+	int count = 0;
+	int capacity = 0;
+	_size = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != 0) {
+		size_t n = strlen(entry->d_name);
+		if (n < 4 || strcmp(entry->d_name + n - 4, ".pcm") != 0)
+			continue;
+		char name[MAXBUFLEN];
+		snprintf(name, sizeof(name), "%s/%s", _dir, entry->d_name);
+		struct stat st;
+		if (stat(name, &st) != 0)
+			continue;
+		if (count == capacity) {
+			capacity = capacity > 0 ? capacity * 2 : 64;
+			WaveFile* p = (WaveFile*)realloc(files, capacity * sizeof(WaveFile));
+			if (p == 0)
+				break;
+			files = p;
+		}
+		files[count].name = strdup(name);
+		files[count].size = st.st_size;
+		files[count].mtime = st.st_mtime;
+		_size += st.st_size;
+		count++;
+	}
+	closedir(dir);
+
+	qsort(files, count, sizeof(WaveFile), compare_mtime);
+	for (int i = 0; i < count; i++) {
+		if (_size > _limit && unlink(files[i].name) == 0) {
+			LOGV(TAG, "WaveCache.evict %s", files[i].name);
+			_size -= files[i].size;
+		}
+		free(files[i].name);
+	}
+	free(files);
+}
+
 //------------------------------------------------------------------------
 //	Java Interface
 //------------------------------------------------------------------------
 
+struct AudioStream {
+	JNIEnv* env;		// 0 when called back on the worker thread
+	jclass cls;
+	jmethodID method;
+	jobject listener;
+	OpenJTalk* ojt;
+};
+
+// submitted request; stream must stay the first member
+struct TalkRequest {
+	AudioStream stream;
+	jmethodID complete;
+	jobject listener;
+};
+
+static JavaVM* java_vm = 0;
+static pthread_key_t env_key;
+static pthread_once_t env_once = PTHREAD_ONCE_INIT;
+
+static void
+detach_env(void* env)
+{
+	java_vm->DetachCurrentThread();
+}
+
+static void
+create_env_key()
+{
+	pthread_key_create(&env_key, detach_env);
+}
+
+// JNIEnv of the current thread, attached on first use and
+// detached when the thread exits
+static JNIEnv*
+attach_env()
+{
+	JNIEnv* env = 0;
+	if (java_vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK)
+		return env;
+	pthread_once(&env_once, create_env_key);
+	if (java_vm->AttachCurrentThread(&env, NULL) != JNI_OK)
+		return 0;
+	pthread_setspecific(env_key, env);
+	return env;
+}
+
+static void
+audio_callback(void* user_data, const short* buff, size_t buff_size)
+{
+	AudioStream* stream = (AudioStream*)user_data;
+	JNIEnv* env = stream->env != 0 ? stream->env : attach_env();
+	if (env == 0) {
+		stream->ojt->stop();
+		return;
+	}
+	// a pending exception from an earlier call must not be followed by another call into Java
+	if (env->ExceptionCheck())
+		return;
+	jobject buffer = env->NewDirectByteBuffer((void*)buff, buff_size * sizeof(short));
+	if (buffer == 0) {
+		stream->ojt->stop();
+		return;
+	}
+	env->CallStaticVoidMethod(stream->cls, stream->method, stream->listener, buffer);
+	env->DeleteLocalRef(buffer);
+	if (env->ExceptionCheck()) {
+		LOGD(TAG, "AudioListener.onAudio threw an exception");
+		if (stream->env == 0)
+			env->ExceptionClear();
+		stream->ojt->stop();
+	}
+}
+
+struct BatchResult {
+	JNIEnv* env;
+	jobjectArray results;
+	jshortArray buffer;
+};
+
+static void
+batch_callback(void* user_data, int index, const short* buff, int size)
+{
+	BatchResult* result = (BatchResult*)user_data;
+	JNIEnv* env = result->env;
+	if (buff == 0)
+		return;
+	jshortArray array = env->NewShortArray(size);
+	if (array == 0)
+		return;
+	env->SetShortArrayRegion(array, 0, size, buff);
+	env->SetObjectArrayElement(result->results, index, array);
+	env->DeleteLocalRef(array);
+}
+
+// keeps the samples of a batch of one text
+static void
+buffer_callback(void* user_data, int index, const short* buff, int size)
+{
+	BatchResult* result = (BatchResult*)user_data;
+	JNIEnv* env = result->env;
+	if (buff == 0)
+		return;
+	result->buffer = env->NewShortArray(size);
+	if (result->buffer != 0)
+		env->SetShortArrayRegion(result->buffer, 0, size, buff);
+}
+
+static void
+complete_callback(void* user_data, int id, bool success)
+{
+	TalkRequest* request = (TalkRequest*)user_data;
+	JNIEnv* env = attach_env();
+	if (env != 0) {
+		if (request->listener != 0) {
+			env->CallStaticVoidMethod(request->stream.cls, request->complete,
+				request->listener, (jint)id, (jboolean)success);
+			if (env->ExceptionCheck()) {
+				LOGD(TAG, "RequestListener.onComplete threw an exception");
+				env->ExceptionClear();
+			}
+			env->DeleteGlobalRef(request->listener);
+		}
+		if (request->stream.listener != 0)
+			env->DeleteGlobalRef(request->stream.listener);
+		env->DeleteGlobalRef(request->stream.cls);
+	}
+	delete request;
+}
+
 jlong JNICALL
 Java_jp_itplus_openjtalk_OpenJTalk_nativeInit(JNIEnv* env, jclass cls)
 {
@@ -771,6 +2424,206 @@ Java_jp_itplus_openjtalk_OpenJTalk_nativeSetAudioBufferSize(
 	ojt->setAudioBufferSize((int)value);
 }
 
+jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheSize(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jint)ojt->labelCacheSize();
+}
+
+void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetLabelCacheSize(
+	JNIEnv* env, jclass cls, jlong instance, jint value)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	ojt->setLabelCacheSize((int)value);
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheHits(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->labelCacheHits();
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->labelCacheMisses();
+}
+
+jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheSize(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jint)ojt->pdfCacheSize();
+}
+
+void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetPdfCacheSize(
+	JNIEnv* env, jclass cls, jlong instance, jint value)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	ojt->setPdfCacheSize((int)value);
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheHits(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->pdfCacheHits();
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->pdfCacheMisses();
+}
+
+jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetNumThreads(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jint)ojt->numThreads();
+}
+
+void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetNumThreads(
+	JNIEnv* env, jclass cls, jlong instance, jint value)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	ojt->setNumThreads((int)value);
+}
+
+jdouble JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetGvTolerance(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jdouble)ojt->gvTolerance();
+}
+
+void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetGvTolerance(
+	JNIEnv* env, jclass cls, jlong instance, jdouble value)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	ojt->setGvTolerance((double)value);
+}
+
+jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLookahead(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jint)ojt->lookahead();
+}
+
+void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetLookahead(
+	JNIEnv* env, jclass cls, jlong instance, jint value)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	ojt->setLookahead((int)value);
+}
+
+jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetWaveCache(
+	JNIEnv* env, jclass cls, jlong instance, jstring dir_obj, jlong size)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	const char* dir = 0;
+	if (dir_obj != 0)
+		dir = env->GetStringUTFChars(dir_obj, NULL);
+	bool success = ojt->setWaveCache(dir, (long)size);
+	if (dir_obj != 0)
+		env->ReleaseStringUTFChars(dir_obj, dir);
+	return success ? JNI_TRUE : JNI_FALSE;
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetWaveCacheHits(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->waveCacheHits();
+}
+
+jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetWaveCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jlong)ojt->waveCacheMisses();
+}
+
+// fields of OpenJTalk.Stats, set from OpenJTalk::Stats by name
+static const struct {
+	const char* name;
+	size_t offset;
+} STATS_TIMES[] = {
+	{ "text2mecab", offsetof(OpenJTalk::Stats, text2mecab) },
+	{ "mecab", offsetof(OpenJTalk::Stats, mecab) },
+	{ "mecab2njd", offsetof(OpenJTalk::Stats, mecab2njd) },
+	{ "njdPronunciation", offsetof(OpenJTalk::Stats, njdPronunciation) },
+	{ "njdDigit", offsetof(OpenJTalk::Stats, njdDigit) },
+	{ "njdAccentPhrase", offsetof(OpenJTalk::Stats, njdAccentPhrase) },
+	{ "njdAccentType", offsetof(OpenJTalk::Stats, njdAccentType) },
+	{ "njdUnvoicedVowel", offsetof(OpenJTalk::Stats, njdUnvoicedVowel) },
+	{ "njdLongVowel", offsetof(OpenJTalk::Stats, njdLongVowel) },
+	{ "njd2jpcommon", offsetof(OpenJTalk::Stats, njd2jpcommon) },
+	{ "makeLabel", offsetof(OpenJTalk::Stats, makeLabel) },
+	{ "flite", offsetof(OpenJTalk::Stats, flite) },
+	{ "stateSequence", offsetof(OpenJTalk::Stats, stateSequence) },
+	{ "parameterSequence", offsetof(OpenJTalk::Stats, parameterSequence) },
+	{ "sampleSequence", offsetof(OpenJTalk::Stats, sampleSequence) },
+	{ 0, 0 }
+}, STATS_COUNTS[] = {
+	{ "labels", offsetof(OpenJTalk::Stats, labels) },
+	{ "states", offsetof(OpenJTalk::Stats, states) },
+	{ "frames", offsetof(OpenJTalk::Stats, frames) },
+	{ "samples", offsetof(OpenJTalk::Stats, samples) },
+	{ "latticeNodes", offsetof(OpenJTalk::Stats, latticeNodes) },
+	{ "questions", offsetof(OpenJTalk::Stats, questions) },
+	{ "gvIterations", offsetof(OpenJTalk::Stats, gvIterations) },
+	{ 0, 0 }
+};
+
+jobject JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLastStats(
+	JNIEnv* env, jclass cls, jlong instance)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	OpenJTalk::Stats last = ojt->lastStats();
+	const char* stats = (const char*)&last;
+	jclass stats_cls = env->FindClass("jp/itplus/openjtalk/OpenJTalk$Stats");
+	if (stats_cls == 0)
+		return 0;
+	jmethodID init = env->GetMethodID(stats_cls, "<init>", "()V");
+	jobject obj = init != 0 ? env->NewObject(stats_cls, init) : 0;
+	for (int i = 0; obj != 0 && STATS_TIMES[i].name != 0; i++) {
+		jfieldID field = env->GetFieldID(stats_cls, STATS_TIMES[i].name, "D");
+		if (field != 0)
+			env->SetDoubleField(obj, field, *(const double*)(stats + STATS_TIMES[i].offset));
+	}
+	for (int i = 0; obj != 0 && STATS_COUNTS[i].name != 0; i++) {
+		jfieldID field = env->GetFieldID(stats_cls, STATS_COUNTS[i].name, "I");
+		if (field != 0)
+			env->SetIntField(obj, field, *(const int*)(stats + STATS_COUNTS[i].offset));
+	}
+	env->DeleteLocalRef(stats_cls);
+	return obj;
+}
+
 jboolean JNICALL
 Java_jp_itplus_openjtalk_OpenJTalk_nativeLoad(
 	JNIEnv* env, jclass cls, jlong instance,
@@ -811,3 +2664,144 @@ Java_jp_itplus_openjtalk_OpenJTalk_nativeTalk(
 		env->ReleaseStringUTFChars(log_obj, log);
 	return (jboolean)success;
 }
+
+jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkStream(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject listener_obj, jint buff_size)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	AudioStream stream;
+	stream.env = env;
+	stream.cls = cls;
+	stream.method = env->GetStaticMethodID(cls, "dispatchAudio",
+		"(Ljp/itplus/openjtalk/OpenJTalk$AudioListener;Ljava/nio/ByteBuffer;)V");
+	if (stream.method == 0)
+		return JNI_FALSE;
+	stream.listener = listener_obj;
+	stream.ojt = ojt;
+	const char* text = env->GetStringUTFChars(text_obj, NULL);
+	bool success = ojt->talk(text, audio_callback, &stream, (int)buff_size);
+	env->ReleaseStringUTFChars(text_obj, text);
+	return (jboolean)success;
+}
+
+jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkDocument(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject listener_obj, jint buff_size)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	AudioStream stream;
+	stream.env = env;
+	stream.cls = cls;
+	stream.method = env->GetStaticMethodID(cls, "dispatchAudio",
+		"(Ljp/itplus/openjtalk/OpenJTalk$AudioListener;Ljava/nio/ByteBuffer;)V");
+	if (stream.method == 0)
+		return JNI_FALSE;
+	stream.listener = listener_obj;
+	stream.ojt = ojt;
+	const char* text = env->GetStringUTFChars(text_obj, NULL);
+	bool success = ojt->talkDocument(text, listener_obj != 0 ? audio_callback : 0, &stream,
+		(int)buff_size);
+	env->ReleaseStringUTFChars(text_obj, text);
+	return (jboolean)success;
+}
+
+jshortArray JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkToBuffer(
+	JNIEnv* env, jclass cls, jlong instance, jstring text_obj)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	const char* text = env->GetStringUTFChars(text_obj, NULL);
+	// a batch of one, so that synthesis and reading the samples are one call
+	BatchResult result;
+	result.env = env;
+	result.results = 0;
+	result.buffer = 0;
+	ojt->talkBatch(&text, 1, buffer_callback, &result);
+	env->ReleaseStringUTFChars(text_obj, text);
+	return result.buffer;
+}
+
+jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSubmit(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject audio_obj, jobject listener_obj, jint buff_size)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	if (java_vm == 0 && env->GetJavaVM(&java_vm) != JNI_OK)
+		return 0;
+	TalkRequest* request = new TalkRequest();
+	request->stream.env = 0;
+	request->stream.method = env->GetStaticMethodID(cls, "dispatchAudio",
+		"(Ljp/itplus/openjtalk/OpenJTalk$AudioListener;Ljava/nio/ByteBuffer;)V");
+	request->complete = env->GetStaticMethodID(cls, "dispatchComplete",
+		"(Ljp/itplus/openjtalk/OpenJTalk$RequestListener;IZ)V");
+	if (request->stream.method == 0 || request->complete == 0) {
+		delete request;
+		return 0;
+	}
+	request->stream.cls = (jclass)env->NewGlobalRef(cls);
+	request->stream.listener = audio_obj != 0 ? env->NewGlobalRef(audio_obj) : 0;
+	request->stream.ojt = ojt;
+	request->listener = listener_obj != 0 ? env->NewGlobalRef(listener_obj) : 0;
+	const char* text = env->GetStringUTFChars(text_obj, NULL);
+	int id = ojt->submit(text, audio_obj != 0 ? audio_callback : 0, complete_callback,
+		request, (int)buff_size);
+	env->ReleaseStringUTFChars(text_obj, text);
+	if (id == 0)
+		complete_callback(request, 0, false);
+	return (jint)id;
+}
+
+jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeCancel(
+	JNIEnv* env, jclass cls, jlong instance, jint id)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	return (jboolean)ojt->cancel((int)id);
+}
+
+jobjectArray JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkBatch(
+	JNIEnv* env, jclass cls, jlong instance, jobjectArray texts_obj)
+{
+	OpenJTalk* ojt = (OpenJTalk*)instance;
+	int count = env->GetArrayLength(texts_obj);
+	jclass short_array = env->FindClass("[S");
+	if (short_array == 0)
+		return 0;
+	BatchResult result;
+	result.env = env;
+	result.results = env->NewObjectArray(count, short_array, NULL);
+	result.buffer = 0;
+	env->DeleteLocalRef(short_array);
+	if (result.results == 0)
+		return 0;
+	// copy the texts so that no local references are held during synthesis
+	const char** texts = new const char*[count];
+	for (int i = 0; i < count; i++) {
+		jstring text_obj = (jstring)env->GetObjectArrayElement(texts_obj, i);
+		texts[i] = 0;
+		if (text_obj != 0) {
+			const char* text = env->GetStringUTFChars(text_obj, NULL);
+			if (text == 0) {
+				// OutOfMemoryError is pending, give up on the whole batch
+				env->DeleteLocalRef(text_obj);
+				for (int j = 0; j < i; j++)
+					free((void*)texts[j]);
+				delete[] texts;
+				return 0;
+			}
+			texts[i] = strdup(text);
+			env->ReleaseStringUTFChars(text_obj, text);
+			env->DeleteLocalRef(text_obj);
+		}
+	}
+	ojt->talkBatch(texts, count, batch_callback, &result);
+	for (int i = 0; i < count; i++)
+		free((void*)texts[i]);
+	delete[] texts;
+	return result.results;
+}
@@ -76,6 +76,78 @@ JNIEXPORT void JNICALL
 Java_jp_itplus_openjtalk_OpenJTalk_nativeSetAudioBufferSize(
 	JNIEnv* env, jclass cls, jlong instance, jint value);
 
+JNIEXPORT jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheSize(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetLabelCacheSize(
+	JNIEnv* env, jclass cls, jlong instance, jint value);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheHits(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLabelCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheSize(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetPdfCacheSize(
+	JNIEnv* env, jclass cls, jlong instance, jint value);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheHits(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetPdfCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetNumThreads(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetNumThreads(
+	JNIEnv* env, jclass cls, jlong instance, jint value);
+
+JNIEXPORT jdouble JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetGvTolerance(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetGvTolerance(
+	JNIEnv* env, jclass cls, jlong instance, jdouble value);
+
+JNIEXPORT jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLookahead(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT void JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetLookahead(
+	JNIEnv* env, jclass cls, jlong instance, jint value);
+
+JNIEXPORT jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSetWaveCache(
+	JNIEnv* env, jclass cls, jlong instance, jstring dir_obj, jlong size);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetWaveCacheHits(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jlong JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetWaveCacheMisses(
+	JNIEnv* env, jclass cls, jlong instance);
+
+JNIEXPORT jobject JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeGetLastStats(
+	JNIEnv* env, jclass cls, jlong instance);
+
 JNIEXPORT jboolean JNICALL
 Java_jp_itplus_openjtalk_OpenJTalk_nativeLoad(
 	JNIEnv* env, jclass cls, jlong instance,
@@ -86,5 +158,32 @@ Java_jp_itplus_openjtalk_OpenJTalk_nativeTalk(
 	JNIEnv* env, jclass cls, jlong instance,
 	jstring text_obj, jstring wavefile_obj, jstring logfile_obj);
 
+JNIEXPORT jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkStream(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject listener_obj, jint buff_size);
+
+JNIEXPORT jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkDocument(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject listener_obj, jint buff_size);
+
+JNIEXPORT jshortArray JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkToBuffer(
+	JNIEnv* env, jclass cls, jlong instance, jstring text_obj);
+
+JNIEXPORT jobjectArray JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeTalkBatch(
+	JNIEnv* env, jclass cls, jlong instance, jobjectArray texts_obj);
+
+JNIEXPORT jint JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeSubmit(
+	JNIEnv* env, jclass cls, jlong instance,
+	jstring text_obj, jobject audio_obj, jobject listener_obj, jint buff_size);
+
+JNIEXPORT jboolean JNICALL
+Java_jp_itplus_openjtalk_OpenJTalk_nativeCancel(
+	JNIEnv* env, jclass cls, jlong instance, jint id);
+
 }
 #endif	/* H_OPEN_JTALK_H */
@@ -319,7 +319,8 @@ HTS_Boolean Flite_HTS_Engine_synthesize(Flite_HTS_Engine * f, const char *txt, c
       Flite_HTS_Engine_create_label(f, s, label_data[i]);
    }
 
-   /* speech synthesis part */
+   /* speech synthesis part (label data is freed after refresh) */
+   HTS_Engine_set_label_storage(&f->engine, HTS_LABEL_BORROW);
    HTS_Engine_synthesize_from_strings(&f->engine, label_data, label_size);
    if (wav != NULL) {
       fp = fopen(wav, "wb");
@@ -7,12 +7,16 @@ LFLAGS = /LTCG
 
 LIBS = ..\lib\hts_engine_API.lib winmm.lib
 
-all: hts_engine.exe
+all: hts_engine.exe hts_compile_voice.exe
 
 hts_engine.exe : hts_engine.obj
 	$(CC) $(CFLAGS) /c $(@B).c
 	$(CL) $(LFLAGS) /OUT:$@ $(LIBS) $(@B).obj
 
+hts_compile_voice.exe : hts_compile_voice.obj
+	$(CC) $(CFLAGS) /c $(@B).c
+	$(CL) $(LFLAGS) /OUT:$@ $(LIBS) $(@B).obj
+
 clean:	
 	del *.exe
 	del *.obj
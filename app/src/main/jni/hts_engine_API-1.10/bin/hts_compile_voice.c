@@ -0,0 +1,173 @@
+/* ----------------------------------------------------------------- */
+/*           The HMM-Based Speech Synthesis Engine "hts_engine API"  */
+/*           developed by HTS Working Group                          */
+/*           http://hts-engine.sourceforge.net/                      */
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2001-2015  Nagoya Institute of Technology          */
+/*                           Department of Computer Science          */
+/*                                                                   */
+/*                2001-2008  Tokyo Institute of Technology           */
+/*                           Interdisciplinary Graduate School of    */
+/*                           Science and Engineering                 */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the HTS working group nor the names of its  */
+/*   contributors may be used to endorse or promote products derived */
+/*   from this software without specific prior written permission.   */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef HTS_COMPILE_VOICE_C
+#define HTS_COMPILE_VOICE_C
+
+#ifdef __cplusplus
+#define HTS_COMPILE_VOICE_C_START extern "C" {
+#define HTS_COMPILE_VOICE_C_END   }
+#else
+#define HTS_COMPILE_VOICE_C_START
+#define HTS_COMPILE_VOICE_C_END
+#endif                          /* __CPLUSPLUS */
+
+HTS_COMPILE_VOICE_C_START;
+
+#include <stdlib.h>
+
+#include "HTS_engine.h"
+
+/* usage: output usage */
+void usage(void)
+{
+   fprintf(stderr, "%s\n", HTS_COPYRIGHT);
+   fprintf(stderr, "hts_compile_voice - Converter of HTS voice into precompiled HTS voice\n");
+   fprintf(stderr, "\n");
+   fprintf(stderr, "  usage:\n");
+   fprintf(stderr, "    hts_compile_voice [ options ] [ infile ]\n");
+   fprintf(stderr, "  options:                                                                   [  def][ min-- max]\n");
+   fprintf(stderr, "    -o  s          : filename of output HTS voice                            [  N/A]\n");
+   fprintf(stderr, "    -q  i          : quantization of PDFs (0: float, 1: 16-bit, 2: 8-bit)    [    0][   0--   2]\n");
+   fprintf(stderr, "  infile:\n");
+   fprintf(stderr, "    HTS voice file\n");
+   fprintf(stderr, "  note:\n");
+   fprintf(stderr, "    trees and windows of output HTS voice are saved in binary format,\n");
+   fprintf(stderr, "    and its sections are aligned so that PDFs can be used in place.\n");
+   fprintf(stderr, "    output HTS voice can be loaded by hts_engine API in the same way.\n");
+   fprintf(stderr, "    quantization reduces size and memory of stream PDFs at small loss\n");
+   fprintf(stderr, "    of quality (durations and GV are not quantized).\n");
+   fprintf(stderr, "\n");
+
+   exit(0);
+}
+
+int main(int argc, char **argv)
+{
+   /* hts_engine API */
+   HTS_Engine engine;
+
+   /* input HTS voice file name */
+   char *voicefn = NULL;
+
+   /* output file pointer */
+   FILE *voicefp = NULL;
+   char *outfn = NULL;
+
+   /* quantization of PDFs */
+   size_t pdf_type = HTS_PDF_FLOAT;
+
+   /* output usage */
+   if (argc <= 1)
+      usage();
+
+   /* read command */
+   while (--argc) {
+      if (**++argv == '-') {
+         switch (*(*argv + 1)) {
+         case 'o':
+            outfn = *++argv;
+            --argc;
+            break;
+         case 'q':
+            switch (atoi(*++argv)) {
+            case 1:
+               pdf_type = HTS_PDF_HALF;
+               break;
+            case 2:
+               pdf_type = HTS_PDF_BYTE;
+               break;
+            default:
+               pdf_type = HTS_PDF_FLOAT;
+            }
+            --argc;
+            break;
+         case 'h':
+            usage();
+            break;
+         default:
+            fprintf(stderr, "Error: Invalid option '-%c'.\n", *(*argv + 1));
+            exit(1);
+         }
+      } else {
+         voicefn = *argv;
+      }
+   }
+   if (voicefn == NULL || outfn == NULL) {
+      fprintf(stderr, "Error: HTS voice and output file must be specified.\n");
+      exit(1);
+   }
+
+   /* load HTS voice */
+   HTS_Engine_initialize(&engine);
+   if (HTS_Engine_load(&engine, &voicefn, 1) != TRUE) {
+      fprintf(stderr, "Error: HTS voice cannot be loaded.\n");
+      HTS_Engine_clear(&engine);
+      exit(1);
+   }
+
+   /* save precompiled HTS voice */
+   voicefp = fopen(outfn, "wb");
+   if (voicefp == NULL) {
+      fprintf(stderr, "Error: Cannot open %s.\n", outfn);
+      HTS_Engine_clear(&engine);
+      exit(1);
+   }
+   if (HTS_Engine_save_voice(&engine, 0, pdf_type, voicefp) != TRUE) {
+      fprintf(stderr, "Error: HTS voice cannot be saved.\n");
+      fclose(voicefp);
+      HTS_Engine_clear(&engine);
+      exit(1);
+   }
+   fclose(voicefp);
+
+   /* free memory */
+   HTS_Engine_clear(&engine);
+
+   return 0;
+}
+
+HTS_COMPILE_VOICE_C_END;
+
+#endif                          /* !HTS_COMPILE_VOICE_C */
@@ -87,13 +87,19 @@ void usage(void)
    fprintf(stderr, "    -u  f          : voiced/unvoiced threshold                               [  0.5][ 0.0-- 1.0]\n");
    fprintf(stderr, "    -jm f          : weight of GV for spectrum                               [  1.0][ 0.0--    ]\n");
    fprintf(stderr, "    -jf f          : weight of GV for log F0                                 [  1.0][ 0.0--    ]\n");
+   fprintf(stderr, "    -jt f          : relative change of GV objective to stop (if f==0, off)  [  0.0][ 0.0--    ]\n");
    fprintf(stderr, "    -g  f          : volume (dB)                                             [  0.0][    --    ]\n");
    fprintf(stderr, "    -z  i          : audio buffer size (if i==0, turn off)                   [    0][   0--    ]\n");
+   fprintf(stderr, "    -t  i          : number of threads for parameter generation              [    1][   1--    ]\n");
+   fprintf(stderr, "    -l  i          : lookahead frames of windowed generation (0: off, >= 15) [    0][   0--    ]\n");
    fprintf(stderr, "  infile:\n");
    fprintf(stderr, "    label file\n");
    fprintf(stderr, "  note:\n");
    fprintf(stderr, "    generated spectrum, log F0, and low-pass filter coefficient\n");
    fprintf(stderr, "    sequences are saved in natural endian, binary (float) format.\n");
+   fprintf(stderr, "    with lookahead, they are not kept, and -om, -of, and -ol are errors.\n");
+   fprintf(stderr, "    lookahead shorter than 5 band widths of dynamic windows\n");
+   fprintf(stderr, "    (15 frames for windows of +-1 frame) is raised to it.\n");
    fprintf(stderr, "\n");
 
    exit(0);
@@ -266,6 +272,9 @@ int main(int argc, char **argv)
             case 'p':
                HTS_Engine_set_gv_weight(&engine, 1, atof(*++argv));
                break;
+            case 't':
+               HTS_Engine_set_gv_tolerance(&engine, atof(*++argv));
+               break;
             default:
                fprintf(stderr, "Error: Invalid option '-j%c'.\n", *(*argv + 2));
                HTS_Engine_clear(&engine);
@@ -281,6 +290,14 @@ int main(int argc, char **argv)
             HTS_Engine_set_audio_buff_size(&engine, (size_t) atoi(*++argv));
             --argc;
             break;
+         case 't':
+            HTS_Engine_set_num_threads(&engine, (size_t) atoi(*++argv));
+            --argc;
+            break;
+         case 'l':
+            HTS_Engine_set_lookahead(&engine, (size_t) atoi(*++argv));
+            --argc;
+            break;
          default:
             fprintf(stderr, "Error: Invalid option '-%c'.\n", *(*argv + 1));
             HTS_Engine_clear(&engine);
@@ -291,6 +308,13 @@ int main(int argc, char **argv)
       }
    }
 
+   /* generated parameters are not kept with lookahead */
+   if (HTS_Engine_get_lookahead(&engine) > 0 && (mgcfp != NULL || lf0fp != NULL || lpffp != NULL)) {
+      fprintf(stderr, "Error: Generated parameters cannot be saved with lookahead.\n");
+      HTS_Engine_clear(&engine);
+      exit(1);
+   }
+
    /* synthesize */
    if (HTS_Engine_synthesize_from_fn(&engine, labfn) != TRUE) {
       fprintf(stderr, "Error: waveform cannot be synthesized.\n");
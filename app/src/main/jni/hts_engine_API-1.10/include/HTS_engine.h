@@ -88,6 +88,9 @@ typedef struct _HTS_Audio {
    void *audio_interface;       /* audio interface specified in compile step */
 } HTS_Audio;
 
+/* HTS_AudioCallback: callback function to receive synthesized speech */
+typedef void (*HTS_AudioCallback) (void *user_data, const short *buff, size_t buff_size);
+
 /* model ----------------------------------------------------------- */
 
 /* HTS_Window: window coefficients to calculate dynamic features. */
@@ -102,34 +105,49 @@ typedef struct _HTS_Window {
 /* HTS_Pattern: list of patterns in a question and a tree. */
 typedef struct _HTS_Pattern {
    char *string;                /* pattern string */
+   size_t field;                /* field answering this pattern (0 if string matching is required) */
+   size_t value;                /* token value answering this pattern */
    struct _HTS_Pattern *next;   /* pointer to the next pattern */
 } HTS_Pattern;
 
 /* HTS_Question: list of questions in a tree. */
 typedef struct _HTS_Question {
    char *string;                /* name of this question */
+   size_t id;                   /* index shared by identical questions in model set */
    HTS_Pattern *head;           /* pointer to the head of pattern list */
    struct _HTS_Question *next;  /* pointer to the next question */
 } HTS_Question;
 
-/* HTS_Node: list of tree nodes in a tree. */
+/* HTS_ContextField: field of full-context label, i.e. alphanumeric token between delimiters. */
+typedef struct _HTS_ContextField {
+   char *left;                  /* delimiter before token ('\001' stands for head of label) */
+   char *right;                 /* delimiter after token ('\002' stands for tail of label) */
+   size_t left_length;          /* length of left delimiter */
+   size_t right_length;         /* length of right delimiter */
+} HTS_ContextField;
+
+/* HTS_Node: node of decision tree, stored in flat array of a tree. */
 typedef struct _HTS_Node {
-   int index;                   /* index of this node */
-   size_t pdf;                  /* index of PDF for this node (leaf node only) */
-   struct _HTS_Node *yes;       /* pointer to its child node (yes) */
-   struct _HTS_Node *no;        /* pointer to its child node (no) */
-   struct _HTS_Node *next;      /* pointer to the next node */
    HTS_Question *quest;         /* question applied at this node */
+   int yes;                     /* child node (yes): index of PDF if positive, otherwise minus index of node */
+   int no;                      /* child node (no): index of PDF if positive, otherwise minus index of node */
 } HTS_Node;
 
 /* HTS_Tree: list of decision trees in a model. */
 typedef struct _HTS_Tree {
    HTS_Pattern *head;           /* pointer to the head of pattern list for this tree */
    struct _HTS_Tree *next;      /* pointer to next tree */
-   HTS_Node *root;              /* root node of this tree */
+   HTS_Node *node;              /* nodes of this tree (root node first) */
+   size_t num_nodes;            /* # of nodes */
+   size_t pdf;                  /* index of PDF if this tree has no node */
    size_t state;                /* state index of this tree */
 } HTS_Tree;
 
+/* storage of PDFs */
+#define HTS_PDF_FLOAT 0         /* 32-bit floats */
+#define HTS_PDF_HALF  1         /* 16-bit floats scaled for each dimension */
+#define HTS_PDF_BYTE  2         /* 8-bit integers with scale and offset for each dimension (standard deviations for variances) */
+
 /* HTS_Model: set of PDFs, decision trees and questions. */
 typedef struct _HTS_Model {
    size_t vector_length;        /* vector length (static features only) */
@@ -137,7 +155,11 @@ typedef struct _HTS_Model {
    HTS_Boolean is_msd;          /* flag for MSD */
    size_t ntree;                /* # of trees */
    size_t *npdf;                /* # of PDFs at each tree */
-   float ***pdf;                /* PDFs */
+   size_t pdf_type;             /* storage of PDFs (HTS_PDF_FLOAT, HTS_PDF_HALF or HTS_PDF_BYTE) */
+   void **pdf;                  /* PDFs of each tree, stored contiguously */
+   void *pdf_block;             /* storage of PDFs (NULL if they refer to memory-mapped voice) */
+   float *pdf_scale;            /* scale of quantized PDFs for each dimension */
+   float *pdf_offset;           /* offset of quantized PDFs for each dimension */
    HTS_Tree *tree;              /* pointer to the list of trees */
    HTS_Question *question;      /* pointer to the list of questions */
 } HTS_Model;
@@ -159,22 +181,62 @@ typedef struct _HTS_ModelSet {
    HTS_Window *window;          /* window coefficients for delta */
    HTS_Model **stream;          /* parameter PDFs and trees */
    HTS_Model **gv;              /* GV PDFs and trees */
+   size_t reference_count;      /* # of engines using this model set */
+   void **voice_file;           /* memory-mapped voices referred by PDFs */
+   size_t num_context_fields;   /* # of fields answering compiled patterns */
+   HTS_ContextField *context_field;     /* fields answering compiled patterns */
+   size_t num_context_values;   /* # of token values of compiled patterns */
+   char **context_value;        /* sorted token values of compiled patterns */
+   size_t num_questions;        /* # of distinct questions */
+   HTS_Question **question;     /* distinct questions shared by all trees and voices, indexed by their id */
+   size_t num_pattern_strings;  /* # of distinct pattern strings */
+   char **pattern_string;       /* pattern strings shared by distinct questions */
 } HTS_ModelSet;
 
+/* HTS_PdfCacheEntry: tree and PDF indices resolved for a full-context label */
+typedef struct _HTS_PdfCacheEntry {
+   char *string;                /* full-context label */
+   size_t hash;                 /* hash value of label */
+   size_t *index;               /* tree and PDF indices of all models, followed by GV switch */
+   struct _HTS_PdfCacheEntry *chain;    /* next entry in the same hash bucket */
+   struct _HTS_PdfCacheEntry *prev;     /* more recently used entry */
+   struct _HTS_PdfCacheEntry *next;     /* less recently used entry */
+} HTS_PdfCacheEntry;
+
+/* HTS_PdfCache: recently used full-context labels and their tree and PDF indices */
+typedef struct _HTS_PdfCache {
+   size_t max_size;             /* max # of entries (0: disabled) */
+   size_t size;                 /* # of entries */
+   size_t num_indices;          /* # of indices of each entry */
+   size_t num_buckets;          /* # of hash buckets */
+   HTS_PdfCacheEntry **bucket;  /* hash buckets */
+   HTS_PdfCacheEntry *head;     /* most recently used entry */
+   HTS_PdfCacheEntry *tail;     /* least recently used entry */
+   size_t hits;                 /* # of labels found in cache */
+   size_t misses;               /* # of labels resolved by decision trees */
+} HTS_PdfCache;
+
 /* label ----------------------------------------------------------- */
 
+/* storage of label strings given to HTS_Engine_*_from_strings */
+#define HTS_LABEL_COPY   0      /* copy label strings */
+#define HTS_LABEL_BORROW 1      /* refer to label strings, which are kept by caller until HTS_Engine_refresh or HTS_Engine_reset */
+#define HTS_LABEL_OWN    2      /* refer to label strings, which are freed with their array by HTS_Engine_refresh or HTS_Engine_reset */
+
 /* HTS_LabelString: individual label string with time information */
 typedef struct _HTS_LabelString {
-   struct _HTS_LabelString *next;       /* pointer to next label string */
    char *name;                  /* label string */
    double start;                /* start frame specified in the given label */
    double end;                  /* end frame specified in the given label */
 } HTS_LabelString;
 
-/* HTS_Label: list of label strings */
+/* HTS_Label: array of label strings */
 typedef struct _HTS_Label {
-   HTS_LabelString *head;       /* pointer to the head of label string */
+   HTS_LabelString *string;     /* label strings */
    size_t size;                 /* # of label strings */
+   char *data;                  /* copied names of label strings */
+   char **lines;                /* owned lines (HTS_LABEL_OWN) */
+   size_t num_lines;            /* # of owned lines */
 } HTS_Label;
 
 /* sstream --------------------------------------------------------- */
@@ -203,6 +265,8 @@ typedef struct _HTS_SStreamSet {
    size_t *duration;            /* duration sequence */
    size_t total_state;          /* total state */
    size_t total_frame;          /* total frame */
+   size_t total_question;       /* total evaluated questions */
+   size_t capacity;             /* # of states buffers are allocated for (kept by reset) */
 } HTS_SStreamSet;
 
 /* pstream --------------------------------------------------------- */
@@ -211,9 +275,9 @@ typedef struct _HTS_SStreamSet {
 typedef struct _HTS_SMatrices {
    double **mean;               /* mean vector sequence */
    double **ivar;               /* inverse diag variance sequence */
-   double *g;                   /* vector used in the forward substitution */
-   double **wuw;                /* W' U^-1 W  */
-   double *wum;                 /* W' U^-1 mu */
+   double *g;                   /* vectors used in the forward substitution ([frame][dimension]) */
+   double *wuw;                 /* W' U^-1 W of all dimensions ([frame][band][dimension]) */
+   double *wum;                 /* W' U^-1 mu of all dimensions ([frame][dimension]) */
 } HTS_SMatrices;
 
 /* HTS_PStream: individual PDF stream. */
@@ -232,6 +296,10 @@ typedef struct _HTS_PStream {
    double *gv_vari;             /* variance vector of GV */
    HTS_Boolean *gv_switch;      /* GV flag sequence */
    size_t gv_length;            /* frame length for GV calculation */
+   double gv_tolerance;         /* relative change of objective to stop GV iteration (0: no early stop) */
+   size_t *gv_iteration;        /* # of GV iterations used for each dimension */
+   size_t capacity;             /* # of frames buffers of par and sm are allocated for (kept by reset) */
+   size_t msd_capacity;         /* # of frames buffer of msd_flag is allocated for (kept by reset) */
 } HTS_PStream;
 
 /* HTS_PStreamSet: set of PDF streams. */
@@ -239,6 +307,7 @@ typedef struct _HTS_PStreamSet {
    HTS_PStream *pstream;        /* PDF streams */
    size_t nstream;              /* # of PDF streams */
    size_t total_frame;          /* total frame */
+   size_t nbuffer;              /* # of PDF streams allocated (kept with their buffers by reset) */
 } HTS_PStreamSet;
 
 /* gstream --------------------------------------------------------- */
@@ -256,6 +325,9 @@ typedef struct _HTS_GStreamSet {
    size_t nstream;              /* # of streams */
    HTS_GStream *gstream;        /* generated parameter streams */
    double *gspeech;             /* generated speech */
+   size_t nbuffer;              /* # of streams allocated (kept with their buffers by reset) */
+   size_t capacity;             /* # of frames buffers of par are allocated for (kept by reset) */
+   size_t speech_capacity;      /* # of samples buffer of gspeech is allocated for (kept by reset) */
 } HTS_GStreamSet;
 
 /* engine ---------------------------------------------------------- */
@@ -266,13 +338,21 @@ typedef struct _HTS_Condition {
    size_t sampling_frequency;   /* sampling frequency */
    size_t fperiod;              /* frame period */
    size_t audio_buff_size;      /* audio buffer size (for audio device) */
+   HTS_Boolean audio_output;    /* send speech to audio device (if audio buffer size is not 0) */
+   HTS_AudioCallback audio_callback;    /* audio callback function */
+   void *audio_callback_data;   /* user data for audio callback */
+   size_t audio_callback_buff_size;     /* audio buffer size (for audio callback) */
    HTS_Boolean stop;            /* stop flag */
    double volume;               /* volume */
    double *msd_threshold;       /* MSD thresholds */
    double *gv_weight;           /* GV weights */
+   double gv_tolerance;         /* relative change of GV objective to stop iteration (0: no early stop) */
+   size_t num_threads;          /* # of threads for parameter generation */
+   size_t lookahead;            /* # of frames generated ahead of synthesized ones (0: whole utterance, at least 5 band widths of dynamic windows) */
 
    /* duration */
    HTS_Boolean phoneme_alignment_flag;  /* flag for using phoneme alignment in label */
+   int label_storage;           /* storage of label strings (HTS_LABEL_COPY, HTS_LABEL_BORROW or HTS_LABEL_OWN) */
    double speed;                /* speech speed */
 
    /* spectrum */
@@ -294,11 +374,13 @@ typedef struct _HTS_Condition {
 typedef struct _HTS_Engine {
    HTS_Condition condition;     /* synthesis condition */
    HTS_Audio audio;             /* audio output */
-   HTS_ModelSet ms;             /* set of duration models, HMMs and GV models */
+   HTS_ModelSet *ms;            /* set of duration models, HMMs and GV models (shared among engines) */
+   HTS_PdfCache pdf_cache;      /* tree and PDF indices of recently used labels (not shared) */
    HTS_Label label;             /* label */
    HTS_SStreamSet sss;          /* set of state streams */
    HTS_PStreamSet pss;          /* set of PDF streams */
    HTS_GStreamSet gss;          /* set of generated parameter streams */
+   void *thread_pool;           /* worker threads for parameter generation (created on demand, not shared) */
 } HTS_Engine;
 
 /* engine method --------------------------------------------------- */
@@ -309,6 +391,15 @@ void HTS_Engine_initialize(HTS_Engine * engine);
 /* HTS_Engine_load: load HTS voices */
 HTS_Boolean HTS_Engine_load(HTS_Engine * engine, char **voices, size_t num_voices);
 
+/* HTS_Engine_load_from_engine: share HTS voices loaded by other engine (calls for engines sharing voices must be serialized) */
+HTS_Boolean HTS_Engine_load_from_engine(HTS_Engine * engine, HTS_Engine * source);
+
+/* HTS_Engine_prefetch: advise that memory-mapped HTS voices will be used soon */
+void HTS_Engine_prefetch(HTS_Engine * engine);
+
+/* HTS_Engine_save_voice: save loaded HTS voice with precompiled trees and windows, and PDFs of streams stored as pdf_type */
+HTS_Boolean HTS_Engine_save_voice(HTS_Engine * engine, size_t voice_index, size_t pdf_type, FILE * fp);
+
 /* HTS_Engine_set_sampling_frequency: set sampling fraquency */
 void HTS_Engine_set_sampling_frequency(HTS_Engine * engine, size_t i);
 
@@ -327,7 +418,16 @@ void HTS_Engine_set_audio_buff_size(HTS_Engine * engine, size_t i);
 /* HTS_Engine_get_audio_buff_size: get audio buffer size */
 size_t HTS_Engine_get_audio_buff_size(HTS_Engine * engine);
 
-/* HTS_Engine_set_stop_flag: set stop flag */
+/* HTS_Engine_set_audio_output: set whether speech is sent to audio device (speech generated only to be read back should not be played) */
+void HTS_Engine_set_audio_output(HTS_Engine * engine, HTS_Boolean b);
+
+/* HTS_Engine_get_audio_output: get whether speech is sent to audio device */
+HTS_Boolean HTS_Engine_get_audio_output(HTS_Engine * engine);
+
+/* HTS_Engine_set_audio_callback: set callback function to receive speech while synthesizing */
+void HTS_Engine_set_audio_callback(HTS_Engine * engine, HTS_AudioCallback callback, void *user_data, size_t buff_size);
+
+/* HTS_Engine_set_stop_flag: set stop flag (may be called from another thread while synthesizing) */
 void HTS_Engine_set_stop_flag(HTS_Engine * engine, HTS_Boolean b);
 
 /* HTS_Engine_get_stop_flag: get stop flag */
@@ -351,12 +451,45 @@ void HTS_Engine_set_gv_weight(HTS_Engine * engine, size_t stream_index, double f
 /* HTS_Engine_get_gv_weight: get GV weight */
 double HTS_Engine_get_gv_weight(HTS_Engine * engine, size_t stream_index);
 
+/* HTS_Engine_set_gv_tolerance: set relative change of GV objective under which a dimension stops iterating (0: no early stop) */
+void HTS_Engine_set_gv_tolerance(HTS_Engine * engine, double f);
+
+/* HTS_Engine_get_gv_tolerance: get relative change of GV objective under which a dimension stops iterating */
+double HTS_Engine_get_gv_tolerance(HTS_Engine * engine);
+
 /* HTS_Engine_set_speed: set speech speed */
 void HTS_Engine_set_speed(HTS_Engine * engine, double f);
 
 /* HTS_Engine_set_phoneme_alignment_flag: set flag for using phoneme alignment in label */
 void HTS_Engine_set_phoneme_alignment_flag(HTS_Engine * engine, HTS_Boolean b);
 
+/* HTS_Engine_set_label_storage: set storage of label strings given to HTS_Engine_*_from_strings */
+void HTS_Engine_set_label_storage(HTS_Engine * engine, int storage);
+
+/* HTS_Engine_set_pdf_cache_size: set max number of labels whose tree and PDF indices are cached (0: disabled) */
+void HTS_Engine_set_pdf_cache_size(HTS_Engine * engine, size_t size);
+
+/* HTS_Engine_get_pdf_cache_size: get max number of labels whose tree and PDF indices are cached */
+size_t HTS_Engine_get_pdf_cache_size(HTS_Engine * engine);
+
+/* HTS_Engine_get_pdf_cache_hits: get number of labels found in PDF cache */
+size_t HTS_Engine_get_pdf_cache_hits(HTS_Engine * engine);
+
+/* HTS_Engine_get_pdf_cache_misses: get number of labels resolved by decision trees while PDF cache is enabled */
+size_t HTS_Engine_get_pdf_cache_misses(HTS_Engine * engine);
+
+/* HTS_Engine_set_num_threads: set number of threads for parameter generation (1: no worker threads, default; speedup is not measured) */
+void HTS_Engine_set_num_threads(HTS_Engine * engine, size_t num_threads);
+
+/* HTS_Engine_get_num_threads: get number of threads for parameter generation */
+size_t HTS_Engine_get_num_threads(HTS_Engine * engine);
+
+/* HTS_Engine_set_lookahead: set number of frames generated ahead of synthesized ones (0: whole utterance, otherwise generated parameters are not kept unless utterance is not longer than lookahead, and fewer frames than 5 band widths of dynamic windows, i.e. 15 for windows of +-1 frame, are raised to that) */
+void HTS_Engine_set_lookahead(HTS_Engine * engine, size_t lookahead);
+
+/* HTS_Engine_get_lookahead: get number of frames generated ahead of synthesized ones */
+size_t HTS_Engine_get_lookahead(HTS_Engine * engine);
+
 /* HTS_Engine_set_alpha: set alpha */
 void HTS_Engine_set_alpha(HTS_Engine * engine, double f);
 
@@ -393,6 +526,15 @@ double HTS_Engine_get_gv_interpolation_weight(HTS_Engine * engine, size_t voice_
 /* HTS_Engine_get_total_state: get total number of state */
 size_t HTS_Engine_get_total_state(HTS_Engine * engine);
 
+/* HTS_Engine_get_total_question: get total number of questions evaluated to find PDFs */
+size_t HTS_Engine_get_total_question(HTS_Engine * engine);
+
+/* HTS_Engine_get_gv_iteration: get number of GV iterations used for dimension of generated parameter */
+size_t HTS_Engine_get_gv_iteration(HTS_Engine * engine, size_t stream_index, size_t vector_index);
+
+/* HTS_Engine_get_total_gv_iteration: get total number of GV iterations used for all dimensions */
+size_t HTS_Engine_get_total_gv_iteration(HTS_Engine * engine);
+
 /* HTS_Engine_set_state_mean: set mean value of state */
 void HTS_Engine_set_state_mean(HTS_Engine * engine, size_t stream_index, size_t state_index, size_t vector_index, double f);
 
@@ -447,6 +589,9 @@ HTS_Boolean HTS_Engine_generate_parameter_sequence(HTS_Engine * engine);
 /* HTS_Engine_generate_sample_sequence: generate sample sequence (3rd synthesis step) */
 HTS_Boolean HTS_Engine_generate_sample_sequence(HTS_Engine * engine);
 
+/* HTS_Engine_play_speech: send speech synthesized beforehand to audio device and callback */
+HTS_Boolean HTS_Engine_play_speech(HTS_Engine * engine, const short *speech, size_t nsamples);
+
 /* HTS_Engine_save_information: save trace information */
 void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp);
 
@@ -465,6 +610,9 @@ void HTS_Engine_save_riff(HTS_Engine * engine, FILE * fp);
 /* HTS_Engine_refresh: free memory per one time synthesis */
 void HTS_Engine_refresh(HTS_Engine * engine);
 
+/* HTS_Engine_reset: free memory per one time synthesis, keeping buffers of state, parameter and generated streams for next one */
+void HTS_Engine_reset(HTS_Engine * engine);
+
 /* HTS_Engine_clear: free engine */
 void HTS_Engine_clear(HTS_Engine * engine);
 
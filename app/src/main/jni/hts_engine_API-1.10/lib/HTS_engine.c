@@ -69,14 +69,22 @@ void HTS_Engine_initialize(HTS_Engine * engine)
    engine->condition.sampling_frequency = 0;
    engine->condition.fperiod = 0;
    engine->condition.audio_buff_size = 0;
-   engine->condition.stop = FALSE;
+   engine->condition.audio_output = TRUE;
+   engine->condition.audio_callback = NULL;
+   engine->condition.audio_callback_data = NULL;
+   engine->condition.audio_callback_buff_size = 0;
+   HTS_STORE_STOP(&engine->condition.stop, FALSE);
    engine->condition.volume = 1.0;
    engine->condition.msd_threshold = NULL;
    engine->condition.gv_weight = NULL;
+   engine->condition.gv_tolerance = 0.0;
+   engine->condition.num_threads = 1;
+   engine->condition.lookahead = 0;
 
    /* duration */
    engine->condition.speed = 1.0;
    engine->condition.phoneme_alignment_flag = FALSE;
+   engine->condition.label_storage = HTS_LABEL_COPY;
 
    /* spectrum */
    engine->condition.stage = 0;
@@ -94,40 +102,37 @@ void HTS_Engine_initialize(HTS_Engine * engine)
 
    /* initialize audio */
    HTS_Audio_initialize(&engine->audio);
-   /* initialize model set */
-   HTS_ModelSet_initialize(&engine->ms);
+   /* model set is allocated when voices are loaded */
+   engine->ms = NULL;
+   /* initialize PDF cache */
+   HTS_PdfCache_initialize(&engine->pdf_cache);
    /* initialize label list */
    HTS_Label_initialize(&engine->label);
    /* initialize state sequence set */
    HTS_SStreamSet_initialize(&engine->sss);
    /* initialize pstream set */
    HTS_PStreamSet_initialize(&engine->pss);
+   /* worker threads are started by first parameter generation */
+   engine->thread_pool = NULL;
    /* initialize gstream set */
    HTS_GStreamSet_initialize(&engine->gss);
 }
 
-/* HTS_Engine_load: load HTS voices */
-HTS_Boolean HTS_Engine_load(HTS_Engine * engine, char **voices, size_t num_voices)
+/* HTS_Engine_initialize_condition: set synthesis condition from loaded voices */
+static void HTS_Engine_initialize_condition(HTS_Engine * engine)
 {
    size_t i, j;
-   size_t nstream;
+   size_t nstream, num_voices;
    double average_weight;
    const char *option, *find;
 
-   /* reset engine */
-   HTS_Engine_clear(engine);
-
-   /* load voices */
-   if (HTS_ModelSet_load(&engine->ms, voices, num_voices) != TRUE) {
-      HTS_Engine_clear(engine);
-      return FALSE;
-   }
-   nstream = HTS_ModelSet_get_nstream(&engine->ms);
+   nstream = HTS_ModelSet_get_nstream(engine->ms);
+   num_voices = HTS_ModelSet_get_nvoices(engine->ms);
    average_weight = 1.0 / num_voices;
 
    /* global */
-   engine->condition.sampling_frequency = HTS_ModelSet_get_sampling_frequency(&engine->ms);
-   engine->condition.fperiod = HTS_ModelSet_get_fperiod(&engine->ms);
+   engine->condition.sampling_frequency = HTS_ModelSet_get_sampling_frequency(engine->ms);
+   engine->condition.fperiod = HTS_ModelSet_get_fperiod(engine->ms);
    engine->condition.msd_threshold = (double *) HTS_calloc(nstream, sizeof(double));
    for (i = 0; i < nstream; i++)
       engine->condition.msd_threshold[i] = 0.5;
@@ -136,7 +141,7 @@ HTS_Boolean HTS_Engine_load(HTS_Engine * engine, char **voices, size_t num_voice
       engine->condition.gv_weight[i] = 1.0;
 
    /* spectrum */
-   option = HTS_ModelSet_get_option(&engine->ms, 0);
+   option = HTS_ModelSet_get_option(engine->ms, 0);
    find = strstr(option, "GAMMA=");
    if (find != NULL)
       engine->condition.stage = (size_t) atoi(&find[strlen("GAMMA=")]);
@@ -163,10 +168,64 @@ HTS_Boolean HTS_Engine_load(HTS_Engine * engine, char **voices, size_t num_voice
       for (j = 0; j < nstream; j++)
          engine->condition.gv_iw[i][j] = average_weight;
    }
+}
+
+/* HTS_Engine_load: load HTS voices */
+HTS_Boolean HTS_Engine_load(HTS_Engine * engine, char **voices, size_t num_voices)
+{
+   HTS_Boolean result;
+
+   /* reset engine */
+   HTS_Engine_clear(engine);
+
+   /* load voices (HTS_ModelSet_load resets the reference count) */
+   engine->ms = (HTS_ModelSet *) HTS_calloc(1, sizeof(HTS_ModelSet));
+   HTS_ModelSet_initialize(engine->ms);
+   result = HTS_ModelSet_load(engine->ms, voices, num_voices);
+   engine->ms->reference_count = 1;
+   if (result != TRUE) {
+      HTS_Engine_clear(engine);
+      return FALSE;
+   }
+
+   HTS_Engine_initialize_condition(engine);
+
+   return TRUE;
+}
+
+/* HTS_Engine_load_from_engine: share HTS voices loaded by other engine */
+HTS_Boolean HTS_Engine_load_from_engine(HTS_Engine * engine, HTS_Engine * source)
+{
+   HTS_ModelSet *ms = source->ms;
+
+   if (ms == NULL)
+      return FALSE;
+
+   /* reset engine (source may be this engine) */
+   ms->reference_count++;
+   HTS_Engine_clear(engine);
+
+   engine->ms = ms;
+   HTS_Engine_initialize_condition(engine);
 
    return TRUE;
 }
 
+/* HTS_Engine_prefetch: advise that memory-mapped HTS voices will be used soon */
+void HTS_Engine_prefetch(HTS_Engine * engine)
+{
+   if (engine->ms != NULL)
+      HTS_ModelSet_prefetch(engine->ms);
+}
+
+/* HTS_Engine_save_voice: save loaded HTS voice with precompiled trees and windows, and PDFs of streams stored as pdf_type */
+HTS_Boolean HTS_Engine_save_voice(HTS_Engine * engine, size_t voice_index, size_t pdf_type, FILE * fp)
+{
+   if (engine->ms == NULL)
+      return FALSE;
+   return HTS_ModelSet_save(engine->ms, voice_index, pdf_type, fp);
+}
+
 /* HTS_Engine_set_sampling_frequency: set sampling frequency */
 void HTS_Engine_set_sampling_frequency(HTS_Engine * engine, size_t i)
 {
@@ -209,16 +268,36 @@ size_t HTS_Engine_get_audio_buff_size(HTS_Engine * engine)
    return engine->condition.audio_buff_size;
 }
 
-/* HTS_Engine_set_stop_flag: set stop flag */
+/* HTS_Engine_set_audio_output: set whether speech is sent to audio device (speech generated only to be read back should not be played) */
+void HTS_Engine_set_audio_output(HTS_Engine * engine, HTS_Boolean b)
+{
+   engine->condition.audio_output = b;
+}
+
+/* HTS_Engine_get_audio_output: get whether speech is sent to audio device */
+HTS_Boolean HTS_Engine_get_audio_output(HTS_Engine * engine)
+{
+   return engine->condition.audio_output;
+}
+
+/* HTS_Engine_set_audio_callback: set callback function to receive speech while synthesizing */
+void HTS_Engine_set_audio_callback(HTS_Engine * engine, HTS_AudioCallback callback, void *user_data, size_t buff_size)
+{
+   engine->condition.audio_callback = callback;
+   engine->condition.audio_callback_data = user_data;
+   engine->condition.audio_callback_buff_size = buff_size;
+}
+
+/* HTS_Engine_set_stop_flag: set stop flag (may be called from another thread while synthesizing) */
 void HTS_Engine_set_stop_flag(HTS_Engine * engine, HTS_Boolean b)
 {
-   engine->condition.stop = b;
+   HTS_STORE_STOP(&engine->condition.stop, b);
 }
 
 /* HTS_Engine_get_stop_flag: get stop flag */
 HTS_Boolean HTS_Engine_get_stop_flag(HTS_Engine * engine)
 {
-   return engine->condition.stop;
+   return HTS_LOAD_STOP(&engine->condition.stop);
 }
 
 /* HTS_Engine_set_volume: set volume in db */
@@ -263,6 +342,20 @@ double HTS_Engine_get_gv_weight(HTS_Engine * engine, size_t stream_index)
    return engine->condition.gv_weight[stream_index];
 }
 
+/* HTS_Engine_set_gv_tolerance: set relative change of GV objective under which a dimension stops iterating (0: no early stop) */
+void HTS_Engine_set_gv_tolerance(HTS_Engine * engine, double f)
+{
+   if (f < 0.0)
+      f = 0.0;
+   engine->condition.gv_tolerance = f;
+}
+
+/* HTS_Engine_get_gv_tolerance: get relative change of GV objective under which a dimension stops iterating */
+double HTS_Engine_get_gv_tolerance(HTS_Engine * engine)
+{
+   return engine->condition.gv_tolerance;
+}
+
 /* HTS_Engine_set_speed: set speech speed */
 void HTS_Engine_set_speed(HTS_Engine * engine, double f)
 {
@@ -277,6 +370,66 @@ void HTS_Engine_set_phoneme_alignment_flag(HTS_Engine * engine, HTS_Boolean b)
    engine->condition.phoneme_alignment_flag = b;
 }
 
+/* HTS_Engine_set_label_storage: set storage of label strings given to HTS_Engine_*_from_strings */
+void HTS_Engine_set_label_storage(HTS_Engine * engine, int storage)
+{
+   engine->condition.label_storage = storage;
+}
+
+/* HTS_Engine_set_pdf_cache_size: set max number of labels whose tree and PDF indices are cached (0: disabled) */
+void HTS_Engine_set_pdf_cache_size(HTS_Engine * engine, size_t size)
+{
+   HTS_PdfCache_set_size(&engine->pdf_cache, size);
+}
+
+/* HTS_Engine_get_pdf_cache_size: get max number of labels whose tree and PDF indices are cached */
+size_t HTS_Engine_get_pdf_cache_size(HTS_Engine * engine)
+{
+   return engine->pdf_cache.max_size;
+}
+
+/* HTS_Engine_get_pdf_cache_hits: get number of labels found in PDF cache */
+size_t HTS_Engine_get_pdf_cache_hits(HTS_Engine * engine)
+{
+   return engine->pdf_cache.hits;
+}
+
+/* HTS_Engine_get_pdf_cache_misses: get number of labels resolved by decision trees while PDF cache is enabled */
+size_t HTS_Engine_get_pdf_cache_misses(HTS_Engine * engine)
+{
+   return engine->pdf_cache.misses;
+}
+
+/* HTS_Engine_set_num_threads: set number of threads for parameter generation (1: no worker threads, default; speedup is not measured) */
+void HTS_Engine_set_num_threads(HTS_Engine * engine, size_t num_threads)
+{
+   if (num_threads < 1)
+      num_threads = 1;
+   if (engine->condition.num_threads != num_threads) {
+      HTS_ThreadPool_delete((HTS_ThreadPool *) engine->thread_pool);
+      engine->thread_pool = NULL;
+   }
+   engine->condition.num_threads = num_threads;
+}
+
+/* HTS_Engine_get_num_threads: get number of threads for parameter generation */
+size_t HTS_Engine_get_num_threads(HTS_Engine * engine)
+{
+   return engine->condition.num_threads;
+}
+
+/* HTS_Engine_set_lookahead: set number of frames generated ahead of synthesized ones (0: whole utterance, otherwise generated parameters are not kept unless utterance is not longer than lookahead, and fewer frames than 5 band widths of dynamic windows are raised to that) */
+void HTS_Engine_set_lookahead(HTS_Engine * engine, size_t lookahead)
+{
+   engine->condition.lookahead = lookahead;
+}
+
+/* HTS_Engine_get_lookahead: get number of frames generated ahead of synthesized ones */
+size_t HTS_Engine_get_lookahead(HTS_Engine * engine)
+{
+   return engine->condition.lookahead;
+}
+
 /* HTS_Engine_set_alpha: set alpha */
 void HTS_Engine_set_alpha(HTS_Engine * engine, double f)
 {
@@ -357,6 +510,31 @@ size_t HTS_Engine_get_total_state(HTS_Engine * engine)
    return HTS_SStreamSet_get_total_state(&engine->sss);
 }
 
+/* HTS_Engine_get_total_question: get total number of questions evaluated to find PDFs */
+size_t HTS_Engine_get_total_question(HTS_Engine * engine)
+{
+   return HTS_SStreamSet_get_total_question(&engine->sss);
+}
+
+/* HTS_Engine_get_gv_iteration: get number of GV iterations used for dimension of generated parameter */
+size_t HTS_Engine_get_gv_iteration(HTS_Engine * engine, size_t stream_index, size_t vector_index)
+{
+   return HTS_PStreamSet_get_gv_iteration(&engine->pss, stream_index, vector_index);
+}
+
+/* HTS_Engine_get_total_gv_iteration: get total number of GV iterations used for all dimensions */
+size_t HTS_Engine_get_total_gv_iteration(HTS_Engine * engine)
+{
+   size_t i, j;
+   size_t n = 0;
+
+   for (i = 0; i < HTS_PStreamSet_get_nstream(&engine->pss); i++)
+      for (j = 0; j < HTS_PStreamSet_get_vector_length(&engine->pss, i); j++)
+         n += HTS_PStreamSet_get_gv_iteration(&engine->pss, i, j);
+
+   return n;
+}
+
 /* HTS_Engine_set_state_mean: set mean value of state */
 void HTS_Engine_set_state_mean(HTS_Engine * engine, size_t stream_index, size_t state_index, size_t vector_index, double f)
 {
@@ -378,31 +556,41 @@ size_t HTS_Engine_get_state_duration(HTS_Engine * engine, size_t state_index)
 /* HTS_Engine_get_nvoices: get number of voices */
 size_t HTS_Engine_get_nvoices(HTS_Engine * engine)
 {
-   return HTS_ModelSet_get_nvoices(&engine->ms);
+   if (engine->ms == NULL)
+      return 0;
+   return HTS_ModelSet_get_nvoices(engine->ms);
 }
 
 /* HTS_Engine_get_nstream: get number of stream */
 size_t HTS_Engine_get_nstream(HTS_Engine * engine)
 {
-   return HTS_ModelSet_get_nstream(&engine->ms);
+   if (engine->ms == NULL)
+      return 0;
+   return HTS_ModelSet_get_nstream(engine->ms);
 }
 
 /* HTS_Engine_get_nstate: get number of state */
 size_t HTS_Engine_get_nstate(HTS_Engine * engine)
 {
-   return HTS_ModelSet_get_nstate(&engine->ms);
+   if (engine->ms == NULL)
+      return 0;
+   return HTS_ModelSet_get_nstate(engine->ms);
 }
 
 /* HTS_Engine_get_fullcontext_label_format: get full context label format */
 const char *HTS_Engine_get_fullcontext_label_format(HTS_Engine * engine)
 {
-   return HTS_ModelSet_get_fullcontext_label_format(&engine->ms);
+   if (engine->ms == NULL)
+      return NULL;
+   return HTS_ModelSet_get_fullcontext_label_format(engine->ms);
 }
 
 /* HTS_Engine_get_fullcontext_label_version: get full context label version */
 const char *HTS_Engine_get_fullcontext_label_version(HTS_Engine * engine)
 {
-   return HTS_ModelSet_get_fullcontext_label_version(&engine->ms);
+   if (engine->ms == NULL)
+      return NULL;
+   return HTS_ModelSet_get_fullcontext_label_version(engine->ms);
 }
 
 /* HTS_Engine_get_total_frame: get total number of frame */
@@ -435,7 +623,7 @@ static HTS_Boolean HTS_Engine_generate_state_sequence(HTS_Engine * engine)
    size_t i, state_index, model_index;
    double f;
 
-   if (HTS_SStreamSet_create(&engine->sss, &engine->ms, &engine->label, engine->condition.phoneme_alignment_flag, engine->condition.speed, engine->condition.duration_iw, engine->condition.parameter_iw, engine->condition.gv_iw) != TRUE) {
+   if (HTS_SStreamSet_create(&engine->sss, engine->ms, &engine->pdf_cache, &engine->label, engine->condition.phoneme_alignment_flag, engine->condition.speed, engine->condition.duration_iw, engine->condition.parameter_iw, engine->condition.gv_iw) != TRUE) {
       HTS_Engine_refresh(engine);
       return FALSE;
    }
@@ -463,7 +651,7 @@ static HTS_Boolean HTS_Engine_generate_state_sequence(HTS_Engine * engine)
 /* HTS_Engine_generate_state_sequence_from_fn: genereate state sequence from file name (1st synthesis step) */
 HTS_Boolean HTS_Engine_generate_state_sequence_from_fn(HTS_Engine * engine, const char *fn)
 {
-   HTS_Engine_refresh(engine);
+   HTS_Engine_reset(engine);
    HTS_Label_load_from_fn(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, fn);
    return HTS_Engine_generate_state_sequence(engine);
 }
@@ -471,21 +659,67 @@ HTS_Boolean HTS_Engine_generate_state_sequence_from_fn(HTS_Engine * engine, cons
 /* HTS_Engine_generate_state_sequence_from_strings: generate state sequence from strings (1st synthesis step) */
 HTS_Boolean HTS_Engine_generate_state_sequence_from_strings(HTS_Engine * engine, char **lines, size_t num_lines)
 {
-   HTS_Engine_refresh(engine);
-   HTS_Label_load_from_strings(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, lines, num_lines);
+   HTS_Engine_reset(engine);
+   HTS_Label_load_from_strings(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, lines, num_lines, engine->condition.label_storage);
    return HTS_Engine_generate_state_sequence(engine);
 }
 
+/* HTS_Engine_get_thread_pool: get worker threads for parameter generation (started by first use) */
+static HTS_ThreadPool *HTS_Engine_get_thread_pool(HTS_Engine * engine)
+{
+   if (engine->thread_pool == NULL && engine->condition.num_threads > 1)
+      engine->thread_pool = (void *) HTS_ThreadPool_create(engine->condition.num_threads);
+   return (HTS_ThreadPool *) engine->thread_pool;
+}
+
+/* HTS_Engine_get_audio: get audio device speech is sent to (NULL if not used) */
+static HTS_Audio *HTS_Engine_get_audio(HTS_Engine * engine)
+{
+   if (engine->condition.audio_output == TRUE && engine->condition.audio_buff_size > 0)
+      return &engine->audio;
+   return NULL;
+}
+
 /* HTS_Engine_generate_parameter_sequence: generate parameter sequence (2nd synthesis step) */
 HTS_Boolean HTS_Engine_generate_parameter_sequence(HTS_Engine * engine)
 {
-   return HTS_PStreamSet_create(&engine->pss, &engine->sss, engine->condition.msd_threshold, engine->condition.gv_weight);
+   /* with lookahead shorter than utterance, parameters are generated window by window in 3rd synthesis step (otherwise single window is whole utterance) */
+   if (engine->condition.lookahead > 0 && HTS_SStreamSet_get_total_frame(&engine->sss) > HTS_GStreamSet_get_lookahead(&engine->sss, engine->condition.lookahead))
+      return TRUE;
+   HTS_Engine_get_thread_pool(engine);
+   return HTS_PStreamSet_create(&engine->pss, &engine->sss, engine->condition.msd_threshold, engine->condition.gv_weight, engine->condition.gv_tolerance, (HTS_ThreadPool *) engine->thread_pool);
 }
 
 /* HTS_Engine_generate_sample_sequence: generate sample sequence (3rd synthesis step) */
 HTS_Boolean HTS_Engine_generate_sample_sequence(HTS_Engine * engine)
 {
-   return HTS_GStreamSet_create(&engine->gss, &engine->pss, engine->condition.stage, engine->condition.use_log_gain, engine->condition.sampling_frequency, engine->condition.fperiod, engine->condition.alpha, engine->condition.beta, &engine->condition.stop, engine->condition.volume, engine->condition.audio_buff_size > 0 ? &engine->audio : NULL);
+   if (engine->condition.lookahead > 0 && HTS_PStreamSet_get_nstream(&engine->pss) == 0)
+      return HTS_GStreamSet_create_with_lookahead(&engine->gss, &engine->sss, engine->condition.msd_threshold, engine->condition.gv_weight, engine->condition.gv_tolerance, HTS_Engine_get_thread_pool(engine), engine->condition.lookahead, engine->condition.stage, engine->condition.use_log_gain, engine->condition.sampling_frequency, engine->condition.fperiod, engine->condition.alpha, engine->condition.beta, &engine->condition.stop, engine->condition.volume, HTS_Engine_get_audio(engine), engine->condition.audio_callback, engine->condition.audio_callback_data, engine->condition.audio_callback_buff_size);
+   return HTS_GStreamSet_create(&engine->gss, &engine->pss, HTS_Engine_get_thread_pool(engine), engine->condition.stage, engine->condition.use_log_gain, engine->condition.sampling_frequency, engine->condition.fperiod, engine->condition.alpha, engine->condition.beta, &engine->condition.stop, engine->condition.volume, HTS_Engine_get_audio(engine), engine->condition.audio_callback, engine->condition.audio_callback_data, engine->condition.audio_callback_buff_size);
+}
+
+/* HTS_Engine_play_speech: send speech synthesized beforehand to audio device and callback */
+HTS_Boolean HTS_Engine_play_speech(HTS_Engine * engine, const short *speech, size_t nsamples)
+{
+   size_t i, j, n;
+   size_t buff_size = engine->condition.audio_callback_buff_size;
+   HTS_Audio *audio = HTS_Engine_get_audio(engine);
+
+   /* deliver in callback sized blocks (one frame if size is not specified) */
+   if (engine->condition.audio_callback == NULL || buff_size == 0)
+      buff_size = engine->condition.fperiod;
+   for (i = 0; i < nsamples && HTS_LOAD_STOP(&engine->condition.stop) == FALSE; i += n) {
+      n = nsamples - i < buff_size ? nsamples - i : buff_size;
+      if (audio)
+         for (j = 0; j < n; j++)
+            HTS_Audio_write(audio, speech[i + j]);
+      if (engine->condition.audio_callback != NULL)
+         engine->condition.audio_callback(engine->condition.audio_callback_data, &speech[i], n);
+   }
+   if (audio)
+      HTS_Audio_flush(audio);
+
+   return HTS_LOAD_STOP(&engine->condition.stop) == FALSE ? TRUE : FALSE;
 }
 
 /* HTS_Engine_synthesize: synthesize speech */
@@ -509,7 +743,7 @@ static HTS_Boolean HTS_Engine_synthesize(HTS_Engine * engine)
 /* HTS_Engine_synthesize_from_fn: synthesize speech from file name */
 HTS_Boolean HTS_Engine_synthesize_from_fn(HTS_Engine * engine, const char *fn)
 {
-   HTS_Engine_refresh(engine);
+   HTS_Engine_reset(engine);
    HTS_Label_load_from_fn(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, fn);
    return HTS_Engine_synthesize(engine);
 }
@@ -517,8 +751,8 @@ HTS_Boolean HTS_Engine_synthesize_from_fn(HTS_Engine * engine, const char *fn)
 /* HTS_Engine_synthesize_from_strings: synthesize speech from strings */
 HTS_Boolean HTS_Engine_synthesize_from_strings(HTS_Engine * engine, char **lines, size_t num_lines)
 {
-   HTS_Engine_refresh(engine);
-   HTS_Label_load_from_strings(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, lines, num_lines);
+   HTS_Engine_reset(engine);
+   HTS_Label_load_from_strings(&engine->label, engine->condition.sampling_frequency, engine->condition.fperiod, lines, num_lines, engine->condition.label_storage);
    return HTS_Engine_synthesize(engine);
 }
 
@@ -528,10 +762,11 @@ void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp)
    size_t i, j, k, l, m, n;
    double temp;
    HTS_Condition *condition = &engine->condition;
-   HTS_ModelSet *ms = &engine->ms;
+   HTS_ModelSet *ms = engine->ms;
    HTS_Label *label = &engine->label;
    HTS_SStreamSet *sss = &engine->sss;
    HTS_PStreamSet *pss = &engine->pss;
+   HTS_Context context;
 
    /* global parameter */
    fprintf(fp, "[Global parameter]\n");
@@ -548,6 +783,7 @@ void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp)
    }
    fprintf(fp, "Postfiltering coefficient              -> %8.5f\n", (float) condition->beta);
    fprintf(fp, "Audio buffer size                      -> %8lu(sample)\n", (unsigned long) condition->audio_buff_size);
+   fprintf(fp, "Lookahead                              -> %8lu(frames)\n", (unsigned long) condition->lookahead);
    fprintf(fp, "\n");
 
    /* duration parameter */
@@ -598,6 +834,10 @@ void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp)
                condition->gv_iw[j][i] /= temp;
          for (j = 0; j < HTS_ModelSet_get_nvoices(ms); j++)
             fprintf(fp, "           GV interpolation weight[%2lu] -> %8.0f(%%)\n", (unsigned long) j, (float) (100 * condition->gv_iw[j][i]));
+         fprintf(fp, "           GV tolerance                -> %8.5f\n", (float) condition->gv_tolerance);
+         if (i < HTS_PStreamSet_get_nstream(pss))
+            for (j = 0; j < HTS_PStreamSet_get_vector_length(pss, i); j++)
+               fprintf(fp, "           GV iterations[%2lu]           -> %8lu\n", (unsigned long) j, (unsigned long) HTS_PStreamSet_get_gv_iteration(pss, i, j));
       } else {
          fprintf(fp, "           GV flag                     ->    FALSE\n");
       }
@@ -608,16 +848,18 @@ void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp)
    fprintf(fp, "[Generated sequence]\n");
    fprintf(fp, "Number of HMMs                         -> %8lu\n", (unsigned long) HTS_Label_get_size(label));
    fprintf(fp, "Number of stats                        -> %8lu\n", (unsigned long) HTS_Label_get_size(label) * HTS_ModelSet_get_nstate(ms));
-   fprintf(fp, "Length of this speech                  -> %8.3f(sec)\n", (float) ((double) HTS_PStreamSet_get_total_frame(pss) * condition->fperiod / condition->sampling_frequency));
-   fprintf(fp, "                                       -> %8lu(frames)\n", (unsigned long) HTS_PStreamSet_get_total_frame(pss) * condition->fperiod);
+   fprintf(fp, "Length of this speech                  -> %8.3f(sec)\n", (float) ((double) HTS_SStreamSet_get_total_frame(sss) * condition->fperiod / condition->sampling_frequency));
+   fprintf(fp, "                                       -> %8lu(frames)\n", (unsigned long) HTS_SStreamSet_get_total_frame(sss) * condition->fperiod);
 
+   HTS_Context_initialize(&context);
    for (i = 0; i < HTS_Label_get_size(label); i++) {
+      HTS_Context_set(&context, ms, HTS_Label_get_string(label, i));
       fprintf(fp, "HMM[%2lu]\n", (unsigned long) i);
       fprintf(fp, "  Name                                 -> %s\n", HTS_Label_get_string(label, i));
       fprintf(fp, "  Duration\n");
       for (j = 0; j < HTS_ModelSet_get_nvoices(ms); j++) {
          fprintf(fp, "    Interpolation[%2lu]\n", (unsigned long) j);
-         HTS_ModelSet_get_duration_index(ms, j, HTS_Label_get_string(label, i), &k, &l);
+         HTS_ModelSet_get_duration_index(ms, j, &context, &k, &l);
          fprintf(fp, "      Tree index                       -> %8lu\n", (unsigned long) k);
          fprintf(fp, "      PDF index                        -> %8lu\n", (unsigned long) l);
       }
@@ -634,13 +876,14 @@ void HTS_Engine_save_information(HTS_Engine * engine, FILE * fp)
             }
             for (l = 0; l < HTS_ModelSet_get_nvoices(ms); l++) {
                fprintf(fp, "      Interpolation[%2lu]\n", (unsigned long) l);
-               HTS_ModelSet_get_parameter_index(ms, l, k, j + 2, HTS_Label_get_string(label, i), &m, &n);
+               HTS_ModelSet_get_parameter_index(ms, l, k, j + 2, &context, &m, &n);
                fprintf(fp, "        Tree index                     -> %8lu\n", (unsigned long) m);
                fprintf(fp, "        PDF index                      -> %8lu\n", (unsigned long) n);
             }
          }
       }
    }
+   HTS_Context_clear(&context);
 }
 
 /* HTS_Engine_save_label: save label with time */
@@ -651,7 +894,7 @@ void HTS_Engine_save_label(HTS_Engine * engine, FILE * fp)
 
    HTS_Label *label = &engine->label;
    HTS_SStreamSet *sss = &engine->sss;
-   size_t nstate = HTS_ModelSet_get_nstate(&engine->ms);
+   size_t nstate = HTS_ModelSet_get_nstate(engine->ms);
    double rate = engine->condition.fperiod * 1.0e+07 / engine->condition.sampling_frequency;
 
    for (i = 0, state = 0, frame = 0; i < HTS_Label_get_size(label); i++) {
@@ -757,7 +1000,22 @@ void HTS_Engine_refresh(HTS_Engine * engine)
    /* free label list */
    HTS_Label_clear(&engine->label);
    /* stop flag */
-   engine->condition.stop = FALSE;
+   HTS_STORE_STOP(&engine->condition.stop, FALSE);
+}
+
+/* HTS_Engine_reset: free memory per one time synthesis, keeping buffers of state, parameter and generated streams for next one */
+void HTS_Engine_reset(HTS_Engine * engine)
+{
+   /* reset generated parameter stream set */
+   HTS_GStreamSet_reset(&engine->gss);
+   /* reset parameter stream set */
+   HTS_PStreamSet_reset(&engine->pss);
+   /* reset state stream set */
+   HTS_SStreamSet_reset(&engine->sss);
+   /* free label list */
+   HTS_Label_clear(&engine->label);
+   /* stop flag */
+   HTS_STORE_STOP(&engine->condition.stop, FALSE);
 }
 
 /* HTS_Engine_clear: free engine */
@@ -765,6 +1023,9 @@ void HTS_Engine_clear(HTS_Engine * engine)
 {
    size_t i;
 
+   /* free synthesis and buffers kept for next one */
+   HTS_Engine_refresh(engine);
+
    if (engine->condition.msd_threshold != NULL)
       HTS_free(engine->condition.msd_threshold);
    if (engine->condition.duration_iw != NULL)
@@ -772,17 +1033,25 @@ void HTS_Engine_clear(HTS_Engine * engine)
    if (engine->condition.gv_weight != NULL)
       HTS_free(engine->condition.gv_weight);
    if (engine->condition.parameter_iw != NULL) {
-      for (i = 0; i < HTS_ModelSet_get_nvoices(&engine->ms); i++)
+      for (i = 0; i < HTS_ModelSet_get_nvoices(engine->ms); i++)
          HTS_free(engine->condition.parameter_iw[i]);
       HTS_free(engine->condition.parameter_iw);
    }
    if (engine->condition.gv_iw != NULL) {
-      for (i = 0; i < HTS_ModelSet_get_nvoices(&engine->ms); i++)
+      for (i = 0; i < HTS_ModelSet_get_nvoices(engine->ms); i++)
          HTS_free(engine->condition.gv_iw[i]);
       HTS_free(engine->condition.gv_iw);
    }
 
-   HTS_ModelSet_clear(&engine->ms);
+   HTS_PdfCache_clear(&engine->pdf_cache);
+   HTS_ThreadPool_delete((HTS_ThreadPool *) engine->thread_pool);
+   if (engine->ms != NULL) {
+      engine->ms->reference_count--;
+      if (engine->ms->reference_count == 0) {
+         HTS_ModelSet_clear(engine->ms);
+         HTS_free(engine->ms);
+      }
+   }
    HTS_Audio_clear(&engine->audio);
    HTS_Engine_initialize(engine);
 }
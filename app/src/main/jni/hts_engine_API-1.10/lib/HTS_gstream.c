@@ -55,6 +55,9 @@
 
 HTS_GSTREAM_C_START;
 
+#include <math.h>               /* for sqrt() */
+#include <string.h>             /* for memset() */
+
 /* hts_engine libraries */
 #include "HTS_hidden.h"
 
@@ -66,35 +69,197 @@ void HTS_GStreamSet_initialize(HTS_GStreamSet * gss)
    gss->total_nsample = 0;
    gss->gstream = NULL;
    gss->gspeech = NULL;
+   gss->nbuffer = 0;
+   gss->capacity = 0;
+   gss->speech_capacity = 0;
+}
+
+/* HTS_GStreamSet_free_parameters: free buffers of generated parameters of all streams */
+static void HTS_GStreamSet_free_parameters(HTS_GStreamSet * gss)
+{
+   size_t i, j;
+
+   for (i = 0; i < gss->nbuffer; i++) {
+      if (gss->gstream[i].par != NULL) {
+         for (j = 0; j < gss->capacity; j++)
+            HTS_free(gss->gstream[i].par[j]);
+         HTS_free(gss->gstream[i].par);
+         gss->gstream[i].par = NULL;
+      }
+   }
+   gss->capacity = 0;
+}
+
+/* HTS_GStreamSet_alloc_streams: set streams of utterance (buffers kept by reset are reused if they are large enough for same streams, and buffers of generated parameters are allocated only if use_parameter is TRUE) */
+static void HTS_GStreamSet_alloc_streams(HTS_GStreamSet * gss, size_t nstream, const size_t *vector_length, size_t total_frame, size_t total_nsample, HTS_Boolean use_parameter)
+{
+   size_t i, j;
+
+   if (gss->gstream != NULL && gss->nbuffer != nstream)
+      HTS_GStreamSet_clear(gss);
+   if (gss->gstream == NULL) {
+      gss->gstream = (HTS_GStream *) HTS_calloc(nstream, sizeof(HTS_GStream));
+      gss->nbuffer = nstream;
+   }
+   gss->nstream = nstream;
+   gss->total_frame = total_frame;
+   gss->total_nsample = total_nsample;
+
+   /* generated parameters */
+   for (i = 0; i < nstream; i++)
+      if (gss->gstream[i].vector_length != vector_length[i])
+         break;
+   if (i < nstream || use_parameter == FALSE || gss->capacity < total_frame)
+      HTS_GStreamSet_free_parameters(gss);
+   for (i = 0; i < nstream; i++)
+      gss->gstream[i].vector_length = vector_length[i];
+   if (use_parameter == TRUE && gss->capacity < total_frame) {
+      for (i = 0; i < nstream; i++) {
+         gss->gstream[i].par = (double **) HTS_calloc(total_frame, sizeof(double *));
+         for (j = 0; j < total_frame; j++)
+            gss->gstream[i].par[j] = (double *) HTS_calloc(vector_length[i], sizeof(double));
+      }
+      gss->capacity = total_frame;
+   }
+
+   /* generated speech (samples left unsynthesized by stop are zero) */
+   if (gss->speech_capacity < total_nsample) {
+      if (gss->gspeech)
+         HTS_free(gss->gspeech);
+      gss->gspeech = (double *) HTS_calloc(total_nsample, sizeof(double));
+      gss->speech_capacity = total_nsample;
+   } else if (total_nsample > 0) {
+      memset(gss->gspeech, 0, total_nsample * sizeof(double));
+   }
+}
+
+/* HTS_GStreamSet_check: check streams for vocoder */
+static HTS_Boolean HTS_GStreamSet_check(HTS_GStreamSet * gss)
+{
+   if (gss->nstream != 2 && gss->nstream != 3) {
+      HTS_error(1, "HTS_GStreamSet_create: The number of streams should be 2 or 3.\n");
+      return FALSE;
+   }
+   if (gss->gstream[1].vector_length != 1) {
+      HTS_error(1, "HTS_GStreamSet_create: The size of lf0 static vector should be 1.\n");
+      return FALSE;
+   }
+   if (gss->nstream >= 3 && gss->gstream[2].vector_length % 2 == 0) {
+      HTS_error(1, "HTS_GStreamSet_create: The number of low-pass filter coefficient should be odd numbers.");
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/* HTS_GStreamConversion: spectra of frames converted to filter coefficients by one job */
+typedef struct _HTS_GStreamConversion {
+   double **spectrum;           /* spectral parameters of frames (postfiltered in place) */
+   double **coefficient;        /* filter coefficients of frames */
+   size_t first;                /* first frame */
+   size_t last;                 /* last frame + 1 */
+   size_t m;                    /* order of spectrum */
+   size_t stage;
+   HTS_Boolean use_log_gain;
+   size_t sampling_rate;
+   size_t fperiod;
+   double alpha;
+   double beta;
+} HTS_GStreamConversion;
+
+/* HTS_GStreamSet_run_conversion: run i-th conversion job (called from thread pool) */
+static void HTS_GStreamSet_run_conversion(void *data, size_t i)
+{
+   HTS_GStreamConversion *job = (HTS_GStreamConversion *) data + i;
+   HTS_Vocoder v;               /* each job has its own work buffers */
+   size_t t;
+
+   HTS_Vocoder_initialize(&v, job->m, job->stage, job->use_log_gain, job->sampling_rate, job->fperiod);
+   for (t = job->first; t < job->last; t++)
+      HTS_Vocoder_convert_frame(&v, job->m, job->spectrum[t], job->alpha, job->beta, job->coefficient[t]);
+   HTS_Vocoder_clear(&v);
+}
+
+/* HTS_GStreamSet_convert: convert spectra of frames 0 ... num_frames - 1 to filter coefficients (frames are independent, so they are split into ranges when pool is given) */
+static void HTS_GStreamSet_convert(double **spectrum, double **coefficient, size_t num_frames, size_t m, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_ThreadPool * pool)
+{
+   size_t i, num_jobs;
+   HTS_GStreamConversion *job;
+
+   num_jobs = (num_frames + JOB_MIN_FRAME - 1) / JOB_MIN_FRAME;
+   if (num_jobs > HTS_ThreadPool_get_num_threads(pool))
+      num_jobs = HTS_ThreadPool_get_num_threads(pool);
+   if (num_jobs == 0)
+      return;
+   job = (HTS_GStreamConversion *) HTS_calloc(num_jobs, sizeof(HTS_GStreamConversion));
+   for (i = 0; i < num_jobs; i++) {
+      job[i].spectrum = spectrum;
+      job[i].coefficient = coefficient;
+      job[i].first = num_frames * i / num_jobs;
+      job[i].last = num_frames * (i + 1) / num_jobs;
+      job[i].m = m;
+      job[i].stage = stage;
+      job[i].use_log_gain = use_log_gain;
+      job[i].sampling_rate = sampling_rate;
+      job[i].fperiod = fperiod;
+      job[i].alpha = alpha;
+      job[i].beta = beta;
+   }
+   HTS_ThreadPool_run(pool, HTS_GStreamSet_run_conversion, job, num_jobs);
+   HTS_free(job);
+}
+
+/* HTS_GStreamSet_synthesize_frame: synthesize speech of one frame from filter coefficients at its start and end, and send it to audio callback */
+static void HTS_GStreamSet_synthesize_frame(HTS_GStreamSet * gss, HTS_Vocoder * v, size_t frame, size_t fperiod, double lf0, double *c0, double *c1, size_t nlpf, double *lpf, double alpha, double volume, HTS_Audio * audio, HTS_AudioCallback callback, void *user_data, short *cbuff, size_t * cbuff_size, size_t callback_buff_size, HTS_Boolean * stop)
+{
+   size_t k;
+   double x;
+   double *speech = &gss->gspeech[frame * fperiod];
+
+   HTS_Vocoder_filter(v, gss->gstream[0].vector_length - 1, lf0, c0, c1, nlpf, lpf, alpha, volume, speech, audio);
+   if (cbuff != NULL) {
+      for (k = 0; k < fperiod; k++) {
+         x = speech[k];
+         if (x > 32767.0)
+            cbuff[(*cbuff_size)++] = 32767;
+         else if (x < -32768.0)
+            cbuff[(*cbuff_size)++] = -32768;
+         else
+            cbuff[(*cbuff_size)++] = (short) x;
+         if (*cbuff_size >= callback_buff_size) {
+            callback(user_data, cbuff, *cbuff_size);
+            *cbuff_size = 0;
+            if (HTS_LOAD_STOP(stop) == TRUE)
+               break;
+         }
+      }
+   }
 }
 
 /* HTS_GStreamSet_create: generate speech */
-HTS_Boolean HTS_GStreamSet_create(HTS_GStreamSet * gss, HTS_PStreamSet * pss, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio)
+HTS_Boolean HTS_GStreamSet_create(HTS_GStreamSet * gss, HTS_PStreamSet * pss, HTS_ThreadPool * pool, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio, HTS_AudioCallback callback, void *user_data, size_t callback_buff_size)
 {
-   size_t i, j, k;
+   size_t i, j, k, m;
    size_t msd_frame;
    HTS_Vocoder v;
    size_t nlpf = 0;
    double *lpf = NULL;
+   double **coefficient;
+   short *cbuff = NULL;
+   size_t cbuff_size = 0;
+   size_t *vector_length;
 
    /* check */
-   if (gss->gstream || gss->gspeech) {
+   if (gss->nstream != 0) {
       HTS_error(1, "HTS_GStreamSet_create: HTS_GStreamSet is not initialized.\n");
       return FALSE;
    }
 
    /* initialize */
-   gss->nstream = HTS_PStreamSet_get_nstream(pss);
-   gss->total_frame = HTS_PStreamSet_get_total_frame(pss);
-   gss->total_nsample = fperiod * gss->total_frame;
-   gss->gstream = (HTS_GStream *) HTS_calloc(gss->nstream, sizeof(HTS_GStream));
-   for (i = 0; i < gss->nstream; i++) {
-      gss->gstream[i].vector_length = HTS_PStreamSet_get_vector_length(pss, i);
-      gss->gstream[i].par = (double **) HTS_calloc(gss->total_frame, sizeof(double *));
-      for (j = 0; j < gss->total_frame; j++)
-         gss->gstream[i].par[j] = (double *) HTS_calloc(gss->gstream[i].vector_length, sizeof(double));
-   }
-   gss->gspeech = (double *) HTS_calloc(gss->total_nsample, sizeof(double));
+   vector_length = (size_t *) HTS_calloc(HTS_PStreamSet_get_nstream(pss), sizeof(size_t));
+   for (i = 0; i < HTS_PStreamSet_get_nstream(pss); i++)
+      vector_length[i] = HTS_PStreamSet_get_vector_length(pss, i);
+   HTS_GStreamSet_alloc_streams(gss, HTS_PStreamSet_get_nstream(pss), vector_length, HTS_PStreamSet_get_total_frame(pss), fperiod * HTS_PStreamSet_get_total_frame(pss), TRUE);
+   HTS_free(vector_length);
 
    /* copy generated parameter */
    for (i = 0; i < gss->nstream; i++) {
@@ -115,39 +280,235 @@ HTS_Boolean HTS_GStreamSet_create(HTS_GStreamSet * gss, HTS_PStreamSet * pss, si
    }
 
    /* check */
-   if (gss->nstream != 2 && gss->nstream != 3) {
-      HTS_error(1, "HTS_GStreamSet_create: The number of streams should be 2 or 3.\n");
+   if (HTS_GStreamSet_check(gss) != TRUE) {
       HTS_GStreamSet_clear(gss);
       return FALSE;
    }
-   if (HTS_PStreamSet_get_vector_length(pss, 1) != 1) {
-      HTS_error(1, "HTS_GStreamSet_create: The size of lf0 static vector should be 1.\n");
-      HTS_GStreamSet_clear(gss);
-      return FALSE;
-   }
-   if (gss->nstream >= 3 && gss->gstream[2].vector_length % 2 == 0) {
-      HTS_error(1, "HTS_GStreamSet_create: The number of low-pass filter coefficient should be odd numbers.");
-      HTS_GStreamSet_clear(gss);
-      return FALSE;
+
+   /* buffer for audio callback (one frame if size is not specified) */
+   if (callback != NULL) {
+      if (callback_buff_size == 0)
+         callback_buff_size = fperiod;
+      cbuff = (short *) HTS_calloc(callback_buff_size, sizeof(short));
    }
 
+   /* convert spectra of all frames to filter coefficients first (coefficient[0] is for start of first frame, and coefficient[i + 1] for end of frame i) */
+   m = gss->gstream[0].vector_length - 1;
+   coefficient = HTS_alloc_matrix(gss->total_frame + 1, m + 1);
+   HTS_Vocoder_initialize(&v, m, stage, use_log_gain, sampling_rate, fperiod);
+   if (gss->total_frame > 0)
+      HTS_Vocoder_convert_first_frame(&v, m, gss->gstream[0].par[0], alpha, coefficient[0]);
+   HTS_GStreamSet_convert(gss->gstream[0].par, coefficient + 1, gss->total_frame, m, stage, use_log_gain, sampling_rate, fperiod, alpha, beta, pool);
+
    /* synthesize speech waveform */
-   HTS_Vocoder_initialize(&v, gss->gstream[0].vector_length - 1, stage, use_log_gain, sampling_rate, fperiod);
    if (gss->nstream >= 3)
       nlpf = gss->gstream[2].vector_length;
-   for (i = 0; i < gss->total_frame && (*stop) == FALSE; i++) {
-      j = i * fperiod;
+   for (i = 0; i < gss->total_frame && HTS_LOAD_STOP(stop) == FALSE; i++) {
       if (gss->nstream >= 3)
          lpf = &gss->gstream[2].par[i][0];
-      HTS_Vocoder_synthesize(&v, gss->gstream[0].vector_length - 1, gss->gstream[1].par[i][0], &gss->gstream[0].par[i][0], nlpf, lpf, alpha, beta, volume, &gss->gspeech[j], audio);
+      HTS_GStreamSet_synthesize_frame(gss, &v, i, fperiod, gss->gstream[1].par[i][0], coefficient[i], coefficient[i + 1], nlpf, lpf, alpha, volume, audio, callback, user_data, cbuff, &cbuff_size, callback_buff_size, stop);
    }
    HTS_Vocoder_clear(&v);
+   HTS_free_matrix(coefficient, gss->total_frame + 1);
    if (audio)
       HTS_Audio_flush(audio);
+   if (cbuff != NULL) {
+      if (cbuff_size > 0 && HTS_LOAD_STOP(stop) == FALSE)
+         callback(user_data, cbuff, cbuff_size);
+      HTS_free(cbuff);
+   }
 
    return TRUE;
 }
 
+/* HTS_GStreamSet_get_lookahead: get lookahead raised to minimum for dynamic windows of streams (parameters of window depend on frames up to band width beyond its edges) */
+size_t HTS_GStreamSet_get_lookahead(HTS_SStreamSet * sss, size_t lookahead)
+{
+   size_t i;
+
+   for (i = 0; i < HTS_SStreamSet_get_nstream(sss); i++)
+      if (lookahead < LOOKAHEAD_MIN_WIDTH * (HTS_SStreamSet_get_window_max_width(sss, i) * 2 + 1))
+         lookahead = LOOKAHEAD_MIN_WIDTH * (HTS_SStreamSet_get_window_max_width(sss, i) * 2 + 1);
+   return lookahead;
+}
+
+/* HTS_GStreamSet_create_with_lookahead: generate parameters of overlapping windows and speech of each window before next one (GV is scaling by statistics of static means of states and of windows generated so far, and generated parameters are not kept) */
+HTS_Boolean HTS_GStreamSet_create_with_lookahead(HTS_GStreamSet * gss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool, size_t lookahead, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio, HTS_AudioCallback callback, void *user_data, size_t callback_buff_size)
+{
+   size_t i, k, t, m, vl;
+   size_t start, end, first, last, overlap, seen;
+   HTS_PStreamSet pss;
+   HTS_Vocoder v;
+   size_t nlpf = 0;
+   size_t *index;
+   double ***block;
+   double ***fade = NULL;
+   double **coefficient;
+   double **gv;
+   double *ratio;
+   double *par;
+   double w;
+   short *cbuff = NULL;
+   size_t cbuff_size = 0;
+   HTS_Boolean result = TRUE;
+   size_t *vector_length;
+
+   /* check */
+   if (gss->nstream != 0) {
+      HTS_error(1, "HTS_GStreamSet_create: HTS_GStreamSet is not initialized.\n");
+      return FALSE;
+   }
+   if (lookahead == 0) {
+      HTS_error(1, "HTS_GStreamSet_create_with_lookahead: Lookahead should be positive.\n");
+      return FALSE;
+   }
+
+   lookahead = HTS_GStreamSet_get_lookahead(sss, lookahead);
+
+   /* initialize (par of each stream is left NULL) */
+   vector_length = (size_t *) HTS_calloc(HTS_SStreamSet_get_nstream(sss), sizeof(size_t));
+   for (i = 0; i < HTS_SStreamSet_get_nstream(sss); i++)
+      vector_length[i] = HTS_SStreamSet_get_vector_length(sss, i);
+   HTS_GStreamSet_alloc_streams(gss, HTS_SStreamSet_get_nstream(sss), vector_length, HTS_SStreamSet_get_total_frame(sss), fperiod * HTS_SStreamSet_get_total_frame(sss), FALSE);
+   HTS_free(vector_length);
+   if (HTS_GStreamSet_check(gss) != TRUE) {
+      HTS_GStreamSet_clear(gss);
+      return FALSE;
+   }
+
+   /* buffer for audio callback (one frame if size is not specified) */
+   if (callback != NULL) {
+      if (callback_buff_size == 0)
+         callback_buff_size = fperiod;
+      cbuff = (short *) HTS_calloc(callback_buff_size, sizeof(short));
+   }
+
+   /* parameters of current block, and of first frames of next block generated by previous window */
+   overlap = lookahead / 2;
+   m = gss->gstream[0].vector_length - 1;
+   index = (size_t *) HTS_calloc(gss->nstream, sizeof(size_t));
+   block = (double ***) HTS_calloc(gss->nstream, sizeof(double **));
+   for (i = 0; i < gss->nstream; i++)
+      block[i] = HTS_alloc_matrix(lookahead, gss->gstream[i].vector_length);
+   coefficient = HTS_alloc_matrix(lookahead + 1, m + 1);
+   if (overlap > 0) {
+      fade = (double ***) HTS_calloc(gss->nstream, sizeof(double **));
+      for (i = 0; i < gss->nstream; i++)
+         fade[i] = HTS_alloc_matrix(overlap, gss->gstream[i].vector_length);
+   }
+
+   /* GV of window is scaling by ratio of GV to variance over whole utterance, which is that of static means of states weighted by durations, corrected by ratio of variance of generated parameters to that of static means over frames generated so far (gv[i] keeps mean, ratio, and both sums of each stream, and variance of window is not that of utterance) */
+   HTS_PStreamSet_initialize(&pss);
+   gv = (double **) HTS_calloc(gss->nstream, sizeof(double *));
+   for (i = 0, k = 0; i < gss->nstream; i++) {
+      gv[i] = (double *) HTS_calloc(4 * gss->gstream[i].vector_length, sizeof(double));
+      if (HTS_PStreamSet_get_gv_scaling(sss, i, msd_threshold[i], gv_weight[i], gv[i], gv[i] + gss->gstream[i].vector_length) != TRUE) {
+         HTS_free(gv[i]);
+         gv[i] = NULL;
+      }
+      if (k < gss->gstream[i].vector_length)
+         k = gss->gstream[i].vector_length;
+   }
+   ratio = (double *) HTS_calloc(k, sizeof(double));
+
+   /* frames start ... end - 1 are synthesized from window first ... last - 1 (overlap frames of left context and lookahead frames of right context) */
+   HTS_Vocoder_initialize(&v, m, stage, use_log_gain, sampling_rate, fperiod);
+   if (gss->nstream >= 3)
+      nlpf = gss->gstream[2].vector_length;
+   for (start = 0, seen = 0; start < gss->total_frame && HTS_LOAD_STOP(stop) == FALSE && result == TRUE; start = end) {
+      end = start + lookahead < gss->total_frame ? start + lookahead : gss->total_frame;
+      first = start > overlap ? start - overlap : 0;
+      last = end + lookahead < gss->total_frame ? end + lookahead : gss->total_frame;
+      if (HTS_PStreamSet_create_window(&pss, sss, msd_threshold, gv_weight, gv_tolerance, pool, first, last - first, FALSE) != TRUE) {
+         result = FALSE;
+         break;
+      }
+
+      /* GV (frames seen - first ... of window are generated for first time) */
+      for (i = 0; i < gss->nstream; i++) {
+         if (gv[i] == NULL)
+            continue;
+         vl = gss->gstream[i].vector_length;
+         HTS_PStreamSet_accumulate_gv(&pss, i, seen - first, gv[i], gv[i] + 2 * vl, gv[i] + 3 * vl);
+         for (k = 0; k < vl; k++) {
+            ratio[k] = gv[i][vl + k];
+            if (gv[i][2 * vl + k] > 0.0 && gv[i][3 * vl + k] > 0.0)
+               ratio[k] *= sqrt(gv[i][3 * vl + k] / gv[i][2 * vl + k]);
+         }
+         HTS_PStreamSet_scale_gv(&pss, i, gv[i], ratio);
+      }
+      seen = last;
+
+      /* skip left context */
+      for (i = 0; i < gss->nstream; i++) {
+         index[i] = 0;
+         for (t = first; t < start; t++)
+            if (!HTS_PStreamSet_is_msd(&pss, i) || HTS_PStreamSet_get_msd_flag(&pss, i, t - first))
+               index[i]++;
+      }
+
+      /* frames of block, and frames kept for cross-fade of next block */
+      for (t = start; t < last && t < end + overlap; t++) {
+         for (i = 0; i < gss->nstream; i++) {
+            par = t < end ? block[i][t - start] : fade[i][t - end];
+            if (!HTS_PStreamSet_is_msd(&pss, i) || HTS_PStreamSet_get_msd_flag(&pss, i, t - first)) {
+               for (k = 0; k < gss->gstream[i].vector_length; k++)
+                  par[k] = HTS_PStreamSet_get_parameter(&pss, i, index[i], k);
+               index[i]++;
+            } else {
+               for (k = 0; k < gss->gstream[i].vector_length; k++)
+                  par[k] = HTS_NODATA;
+            }
+            /* cross-fade from parameters generated by previous window (MSD flags do not depend on window) */
+            if (start > 0 && t - start < overlap && par[0] != HTS_NODATA) {
+               w = (double) (t - start + 1) / (overlap + 1);
+               for (k = 0; k < gss->gstream[i].vector_length; k++)
+                  par[k] = (1.0 - w) * fade[i][t - start][k] + w * par[k];
+            }
+         }
+      }
+      HTS_PStreamSet_reset(&pss);
+      if (HTS_LOAD_STOP(stop) == TRUE)
+         break;
+
+      /* convert spectra of block to filter coefficients (coefficient[0] is for end of last frame of previous block), and then filter */
+      if (start == 0)
+         HTS_Vocoder_convert_first_frame(&v, m, block[0][0], alpha, coefficient[0]);
+      HTS_GStreamSet_convert(block[0], coefficient + 1, end - start, m, stage, use_log_gain, sampling_rate, fperiod, alpha, beta, pool);
+      for (t = start; t < end && HTS_LOAD_STOP(stop) == FALSE; t++)
+         HTS_GStreamSet_synthesize_frame(gss, &v, t, fperiod, block[1][t - start][0], coefficient[t - start], coefficient[t - start + 1], nlpf, gss->nstream >= 3 ? block[2][t - start] : NULL, alpha, volume, audio, callback, user_data, cbuff, &cbuff_size, callback_buff_size, stop);
+      for (k = 0; k <= m; k++)
+         coefficient[0][k] = coefficient[end - start][k];
+   }
+   HTS_PStreamSet_clear(&pss);
+   HTS_Vocoder_clear(&v);
+   if (audio)
+      HTS_Audio_flush(audio);
+   if (cbuff != NULL) {
+      if (cbuff_size > 0 && HTS_LOAD_STOP(stop) == FALSE)
+         callback(user_data, cbuff, cbuff_size);
+      HTS_free(cbuff);
+   }
+
+   for (i = 0; i < gss->nstream; i++) {
+      HTS_free_matrix(block[i], lookahead);
+      if (fade != NULL)
+         HTS_free_matrix(fade[i], overlap);
+   }
+   HTS_free(block);
+   HTS_free_matrix(coefficient, lookahead + 1);
+   if (fade != NULL)
+      HTS_free(fade);
+   HTS_free(index);
+   for (i = 0; i < gss->nstream; i++)
+      if (gv[i] != NULL)
+         HTS_free(gv[i]);
+   HTS_free(gv);
+   HTS_free(ratio);
+
+   return result;
+}
+
 /* HTS_GStreamSet_get_total_nsamples: get total number of sample */
 size_t HTS_GStreamSet_get_total_nsamples(HTS_GStreamSet * gss)
 {
@@ -175,24 +536,25 @@ double HTS_GStreamSet_get_speech(HTS_GStreamSet * gss, size_t sample_index)
 /* HTS_GStreamSet_get_parameter: get generated parameter */
 double HTS_GStreamSet_get_parameter(HTS_GStreamSet * gss, size_t stream_index, size_t frame_index, size_t vector_index)
 {
+   if (gss->gstream[stream_index].par == NULL)
+      return HTS_NODATA;
    return gss->gstream[stream_index].par[frame_index][vector_index];
 }
 
+/* HTS_GStreamSet_reset: free generated parameter stream set for next utterance, keeping buffers of frames and samples */
+void HTS_GStreamSet_reset(HTS_GStreamSet * gss)
+{
+   gss->nstream = 0;
+   gss->total_frame = 0;
+   gss->total_nsample = 0;
+}
+
 /* HTS_GStreamSet_clear: free generated parameter stream set */
 void HTS_GStreamSet_clear(HTS_GStreamSet * gss)
 {
-   size_t i, j;
-
-   if (gss->gstream) {
-      for (i = 0; i < gss->nstream; i++) {
-         if (gss->gstream[i].par != NULL) {
-            for (j = 0; j < gss->total_frame; j++)
-               HTS_free(gss->gstream[i].par[j]);
-            HTS_free(gss->gstream[i].par);
-         }
-      }
+   HTS_GStreamSet_free_parameters(gss);
+   if (gss->gstream)
       HTS_free(gss->gstream);
-   }
    if (gss->gspeech)
       HTS_free(gss->gspeech);
    HTS_GStreamSet_initialize(gss);
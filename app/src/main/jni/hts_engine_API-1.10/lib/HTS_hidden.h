@@ -69,6 +69,15 @@ HTS_HIDDEN_H_START;
 #undef WORDS_BIGENDIAN
 #endif                          /* WORDS_BIGENDIAN && WORDS_LITTLEENDIAN */
 
+/* stop flag is written by another thread while synthesizing */
+#if defined(__GNUC__)
+#define HTS_LOAD_STOP(stop)     __atomic_load_n((stop), __ATOMIC_RELAXED)
+#define HTS_STORE_STOP(stop, b) __atomic_store_n((stop), (b), __ATOMIC_RELAXED)
+#else
+#define HTS_LOAD_STOP(stop)     (*(stop))
+#define HTS_STORE_STOP(stop, b) (*(stop) = (b))
+#endif                          /* __GNUC__ */
+
 #define MAX_F0    20000.0
 #define MIN_F0    20.0
 #define MAX_LF0   9.9034875525361280454891979401956     /* log(20000.0) */
@@ -86,6 +95,9 @@ typedef struct _HTS_File {
 /* HTS_fopen: wrapper for fopen */
 HTS_File *HTS_fopen_from_fn(const char *name, const char *opt);
 
+/* HTS_fmap_from_fn: map file to memory read-only, or open it when mapping is not available */
+HTS_File *HTS_fmap_from_fn(const char *name);
+
 /* HTS_fopen_from_fp: wrapper for fopen */
 HTS_File *HTS_fopen_from_fp(HTS_File * fp, size_t size);
 
@@ -107,6 +119,12 @@ int HTS_fseek(HTS_File * fp, long offset, int origin);
 /* HTS_ftell: wrapper for ftell */
 size_t HTS_ftell(HTS_File * fp);
 
+/* HTS_fdata: return pointer to data at current position of mapped file and skip it */
+const void *HTS_fdata(HTS_File * fp, size_t size);
+
+/* HTS_fprefetch: advise that data of mapped file will be accessed soon */
+void HTS_fprefetch(HTS_File * fp);
+
 /* HTS_fread_big_endian: fread with byteswap */
 size_t HTS_fread_big_endian(void *buf, size_t size, size_t n, HTS_File * fp);
 
@@ -149,6 +167,20 @@ void HTS_free(void *p);
 /* HTS_error: output error message */
 void HTS_error(int error, const char *message, ...);
 
+typedef struct _HTS_ThreadPool HTS_ThreadPool;
+
+/* HTS_ThreadPool_create: start num_threads - 1 worker threads (NULL when num_threads <= 1 or threads are not available) */
+HTS_ThreadPool *HTS_ThreadPool_create(size_t num_threads);
+
+/* HTS_ThreadPool_get_num_threads: get number of threads running jobs including caller */
+size_t HTS_ThreadPool_get_num_threads(HTS_ThreadPool * pool);
+
+/* HTS_ThreadPool_run: call func(data, i) for i = 0 ... num_jobs - 1 on pool and caller, and wait for all of them (serially when pool is NULL) */
+void HTS_ThreadPool_run(HTS_ThreadPool * pool, void (*func) (void *, size_t), void *data, size_t num_jobs);
+
+/* HTS_ThreadPool_delete: stop worker threads and free pool */
+void HTS_ThreadPool_delete(HTS_ThreadPool * pool);
+
 /* audio ----------------------------------------------------------- */
 
 /* HTS_Audio_initialize: initialize audio */
@@ -168,12 +200,53 @@ void HTS_Audio_clear(HTS_Audio * audio);
 
 /* model ----------------------------------------------------------- */
 
+/* HTS_Context: full-context label split into fields for compiled patterns */
+typedef struct _HTS_Context {
+   const char *string;          /* full-context label */
+   size_t num_fields;           /* # of fields */
+   size_t *start;               /* start of token values of each field in value */
+   size_t *value;               /* token values found in fields */
+   size_t size;                 /* allocated length of value */
+   size_t *token;               /* start, end and value of each token */
+   size_t token_size;           /* allocated length of token */
+   size_t num_questions;        /* # of distinct questions */
+   unsigned char *answer;       /* answer of each question (0: not asked, 1: false, 2: true) */
+   size_t *index;               /* tree and PDF indices of all models (NULL if decision trees are searched on demand) */
+} HTS_Context;
+
+/* HTS_Context_initialize: initialize context */
+void HTS_Context_initialize(HTS_Context * context);
+
+/* HTS_Context_set: split full-context label into fields used by model set */
+void HTS_Context_set(HTS_Context * context, HTS_ModelSet * ms, const char *string);
+
+/* HTS_Context_clear: free context */
+void HTS_Context_clear(HTS_Context * context);
+
+/* HTS_PdfCache_initialize: initialize PDF cache */
+void HTS_PdfCache_initialize(HTS_PdfCache * cache);
+
+/* HTS_PdfCache_set_size: set max number of entries, removing least recently used ones */
+void HTS_PdfCache_set_size(HTS_PdfCache * cache, size_t max_size);
+
+/* HTS_PdfCache_set_context: set context of label, taking tree and PDF indices from cache if possible */
+void HTS_PdfCache_set_context(HTS_PdfCache * cache, HTS_ModelSet * ms, HTS_Context * context, const char *string, size_t * nquestion);
+
+/* HTS_PdfCache_clear: free PDF cache */
+void HTS_PdfCache_clear(HTS_PdfCache * cache);
+
 /* HTS_ModelSet_initialize: initialize model set */
 void HTS_ModelSet_initialize(HTS_ModelSet * ms);
 
 /* HTS_ModelSet_load: load HTS voices */
 HTS_Boolean HTS_ModelSet_load(HTS_ModelSet * ms, char **voices, size_t num_voices);
 
+/* HTS_ModelSet_prefetch: advise that memory-mapped HTS voices will be used soon */
+void HTS_ModelSet_prefetch(HTS_ModelSet * ms);
+
+/* HTS_ModelSet_save: save voice with trees and windows in binary sections, and PDFs of streams stored as pdf_type */
+HTS_Boolean HTS_ModelSet_save(HTS_ModelSet * ms, size_t voice_index, size_t pdf_type, FILE * fp);
+
 /* HTS_ModelSet_get_sampling_frequency: get sampling frequency of HTS voices */
 size_t HTS_ModelSet_get_sampling_frequency(HTS_ModelSet * ms);
 
@@ -184,7 +257,7 @@ size_t HTS_ModelSet_get_fperiod(HTS_ModelSet * ms);
 const char *HTS_ModelSet_get_option(HTS_ModelSet * ms, size_t stream_index);
 
 /* HTS_ModelSet_get_gv_flag: get GV flag */
-HTS_Boolean HTS_ModelSet_get_gv_flag(HTS_ModelSet * ms, const char *string);
+HTS_Boolean HTS_ModelSet_get_gv_flag(HTS_ModelSet * ms, const HTS_Context * context, size_t * nquestion);
 
 /* HTS_ModelSet_get_nstate: get number of state */
 size_t HTS_ModelSet_get_nstate(HTS_ModelSet * ms);
@@ -226,21 +299,21 @@ size_t HTS_ModelSet_get_window_max_width(HTS_ModelSet * ms, size_t stream_index)
 HTS_Boolean HTS_ModelSet_use_gv(HTS_ModelSet * ms, size_t stream_index);
 
 /* HTS_ModelSet_get_duration_index: get index of duration tree and PDF */
-void HTS_ModelSet_get_duration_index(HTS_ModelSet * ms, size_t voice_index, const char *string, size_t * tree_index, size_t * pdf_index);
+void HTS_ModelSet_get_duration_index(HTS_ModelSet * ms, size_t voice_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index);
 
 /* HTS_ModelSet_get_duration: get duration using interpolation weight */
-void HTS_ModelSet_get_duration(HTS_ModelSet * ms, const char *string, const double *iw, double *mean, double *vari);
+void HTS_ModelSet_get_duration(HTS_ModelSet * ms, const HTS_Context * context, const double *iw, double *mean, double *vari, size_t * nquestion);
 
 /* HTS_ModelSet_get_parameter_index: get index of parameter tree and PDF */
-void HTS_ModelSet_get_parameter_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, size_t state_index, const char *string, size_t * tree_index, size_t * pdf_index);
+void HTS_ModelSet_get_parameter_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, size_t state_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index);
 
 /* HTS_ModelSet_get_parameter: get parameter using interpolation weight */
-void HTS_ModelSet_get_parameter(HTS_ModelSet * ms, size_t stream_index, size_t state_index, const char *string, const double *const *iw, double *mean, double *vari, double *msd);
+void HTS_ModelSet_get_parameter(HTS_ModelSet * ms, size_t stream_index, size_t state_index, const HTS_Context * context, const double *const *iw, double *mean, double *vari, double *msd, size_t * nquestion);
 
-void HTS_ModelSet_get_gv_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, const char *string, size_t * tree_index, size_t * pdf_index);
+void HTS_ModelSet_get_gv_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index);
 
 /* HTS_ModelSet_get_gv: get GV using interpolation weight */
-void HTS_ModelSet_get_gv(HTS_ModelSet * ms, size_t stream_index, const char *string, const double *const *iw, double *mean, double *vari);
+void HTS_ModelSet_get_gv(HTS_ModelSet * ms, size_t stream_index, const HTS_Context * context, const double *const *iw, double *mean, double *vari, size_t * nquestion);
 
 /* HTS_ModelSet_clear: free model set */
 void HTS_ModelSet_clear(HTS_ModelSet * ms);
@@ -254,7 +327,7 @@ void HTS_Label_initialize(HTS_Label * label);
 void HTS_Label_load_from_fn(HTS_Label * label, size_t sampling_rate, size_t fperiod, const char *fn);
 
 /* HTS_Label_load_from_strings: load label list from string list */
-void HTS_Label_load_from_strings(HTS_Label * label, size_t sampling_rate, size_t fperiod, char **lines, size_t num_lines);
+void HTS_Label_load_from_strings(HTS_Label * label, size_t sampling_rate, size_t fperiod, char **lines, size_t num_lines, int storage);
 
 /* HTS_Label_get_size: get number of label string */
 size_t HTS_Label_get_size(HTS_Label * label);
@@ -277,7 +350,7 @@ void HTS_Label_clear(HTS_Label * label);
 void HTS_SStreamSet_initialize(HTS_SStreamSet * sss);
 
 /* HTS_SStreamSet_create: parse label and determine state duration */
-HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_Label * label, HTS_Boolean phoneme_alignment_flag, double speed, double *duration_iw, double **parameter_iw, double **gv_iw);
+HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_PdfCache * cache, HTS_Label * label, HTS_Boolean phoneme_alignment_flag, double speed, double *duration_iw, double **parameter_iw, double **gv_iw);
 
 /* HTS_SStreamSet_get_nstream: get number of stream */
 size_t HTS_SStreamSet_get_nstream(HTS_SStreamSet * sss);
@@ -294,6 +367,9 @@ size_t HTS_SStreamSet_get_total_state(HTS_SStreamSet * sss);
 /* HTS_SStreamSet_get_total_frame: get total number of frame */
 size_t HTS_SStreamSet_get_total_frame(HTS_SStreamSet * sss);
 
+/* HTS_SStreamSet_get_total_question: get total number of evaluated questions */
+size_t HTS_SStreamSet_get_total_question(HTS_SStreamSet * sss);
+
 /* HTS_SStreamSet_get_msd: get msd parameter */
 double HTS_SStreamSet_get_msd(HTS_SStreamSet * sss, size_t stream_index, size_t state_index);
 
@@ -342,6 +418,9 @@ void HTS_SStreamSet_set_gv_switch(HTS_SStreamSet * sss, size_t stream_index, siz
 /* HTS_SStreamSet_get_gv_switch: get GV switch */
 HTS_Boolean HTS_SStreamSet_get_gv_switch(HTS_SStreamSet * sss, size_t stream_index, size_t state_index);
 
+/* HTS_SStreamSet_reset: free state stream set for next utterance, keeping buffers of states */
+void HTS_SStreamSet_reset(HTS_SStreamSet * sss);
+
 /* HTS_SStreamSet_clear: free state stream set */
 void HTS_SStreamSet_clear(HTS_SStreamSet * sss);
 
@@ -361,11 +440,26 @@ void HTS_SStreamSet_clear(HTS_SStreamSet * sss);
 #define W2       1.0
 #define GV_MAX_ITERATION 5
 
+/* threading */
+#define JOB_MIN_DIMENSION 8     /* dimensions per job are a multiple of this (8 doubles fill a 64-byte cache line) */
+
 /* HTS_PStreamSet_initialize: initialize parameter stream set */
 void HTS_PStreamSet_initialize(HTS_PStreamSet * pss);
 
-/* HTS_PStreamSet_create: parameter generation using GV weight */
-HTS_Boolean HTS_PStreamSet_create(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight);
+/* HTS_PStreamSet_create: parameter generation using GV weight (dimensions are solved in parallel when pool is given) */
+HTS_Boolean HTS_PStreamSet_create(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool);
+
+/* HTS_PStreamSet_create_window: parameter generation of frames first_frame ... first_frame + num_frames - 1 only (window edges are treated as utterance edges, and GV is solved in window if use_gv is TRUE) */
+HTS_Boolean HTS_PStreamSet_create_window(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool, size_t first_frame, size_t num_frames, HTS_Boolean use_gv);
+
+/* HTS_PStreamSet_get_gv_scaling: get mean and ratio to scale parameters of stream generated without GV so that their variance matches GV, from static means of states weighted by durations (FALSE if stream has no GV) */
+HTS_Boolean HTS_PStreamSet_get_gv_scaling(HTS_SStreamSet * sss, size_t stream_index, double msd_threshold, double gv_weight, double *mean, double *ratio);
+
+/* HTS_PStreamSet_accumulate_gv: accumulate squared deviations from mean of parameters and of static means of their states over frames of window from first_frame */
+void HTS_PStreamSet_accumulate_gv(HTS_PStreamSet * pss, size_t stream_index, size_t first_frame, const double *mean, double *par_sum, double *state_sum);
+
+/* HTS_PStreamSet_scale_gv: scale parameters of stream using GV by ratio around mean */
+void HTS_PStreamSet_scale_gv(HTS_PStreamSet * pss, size_t stream_index, const double *mean, const double *ratio);
 
 /* HTS_PStreamSet_get_nstream: get number of stream */
 size_t HTS_PStreamSet_get_nstream(HTS_PStreamSet * pss);
@@ -388,16 +482,34 @@ HTS_Boolean HTS_PStreamSet_get_msd_flag(HTS_PStreamSet * pss, size_t stream_inde
 /* HTS_PStreamSet_is_msd: get MSD flag */
 HTS_Boolean HTS_PStreamSet_is_msd(HTS_PStreamSet * pss, size_t stream_index);
 
+/* HTS_PStreamSet_get_gv_iteration: get number of GV iterations used for dimension of stream */
+size_t HTS_PStreamSet_get_gv_iteration(HTS_PStreamSet * pss, size_t stream_index, size_t vector_index);
+
+/* HTS_PStreamSet_reset: free parameter stream set for next utterance, keeping buffers of frames */
+void HTS_PStreamSet_reset(HTS_PStreamSet * pss);
+
 /* HTS_PStreamSet_clear: free parameter stream set */
 void HTS_PStreamSet_clear(HTS_PStreamSet * pss);
 
 /* gstream --------------------------------------------------------- */
 
+/* threading */
+#define JOB_MIN_FRAME 32        /* frames per job of spectral conversion are at least this */
+
+/* lookahead */
+#define LOOKAHEAD_MIN_WIDTH 5   /* lookahead is at least this times band width of dynamic windows */
+
 /* HTS_GStreamSet_initialize: initialize generated parameter stream set */
 void HTS_GStreamSet_initialize(HTS_GStreamSet * gss);
 
 /* HTS_GStreamSet_create: generate speech */
-HTS_Boolean HTS_GStreamSet_create(HTS_GStreamSet * gss, HTS_PStreamSet * pss, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio);
+HTS_Boolean HTS_GStreamSet_create(HTS_GStreamSet * gss, HTS_PStreamSet * pss, HTS_ThreadPool * pool, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio, HTS_AudioCallback callback, void *user_data, size_t callback_buff_size);
+
+/* HTS_GStreamSet_get_lookahead: get lookahead raised to minimum for dynamic windows of streams */
+size_t HTS_GStreamSet_get_lookahead(HTS_SStreamSet * sss, size_t lookahead);
+
+/* HTS_GStreamSet_create_with_lookahead: generate parameters of overlapping windows and speech of each window before next one (GV is scaling by statistics of static means of states and of windows generated so far, and generated parameters are not kept) */
+HTS_Boolean HTS_GStreamSet_create_with_lookahead(HTS_GStreamSet * gss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool, size_t lookahead, size_t stage, HTS_Boolean use_log_gain, size_t sampling_rate, size_t fperiod, double alpha, double beta, HTS_Boolean * stop, double volume, HTS_Audio * audio, HTS_AudioCallback callback, void *user_data, size_t callback_buff_size);
 
 /* HTS_GStreamSet_get_total_nsamples: get total number of sample */
 size_t HTS_GStreamSet_get_total_nsamples(HTS_GStreamSet * gss);
@@ -414,6 +526,9 @@ double HTS_GStreamSet_get_speech(HTS_GStreamSet * gss, size_t sample_index);
 /* HTS_GStreamSet_get_parameter: get generated parameter */
 double HTS_GStreamSet_get_parameter(HTS_GStreamSet * gss, size_t stream_index, size_t frame_index, size_t vector_index);
 
+/* HTS_GStreamSet_reset: free generated parameter stream set for next utterance, keeping buffers of frames and samples */
+void HTS_GStreamSet_reset(HTS_GStreamSet * gss);
+
 /* HTS_GStreamSet_clear: free generated parameter stream set */
 void HTS_GStreamSet_clear(HTS_GStreamSet * gss);
 
@@ -499,6 +614,15 @@ typedef struct _HTS_Vocoder {
 /* HTS_Vocoder_initialize: initialize vocoder */
 void HTS_Vocoder_initialize(HTS_Vocoder * v, size_t m, size_t stage, HTS_Boolean use_log_gain, size_t rate, size_t fperiod);
 
+/* HTS_Vocoder_convert_first_frame: convert spectral parameters of first frame to filter coefficients (without postfiltering) */
+void HTS_Vocoder_convert_first_frame(HTS_Vocoder * v, size_t m, double *spectrum, double alpha, double *c);
+
+/* HTS_Vocoder_convert_frame: postfilter spectral parameters of frame in place and convert them to filter coefficients */
+void HTS_Vocoder_convert_frame(HTS_Vocoder * v, size_t m, double *spectrum, double alpha, double beta, double *c);
+
+/* HTS_Vocoder_filter: pulse/noise excitation and MLSA/MGLSA filter whose coefficients move from c0 to c1 over frame */
+void HTS_Vocoder_filter(HTS_Vocoder * v, size_t m, double lf0, double *c0, double *c1, size_t nlpf, double *lpf, double alpha, double volume, double *rawdata, HTS_Audio * audio);
+
 /* HTS_Vocoder_synthesize: pulse/noise excitation and MLSA/MGLSA filster based waveform synthesis */
 void HTS_Vocoder_synthesize(HTS_Vocoder * v, size_t m, double lf0, double *spectrum, size_t nlpf, double *lpf, double alpha, double beta, double volume, double *rawdata, HTS_Audio * audio);
 
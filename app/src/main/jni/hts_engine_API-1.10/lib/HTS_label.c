@@ -56,11 +56,14 @@
 HTS_LABEL_C_START;
 
 #include <stdlib.h>             /* for atof() */
+#include <string.h>             /* for strlen(),strspn(),strcspn(),memcpy() */
 #include <ctype.h>              /* for isgraph(),isdigit() */
 
 /* hts_engine libraries */
 #include "HTS_hidden.h"
 
+#define HTS_LABEL_SEPARATOR " \n\t"
+
 static HTS_Boolean isdigit_string(char *str)
 {
    int i;
@@ -74,22 +77,25 @@ static HTS_Boolean isdigit_string(char *str)
 /* HTS_Label_initialize: initialize label */
 void HTS_Label_initialize(HTS_Label * label)
 {
-   label->head = NULL;
+   label->string = NULL;
    label->size = 0;
+   label->data = NULL;
+   label->lines = NULL;
+   label->num_lines = 0;
 }
 
 /* HTS_Label_check_time: check label */
 static void HTS_Label_check_time(HTS_Label * label)
 {
-   HTS_LabelString *lstring = label->head;
-   HTS_LabelString *next = NULL;
+   HTS_LabelString *lstring;
+   HTS_LabelString *next;
+   size_t i;
 
-   if (lstring)
-      lstring->start = 0.0;
-   while (lstring) {
-      next = lstring->next;
-      if (!next)
-         break;
+   if (label->size > 0)
+      label->string[0].start = 0.0;
+   for (i = 0; i + 1 < label->size; i++) {
+      lstring = &label->string[i];
+      next = &label->string[i + 1];
       if (lstring->end < 0.0 && next->start >= 0.0)
          lstring->end = next->start;
       else if (lstring->end >= 0.0 && next->start < 0.0)
@@ -98,7 +104,6 @@ static void HTS_Label_check_time(HTS_Label * label)
          lstring->start = -1.0;
       if (lstring->end < 0.0)
          lstring->end = -1.0;
-      lstring = next;
    }
 }
 
@@ -107,10 +112,15 @@ static void HTS_Label_load(HTS_Label * label, size_t sampling_rate, size_t fperi
 {
    char buff[HTS_MAXBUFLEN];
    HTS_LabelString *lstring = NULL;
+   char *data;
+   size_t i, length;
+   size_t max_size = 0;
+   size_t data_size = 0;
+   size_t max_data_size = 0;
    double start, end;
    const double rate = (double) sampling_rate / ((double) fperiod * 1e+7);
 
-   if (label->head || label->size != 0) {
+   if (label->string || label->size != 0) {
       HTS_error(1, "HTS_Label_load_from_fp: label is not initialized.\n");
       return;
    }
@@ -119,28 +129,49 @@ static void HTS_Label_load(HTS_Label * label, size_t sampling_rate, size_t fperi
    while (HTS_get_token_from_fp(fp, buff)) {
       if (!isgraph((int) buff[0]))
          break;
-      label->size++;
-
-      if (lstring) {
-         lstring->next = (HTS_LabelString *) HTS_calloc(1, sizeof(HTS_LabelString));
-         lstring = lstring->next;
-      } else {                  /* first time */
-         lstring = (HTS_LabelString *) HTS_calloc(1, sizeof(HTS_LabelString));
-         label->head = lstring;
-      }
       if (isdigit_string(buff)) {       /* has frame infomation */
          start = atof(buff);
          HTS_get_token_from_fp(fp, buff);
          end = atof(buff);
          HTS_get_token_from_fp(fp, buff);
-         lstring->start = rate * start;
-         lstring->end = rate * end;
+         start *= rate;
+         end *= rate;
       } else {
-         lstring->start = -1.0;
-         lstring->end = -1.0;
+         start = -1.0;
+         end = -1.0;
+      }
+      length = strlen(buff) + 1;
+
+      /* extend label string array and name block */
+      if (label->size >= max_size) {
+         max_size = (max_size == 0) ? 64 : max_size * 2;
+         lstring = (HTS_LabelString *) HTS_calloc(max_size, sizeof(HTS_LabelString));
+         if (label->string != NULL) {
+            memcpy(lstring, label->string, label->size * sizeof(HTS_LabelString));
+            HTS_free(label->string);
+         }
+         label->string = lstring;
       }
-      lstring->next = NULL;
-      lstring->name = HTS_strdup(buff);
+      if (data_size + length > max_data_size) {
+         max_data_size = (max_data_size == 0) ? 1024 : max_data_size;
+         while (data_size + length > max_data_size)
+            max_data_size *= 2;
+         data = (char *) HTS_calloc(max_data_size, sizeof(char));
+         if (label->data != NULL) {
+            memcpy(data, label->data, data_size);
+            for (i = 0; i < label->size; i++)
+               label->string[i].name = data + (label->string[i].name - label->data);
+            HTS_free(label->data);
+         }
+         label->data = data;
+      }
+
+      lstring = &label->string[label->size++];
+      lstring->name = label->data + data_size;
+      memcpy(lstring->name, buff, length);
+      lstring->start = start;
+      lstring->end = end;
+      data_size += length;
    }
    HTS_Label_check_time(label);
 }
@@ -153,49 +184,76 @@ void HTS_Label_load_from_fn(HTS_Label * label, size_t sampling_rate, size_t fper
    HTS_fclose(fp);
 }
 
+/* HTS_Label_parse_line: find name and frame information in label line */
+static char *HTS_Label_parse_line(char *line, double rate, double *start, double *end, size_t * length)
+{
+   char *name = line;
+
+   if (isdigit_string(line)) {  /* has frame infomation */
+      name += strspn(name, HTS_LABEL_SEPARATOR);
+      *start = rate * atof(name);
+      name += strcspn(name, HTS_LABEL_SEPARATOR);
+      name += strspn(name, HTS_LABEL_SEPARATOR);
+      *end = rate * atof(name);
+      name += strcspn(name, HTS_LABEL_SEPARATOR);
+      name += strspn(name, HTS_LABEL_SEPARATOR);
+      *length = strcspn(name, HTS_LABEL_SEPARATOR);
+   } else {
+      *start = -1.0;
+      *end = -1.0;
+      *length = strlen(name);
+   }
+   return name;
+}
+
 /* HTS_Label_load_from_strings: load label from strings */
-void HTS_Label_load_from_strings(HTS_Label * label, size_t sampling_rate, size_t fperiod, char **lines, size_t num_lines)
+void HTS_Label_load_from_strings(HTS_Label * label, size_t sampling_rate, size_t fperiod, char **lines, size_t num_lines, int storage)
 {
-   char buff[HTS_MAXBUFLEN];
-   HTS_LabelString *lstring = NULL;
-   size_t i;
-   size_t data_index;
+   HTS_LabelString *lstring;
+   char *name;
+   size_t i, length;
+   size_t data_size = 0;
    double start, end;
    const double rate = (double) sampling_rate / ((double) fperiod * 1e+7);
 
-   if (label->head || label->size != 0) {
+   if (label->string || label->size != 0) {
       HTS_error(1, "HTS_Label_load_from_fp: label list is not initialized.\n");
       return;
    }
-   /* copy label */
+   if (storage == HTS_LABEL_OWN) {
+      label->lines = lines;
+      label->num_lines = num_lines;
+   }
+
+   /* count label strings and names to be copied */
    for (i = 0; i < num_lines; i++) {
       if (!isgraph((int) lines[i][0]))
          break;
-      label->size++;
+      name = HTS_Label_parse_line(lines[i], rate, &start, &end, &length);
+      if (storage == HTS_LABEL_COPY || name[length] != '\0')
+         data_size += length + 1;
+   }
+   label->size = i;
+   if (label->size == 0)
+      return;
+   label->string = (HTS_LabelString *) HTS_calloc(label->size, sizeof(HTS_LabelString));
+   if (data_size > 0)
+      label->data = (char *) HTS_calloc(data_size, sizeof(char));
 
-      if (lstring) {
-         lstring->next = (HTS_LabelString *) HTS_calloc(1, sizeof(HTS_LabelString));
-         lstring = lstring->next;
-      } else {                  /* first time */
-         lstring = (HTS_LabelString *) HTS_calloc(1, sizeof(HTS_LabelString));
-         label->head = lstring;
-      }
-      data_index = 0;
-      if (isdigit_string(lines[i])) {   /* has frame infomation */
-         HTS_get_token_from_string(lines[i], &data_index, buff);
-         start = atof(buff);
-         HTS_get_token_from_string(lines[i], &data_index, buff);
-         end = atof(buff);
-         HTS_get_token_from_string(lines[i], &data_index, buff);
-         lstring->name = HTS_strdup(buff);
-         lstring->start = rate * start;
-         lstring->end = rate * end;
+   /* names which run to the end of line are referred to unless they are copied */
+   for (i = 0, data_size = 0; i < label->size; i++) {
+      lstring = &label->string[i];
+      name = HTS_Label_parse_line(lines[i], rate, &start, &end, &length);
+      if (storage == HTS_LABEL_COPY || name[length] != '\0') {
+         lstring->name = label->data + data_size;
+         memcpy(lstring->name, name, length);
+         lstring->name[length] = '\0';
+         data_size += length + 1;
       } else {
-         lstring->start = -1.0;
-         lstring->end = -1.0;
-         lstring->name = HTS_strdup(lines[i]);
+         lstring->name = name;
       }
-      lstring->next = NULL;
+      lstring->start = start;
+      lstring->end = end;
    }
    HTS_Label_check_time(label);
 }
@@ -209,51 +267,41 @@ size_t HTS_Label_get_size(HTS_Label * label)
 /* HTS_Label_get_string: get label string */
 const char *HTS_Label_get_string(HTS_Label * label, size_t index)
 {
-   size_t i;
-   HTS_LabelString *lstring = label->head;
-
-   for (i = 0; i < index && lstring; i++)
-      lstring = lstring->next;
-   if (!lstring)
+   if (index >= label->size)
       return NULL;
-   return lstring->name;
+   return label->string[index].name;
 }
 
 /* HTS_Label_get_start_frame: get start frame */
 double HTS_Label_get_start_frame(HTS_Label * label, size_t index)
 {
-   size_t i;
-   HTS_LabelString *lstring = label->head;
-
-   for (i = 0; i < index && lstring; i++)
-      lstring = lstring->next;
-   if (!lstring)
+   if (index >= label->size)
       return -1.0;
-   return lstring->start;
+   return label->string[index].start;
 }
 
 /* HTS_Label_get_end_frame: get end frame */
 double HTS_Label_get_end_frame(HTS_Label * label, size_t index)
 {
-   size_t i;
-   HTS_LabelString *lstring = label->head;
-
-   for (i = 0; i < index && lstring; i++)
-      lstring = lstring->next;
-   if (!lstring)
+   if (index >= label->size)
       return -1.0;
-   return lstring->end;
+   return label->string[index].end;
 }
 
 /* HTS_Label_clear: free label */
 void HTS_Label_clear(HTS_Label * label)
 {
-   HTS_LabelString *lstring, *next_lstring;
+   size_t i;
 
-   for (lstring = label->head; lstring; lstring = next_lstring) {
-      next_lstring = lstring->next;
-      HTS_free(lstring->name);
-      HTS_free(lstring);
+   if (label->string != NULL)
+      HTS_free(label->string);
+   if (label->data != NULL)
+      HTS_free(label->data);
+   if (label->lines != NULL) {
+      for (i = 0; i < label->num_lines; i++)
+         if (label->lines[i] != NULL)
+            HTS_free(label->lines[i]);
+      HTS_free(label->lines);
    }
    HTS_Label_initialize(label);
 }
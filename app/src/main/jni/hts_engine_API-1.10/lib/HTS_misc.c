@@ -55,10 +55,29 @@
 
 HTS_MISC_C_START;
 
+#if !defined(_WIN32)
+#define HTS_USE_MMAP
+#define HTS_USE_THREAD
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE         /* for madvise() */
+#endif                          /* !_DEFAULT_SOURCE */
+#endif                          /* !_WIN32 */
+
 #include <stdlib.h>             /* for exit(),calloc(),free() */
 #include <stdarg.h>             /* for va_list */
 #include <string.h>             /* for strcpy(),strlen() */
 
+#ifdef HTS_USE_MMAP
+#include <fcntl.h>              /* for open() */
+#include <unistd.h>             /* for close() */
+#include <sys/mman.h>           /* for mmap(),munmap(),madvise() */
+#include <sys/stat.h>           /* for fstat() */
+#endif                          /* HTS_USE_MMAP */
+
+#ifdef HTS_USE_THREAD
+#include <pthread.h>            /* for pthread_create(),pthread_join() */
+#endif                          /* HTS_USE_THREAD */
+
 /* hts_engine libraries */
 #include "HTS_hidden.h"
 
@@ -68,6 +87,10 @@ HTS_MISC_C_START;
 
 #define HTS_FILE  0
 #define HTS_DATA  1
+#define HTS_MMAP  2             /* data mapped from file, unmapped by HTS_fclose */
+#define HTS_VIEW  3             /* data owned by another HTS_MMAP or HTS_VIEW */
+
+#define HTS_IN_MEMORY(fp) ((fp)->type == HTS_DATA || (fp)->type == HTS_MMAP || (fp)->type == HTS_VIEW)
 
 typedef struct _HTS_Data {
    unsigned char *data;
@@ -92,6 +115,43 @@ HTS_File *HTS_fopen_from_fn(const char *name, const char *opt)
    return fp;
 }
 
+/* HTS_fmap_from_fn: map file to memory read-only, or open it when mapping is not available */
+HTS_File *HTS_fmap_from_fn(const char *name)
+{
+#ifdef HTS_USE_MMAP
+   int fd;
+   struct stat st;
+   void *data;
+   HTS_Data *d;
+   HTS_File *f;
+
+   fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return HTS_fopen_from_fn(name, "rb");
+   if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return HTS_fopen_from_fn(name, "rb");
+   }
+   data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED)
+      return HTS_fopen_from_fn(name, "rb");
+
+   d = (HTS_Data *) HTS_calloc(1, sizeof(HTS_Data));
+   d->data = (unsigned char *) data;
+   d->size = (size_t) st.st_size;
+   d->index = 0;
+
+   f = (HTS_File *) HTS_calloc(1, sizeof(HTS_File));
+   f->type = HTS_MMAP;
+   f->pointer = (void *) d;
+
+   return f;
+#else
+   return HTS_fopen_from_fn(name, "rb");
+#endif                          /* HTS_USE_MMAP */
+}
+
 /* HTS_fopen_from_fp: wrapper for fopen */
 HTS_File *HTS_fopen_from_fp(HTS_File * fp, size_t size)
 {
@@ -129,6 +189,21 @@ HTS_File *HTS_fopen_from_fp(HTS_File * fp, size_t size)
       f->type = HTS_DATA;
       f->pointer = (void *) tmp2;
       return f;
+   } else if (fp->type == HTS_MMAP || fp->type == HTS_VIEW) {
+      HTS_File *f;
+      HTS_Data *tmp1, *tmp2;
+      tmp1 = (HTS_Data *) fp->pointer;
+      if (tmp1->index + size > tmp1->size)
+         return NULL;
+      tmp2 = (HTS_Data *) HTS_calloc(1, sizeof(HTS_Data));
+      tmp2->data = &tmp1->data[tmp1->index];
+      tmp2->size = size;
+      tmp2->index = 0;
+      tmp1->index += size;
+      f = (HTS_File *) HTS_calloc(1, sizeof(HTS_File));
+      f->type = HTS_VIEW;
+      f->pointer = (void *) tmp2;
+      return f;
    }
 
    HTS_error(0, "HTS_fopen_from_fp: Unknown file type.\n");
@@ -177,6 +252,22 @@ void HTS_fclose(HTS_File * fp)
       }
       HTS_free(fp);
       return;
+   } else if (fp->type == HTS_MMAP) {
+      if (fp->pointer != NULL) {
+         HTS_Data *d = (HTS_Data *) fp->pointer;
+#ifdef HTS_USE_MMAP
+         if (d->data != NULL)
+            munmap(d->data, d->size);
+#endif                          /* HTS_USE_MMAP */
+         HTS_free(d);
+      }
+      HTS_free(fp);
+      return;
+   } else if (fp->type == HTS_VIEW) {
+      if (fp->pointer != NULL)
+         HTS_free(fp->pointer);
+      HTS_free(fp);
+      return;
    }
    HTS_error(0, "HTS_fclose: Unknown file type.\n");
 }
@@ -188,7 +279,7 @@ int HTS_fgetc(HTS_File * fp)
       return EOF;
    } else if (fp->type == HTS_FILE) {
       return fgetc((FILE *) fp->pointer);
-   } else if (fp->type == HTS_DATA) {
+   } else if (HTS_IN_MEMORY(fp)) {
       HTS_Data *d = (HTS_Data *) fp->pointer;
       if (d->size <= d->index)
          return EOF;
@@ -205,7 +296,7 @@ int HTS_feof(HTS_File * fp)
       return 1;
    } else if (fp->type == HTS_FILE) {
       return feof((FILE *) fp->pointer);
-   } else if (fp->type == HTS_DATA) {
+   } else if (HTS_IN_MEMORY(fp)) {
       HTS_Data *d = (HTS_Data *) fp->pointer;
       return d->size <= d->index ? 1 : 0;
    }
@@ -220,7 +311,7 @@ int HTS_fseek(HTS_File * fp, long offset, int origin)
       return 1;
    } else if (fp->type == HTS_FILE) {
       return fseek((FILE *) fp->pointer, offset, origin);
-   } else if (fp->type == HTS_DATA) {
+   } else if (HTS_IN_MEMORY(fp)) {
       HTS_Data *d = (HTS_Data *) fp->pointer;
       if (origin == SEEK_SET) {
          d->index = (size_t) offset;
@@ -250,7 +341,7 @@ size_t HTS_ftell(HTS_File * fp)
 #else
       return (size_t) pos.__pos;
 #endif                          /* _WIN32 || __CYGWIN__ || __APPLE__ || __ANDROID__ */
-   } else if (fp->type == HTS_DATA) {
+   } else if (HTS_IN_MEMORY(fp)) {
       HTS_Data *d = (HTS_Data *) fp->pointer;
       return d->index;
    }
@@ -266,16 +357,15 @@ static size_t HTS_fread(void *buf, size_t size, size_t n, HTS_File * fp)
    }
    if (fp->type == HTS_FILE) {
       return fread(buf, size, n, (FILE *) fp->pointer);
-   } else if (fp->type == HTS_DATA) {
+   } else if (HTS_IN_MEMORY(fp)) {
       HTS_Data *d = (HTS_Data *) fp->pointer;
-      size_t i, length = size * n;
-      unsigned char *c = (unsigned char *) buf;
-      for (i = 0; i < length; i++) {
-         if (d->index < d->size)
-            c[i] = d->data[d->index++];
-         else
-            break;
-      }
+      size_t i = size * n;
+      if (d->index >= d->size)
+         i = 0;
+      else if (i > d->size - d->index)
+         i = d->size - d->index;
+      memcpy(buf, &d->data[d->index], i);
+      d->index += i;
       if (i == 0)
          return 0;
       else
@@ -285,6 +375,31 @@ static size_t HTS_fread(void *buf, size_t size, size_t n, HTS_File * fp)
    return 0;
 }
 
+/* HTS_fdata: return pointer to data at current position of mapped file and skip it */
+const void *HTS_fdata(HTS_File * fp, size_t size)
+{
+   HTS_Data *d;
+
+   if (fp == NULL || (fp->type != HTS_MMAP && fp->type != HTS_VIEW))
+      return NULL;
+   d = (HTS_Data *) fp->pointer;
+   if (d->index + size > d->size)
+      return NULL;
+   d->index += size;
+   return &d->data[d->index - size];
+}
+
+/* HTS_fprefetch: advise that data of mapped file will be accessed soon */
+void HTS_fprefetch(HTS_File * fp)
+{
+#ifdef HTS_USE_MMAP
+   if (fp != NULL && fp->type == HTS_MMAP) {
+      HTS_Data *d = (HTS_Data *) fp->pointer;
+      madvise(d->data, d->size, MADV_WILLNEED);
+   }
+#endif                          /* HTS_USE_MMAP */
+}
+
 /* HTS_byte_swap: byte swap */
 static void HTS_byte_swap(void *p, size_t size, size_t block)
 {
@@ -608,6 +723,166 @@ void HTS_error(int error, const char *message, ...)
       exit(error);
 }
 
+#ifdef HTS_USE_THREAD
+struct _HTS_ThreadPool {
+   size_t num_threads;          /* # of threads running jobs including caller */
+   pthread_t *thread;           /* worker threads */
+   pthread_mutex_t mutex;       /* guards all fields below */
+   pthread_cond_t start;        /* signaled when jobs are posted or pool is deleted */
+   pthread_cond_t finish;       /* signaled when last job is done */
+   void (*func) (void *, size_t);
+   void *data;
+   size_t num_jobs;
+   size_t next_job;
+   size_t num_done;
+   size_t generation;           /* incremented on each HTS_ThreadPool_run */
+   HTS_Boolean quit;
+};
+
+/* HTS_ThreadPool_work: run posted jobs until none is left (called with mutex locked) */
+static void HTS_ThreadPool_work(HTS_ThreadPool * pool)
+{
+   size_t i;
+   void (*func) (void *, size_t);
+   void *data;
+
+   while (pool->next_job < pool->num_jobs) {
+      i = pool->next_job++;
+      func = pool->func;
+      data = pool->data;
+      pthread_mutex_unlock(&pool->mutex);
+      func(data, i);
+      pthread_mutex_lock(&pool->mutex);
+      if (++pool->num_done == pool->num_jobs)
+         pthread_cond_broadcast(&pool->finish);
+   }
+}
+
+/* HTS_ThreadPool_worker: main loop of worker thread */
+static void *HTS_ThreadPool_worker(void *arg)
+{
+   HTS_ThreadPool *pool = (HTS_ThreadPool *) arg;
+   size_t generation = 0;
+
+   pthread_mutex_lock(&pool->mutex);
+   for (;;) {
+      while (pool->quit == FALSE && pool->generation == generation)
+         pthread_cond_wait(&pool->start, &pool->mutex);
+      if (pool->quit == TRUE)
+         break;
+      generation = pool->generation;
+      HTS_ThreadPool_work(pool);
+   }
+   pthread_mutex_unlock(&pool->mutex);
+
+   return NULL;
+}
+#endif                          /* HTS_USE_THREAD */
+
+/* HTS_ThreadPool_create: start num_threads - 1 worker threads (NULL when num_threads <= 1 or threads are not available) */
+HTS_ThreadPool *HTS_ThreadPool_create(size_t num_threads)
+{
+#ifdef HTS_USE_THREAD
+   size_t i;
+   HTS_ThreadPool *pool;
+
+   if (num_threads <= 1)
+      return NULL;
+
+   pool = (HTS_ThreadPool *) HTS_calloc(1, sizeof(HTS_ThreadPool));
+   pool->thread = (pthread_t *) HTS_calloc(num_threads - 1, sizeof(pthread_t));
+   pthread_mutex_init(&pool->mutex, NULL);
+   pthread_cond_init(&pool->start, NULL);
+   pthread_cond_init(&pool->finish, NULL);
+   pool->func = NULL;
+   pool->data = NULL;
+   pool->num_jobs = 0;
+   pool->next_job = 0;
+   pool->num_done = 0;
+   pool->generation = 0;
+   pool->quit = FALSE;
+
+   /* caller counts as one thread */
+   pool->num_threads = 1;
+   for (i = 0; i < num_threads - 1; i++) {
+      if (pthread_create(&pool->thread[i], NULL, HTS_ThreadPool_worker, pool) != 0) {
+         HTS_error(0, "HTS_ThreadPool_create: Cannot create thread.\n");
+         break;
+      }
+      pool->num_threads++;
+   }
+   if (pool->num_threads == 1) {
+      HTS_ThreadPool_delete(pool);
+      return NULL;
+   }
+
+   return pool;
+#else
+   return NULL;
+#endif                          /* HTS_USE_THREAD */
+}
+
+/* HTS_ThreadPool_get_num_threads: get number of threads running jobs including caller */
+size_t HTS_ThreadPool_get_num_threads(HTS_ThreadPool * pool)
+{
+#ifdef HTS_USE_THREAD
+   if (pool != NULL)
+      return pool->num_threads;
+#endif                          /* HTS_USE_THREAD */
+   return 1;
+}
+
+/* HTS_ThreadPool_run: call func(data, i) for i = 0 ... num_jobs - 1 on pool and caller, and wait for all of them (serially when pool is NULL) */
+void HTS_ThreadPool_run(HTS_ThreadPool * pool, void (*func) (void *, size_t), void *data, size_t num_jobs)
+{
+   size_t i;
+
+#ifdef HTS_USE_THREAD
+   if (pool != NULL && num_jobs > 1) {
+      pthread_mutex_lock(&pool->mutex);
+      pool->func = func;
+      pool->data = data;
+      pool->num_jobs = num_jobs;
+      pool->next_job = 0;
+      pool->num_done = 0;
+      pool->generation++;
+      pthread_cond_broadcast(&pool->start);
+      HTS_ThreadPool_work(pool);
+      while (pool->num_done < pool->num_jobs)
+         pthread_cond_wait(&pool->finish, &pool->mutex);
+      pthread_mutex_unlock(&pool->mutex);
+      return;
+   }
+#endif                          /* HTS_USE_THREAD */
+
+   for (i = 0; i < num_jobs; i++)
+      func(data, i);
+}
+
+/* HTS_ThreadPool_delete: stop worker threads and free pool */
+void HTS_ThreadPool_delete(HTS_ThreadPool * pool)
+{
+#ifdef HTS_USE_THREAD
+   size_t i;
+
+   if (pool == NULL)
+      return;
+
+   pthread_mutex_lock(&pool->mutex);
+   pool->quit = TRUE;
+   pthread_cond_broadcast(&pool->start);
+   pthread_mutex_unlock(&pool->mutex);
+   for (i = 0; i < pool->num_threads - 1; i++)
+      pthread_join(pool->thread[i], NULL);
+
+   pthread_cond_destroy(&pool->finish);
+   pthread_cond_destroy(&pool->start);
+   pthread_mutex_destroy(&pool->mutex);
+   HTS_free(pool->thread);
+   HTS_free(pool);
+#endif                          /* HTS_USE_THREAD */
+}
+
 HTS_MISC_C_END;
 
 #endif                          /* !HTS_MISC_C */
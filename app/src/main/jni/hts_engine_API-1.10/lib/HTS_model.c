@@ -58,16 +58,23 @@ HTS_MODEL_C_START;
 #include <stdlib.h>             /* for atoi(),abs() */
 #include <string.h>             /* for strlen(),strstr(),strrchr(),strcmp() */
 #include <ctype.h>              /* for isdigit() */
+#include <stdarg.h>             /* for va_list */
+#include <math.h>               /* for sqrt(),frexp(),ldexp() */
 
 /* hts_engine libraries */
 #include "HTS_hidden.h"
 
 #ifdef WIN32
+typedef unsigned __int16 uint16_t;
 typedef unsigned __int32 uint32_t;
 #else
 #include <stdint.h>
 #endif                          /* WIN32 */
 
+/* binary sections written by HTS_ModelSet_save start with magic number and version */
+#define HTS_BINARY_MAGIC   "HTSB"
+#define HTS_BINARY_VERSION 1
+
 /* HTS_dp_match: recursive matching */
 static HTS_Boolean HTS_dp_match(const char *string, const char *pattern, size_t pos, size_t max)
 {
@@ -89,11 +96,23 @@ static HTS_Boolean HTS_dp_match(const char *string, const char *pattern, size_t
    return FALSE;
 }
 
+/* HTS_wildcard_equal: compare string with pattern of given length in which '?' matches any character */
+static HTS_Boolean HTS_wildcard_equal(const char *string, const char *pattern, size_t length)
+{
+   size_t i;
+
+   for (i = 0; i < length; i++)
+      if (string[i] != pattern[i] && pattern[i] != '?')
+         return FALSE;
+
+   return TRUE;
+}
+
 /* HTS_pattern_match: pattern matching function */
 static HTS_Boolean HTS_pattern_match(const char *string, const char *pattern)
 {
    size_t i, j;
-   size_t buff_length, max = 0, nstar = 0, nquestion = 0;
+   size_t buff_length, string_length, max = 0, nstar = 0, nquestion = 0;
    char buff[HTS_MAXBUFLEN];
    size_t pattern_length = strlen(pattern);
 
@@ -120,8 +139,24 @@ static HTS_Boolean HTS_pattern_match(const char *string, const char *pattern)
          return TRUE;
       else
          return FALSE;
+   }
+   string_length = strlen(string);
+   if (nstar == 2 && pattern[0] == '*' && pattern[i - 1] == '*') {
+      /* '?' in the middle */
+      for (j = 0; j + max <= string_length; j++)
+         if (HTS_wildcard_equal(&string[j], &pattern[1], max))
+            return TRUE;
+      return FALSE;
+   } else if (nstar == 1 && pattern[0] == '*') {
+      /* suffix matching */
+      return (max <= string_length && HTS_wildcard_equal(&string[string_length - max], &pattern[1], max)) ? TRUE : FALSE;
+   } else if (nstar == 1 && pattern[i - 1] == '*') {
+      /* prefix matching */
+      return (max <= string_length && HTS_wildcard_equal(string, pattern, max)) ? TRUE : FALSE;
+   } else if (nstar == 0) {
+      return (max == string_length && HTS_wildcard_equal(string, pattern, max)) ? TRUE : FALSE;
    } else
-      return HTS_dp_match(string, pattern, 0, strlen(string) - max);
+      return HTS_dp_match(string, pattern, 0, string_length - max);
 }
 
 /* HTS_is_num: check given buffer is number or not */
@@ -165,10 +200,110 @@ static size_t HTS_get_state_num(const char *string)
    return (size_t) atoi(left);
 }
 
+/* HTS_get_binary_version: skip head of binary section and return its version (0 if section is text) */
+static size_t HTS_get_binary_version(HTS_File * fp)
+{
+   char magic[4];
+   uint32_t version;
+   size_t n;
+
+   if (fp == NULL)
+      return 0;
+   n = HTS_fread_little_endian(magic, sizeof(char), sizeof(magic), fp);
+   if (n != sizeof(magic) || memcmp(magic, HTS_BINARY_MAGIC, sizeof(magic)) != 0) {
+      HTS_fseek(fp, -(long) n, SEEK_CUR);
+      return 0;
+   }
+   if (HTS_fread_little_endian(&version, sizeof(version), 1, fp) != 1 || version == 0)
+      return (size_t) -1;
+   return (size_t) version;
+}
+
+/* HTS_get_binary_string: read string of binary section */
+static char *HTS_get_binary_string(HTS_File * fp)
+{
+   uint32_t length;
+   char *string;
+
+   if (HTS_fread_little_endian(&length, sizeof(length), 1, fp) != 1 || length >= HTS_MAXBUFLEN)
+      return NULL;
+   string = (char *) HTS_calloc(length + 1, sizeof(char));
+   if (HTS_fread_little_endian(string, sizeof(char), length, fp) != length) {
+      HTS_free(string);
+      return NULL;
+   }
+   string[length] = '\0';
+   return string;
+}
+
+/* HTS_half_to_float: convert 16-bit float to float */
+static float HTS_half_to_float(uint16_t h)
+{
+   uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+   uint32_t exponent = (h >> 10) & 0x1f;
+   uint32_t mantissa = h & 0x3ff;
+   uint32_t bits;
+   float x;
+
+   if (exponent == 0) {         /* zero or subnormal */
+      x = (float) mantissa * (1.0f / 16777216.0f);
+      return sign ? -x : x;
+   }
+   bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+   memcpy(&x, &bits, sizeof(x));
+   return x;
+}
+
+/* HTS_float_to_half: convert float to 16-bit float (rounding to nearest, saturating at max) */
+static uint16_t HTS_float_to_half(float x)
+{
+   uint32_t bits, sign, mantissa;
+   int exponent;
+
+   memcpy(&bits, &x, sizeof(bits));
+   sign = (bits >> 16) & 0x8000;
+   exponent = (int) ((bits >> 23) & 0xff) - 112;
+   mantissa = bits & 0x7fffff;
+   if (exponent <= 0) {         /* zero or subnormal */
+      if (exponent < -10)
+         return (uint16_t) sign;
+      mantissa |= 0x800000;
+      return (uint16_t) (sign | ((mantissa + (1u << (13 - exponent))) >> (14 - exponent)));
+   }
+   bits = (((uint32_t) exponent << 23) | mantissa) + 0x1000;
+   if (exponent >= 31 || (bits >> 13) >= 0x7c00)
+      return (uint16_t) (sign | 0x7bff);
+   return (uint16_t) (sign | (bits >> 13));
+}
+
+/* HTS_Pattern_load_binary: load list of patterns from binary section */
+static HTS_Boolean HTS_Pattern_load_binary(HTS_Pattern ** head, HTS_File * fp)
+{
+   uint32_t i, num_patterns;
+   HTS_Pattern *pattern, *last_pattern = NULL;
+
+   if (HTS_fread_little_endian(&num_patterns, sizeof(num_patterns), 1, fp) != 1)
+      return FALSE;
+   for (i = 0; i < num_patterns; i++) {
+      pattern = (HTS_Pattern *) HTS_calloc(1, sizeof(HTS_Pattern));
+      if (last_pattern != NULL)
+         last_pattern->next = pattern;
+      else
+         *head = pattern;
+      pattern->next = NULL;
+      last_pattern = pattern;
+      pattern->string = HTS_get_binary_string(fp);
+      if (pattern->string == NULL)
+         return FALSE;
+   }
+   return TRUE;
+}
+
 /* HTS_Question_initialize: initialize question */
 static void HTS_Question_initialize(HTS_Question * question)
 {
    question->string = NULL;
+   question->id = 0;
    question->head = NULL;
    question->next = NULL;
 }
@@ -236,61 +371,125 @@ static HTS_Boolean HTS_Question_load(HTS_Question * question, HTS_File * fp)
    return TRUE;
 }
 
-/* HTS_Question_match: check given string match given question */
-static HTS_Boolean HTS_Question_match(HTS_Question * question, const char *string)
+/* HTS_Question_match: check given context match given question */
+static HTS_Boolean HTS_Question_match(HTS_Question * question, const HTS_Context * context)
 {
    HTS_Pattern *pattern;
+   HTS_Boolean result = FALSE;
+   size_t i;
 
-   for (pattern = question->head; pattern; pattern = pattern->next)
-      if (HTS_pattern_match(string, pattern->string))
-         return TRUE;
+   /* the same question may be asked by trees of other states, streams and voices */
+   if (question->id < context->num_questions && context->answer[question->id] != 0)
+      return context->answer[question->id] == 2 ? TRUE : FALSE;
 
-   return FALSE;
+   for (pattern = question->head; pattern && result == FALSE; pattern = pattern->next) {
+      if (pattern->field == 0) {
+         result = HTS_pattern_match(context->string, pattern->string);
+      } else {
+         for (i = context->start[pattern->field]; i < context->start[pattern->field + 1]; i++)
+            if (context->value[i] == pattern->value)
+               result = TRUE;
+      }
+   }
+
+   if (question->id < context->num_questions)
+      context->answer[question->id] = result == TRUE ? 2 : 1;
+   return result;
 }
 
-/* HTS_Question_find: find question from question list */
-static HTS_Question *HTS_Question_find(HTS_Question * question, const char *string)
+/* HTS_compare_question_name: compare questions by name for qsort */
+static int HTS_compare_question_name(const void *a, const void *b)
 {
-   for (; question; question = question->next)
-      if (strcmp(string, question->string) == 0)
-         return question;
+   return strcmp((*(HTS_Question * const *) a)->string, (*(HTS_Question * const *) b)->string);
+}
 
-   return NULL;
+/* HTS_Question_find_index: find index of question in question array sorted by name (num_questions if not found) */
+static size_t HTS_Question_find_index(HTS_Question ** question, size_t num_questions, const char *string)
+{
+   size_t lower = 0, upper = num_questions, middle;
+   int result;
+
+   while (lower < upper) {
+      middle = (lower + upper) / 2;
+      result = strcmp(question[middle]->string, string);
+      if (result == 0)
+         return middle;
+      if (result < 0)
+         lower = middle + 1;
+      else
+         upper = middle;
+   }
+   return num_questions;
 }
 
-/* HTS_Node_initialzie: initialize node */
-static void HTS_Node_initialize(HTS_Node * node)
+/* HTS_Question_find: find question from question array sorted by name */
+static HTS_Question *HTS_Question_find(HTS_Question ** question, size_t num_questions, const char *string)
 {
-   node->index = 0;
-   node->pdf = 0;
-   node->yes = NULL;
-   node->no = NULL;
-   node->next = NULL;
-   node->quest = NULL;
+   size_t index = HTS_Question_find_index(question, num_questions, string);
+
+   return index < num_questions ? question[index] : NULL;
 }
 
-/* HTS_Node_clear: recursive function to free node */
-static void HTS_Node_clear(HTS_Node * node)
+/* HTS_is_token_char: check given character belongs to token of full-context label */
+static HTS_Boolean HTS_is_token_char(char c)
 {
-   if (node->yes != NULL) {
-      HTS_Node_clear(node->yes);
-      HTS_free(node->yes);
-   }
-   if (node->no != NULL) {
-      HTS_Node_clear(node->no);
-      HTS_free(node->no);
-   }
-   HTS_Node_initialize(node);
+   if (('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'))
+      return TRUE;
+   return FALSE;
 }
 
-/* HTS_Node_find: find node for given number */
-static HTS_Node *HTS_Node_find(HTS_Node * node, int num)
+/* HTS_split_pattern: split pattern of the form "*left value right*" into delimiters and token value */
+static HTS_Boolean HTS_split_pattern(const char *pattern, char *left, char *value, char *right)
 {
-   for (; node; node = node->next)
-      if (node->index == num)
-         return node;
+   size_t i, j, s, e, vs, ve;
+   size_t length = strlen(pattern);
+   HTS_Boolean head, tail;
+
+   /* '*' is allowed only at head and tail */
+   head = (length > 0 && pattern[0] == '*') ? FALSE : TRUE;
+   tail = (length > 1 && pattern[length - 1] == '*') ? FALSE : TRUE;
+   s = head ? 0 : 1;
+   e = tail ? length : length - 1;
+   if (s >= e || length + 2 > HTS_MAXBUFLEN)
+      return FALSE;
+   for (i = s; i < e; i++)
+      if (pattern[i] == '*' || pattern[i] == '?')
+         return FALSE;
 
-   return NULL;
+   /* value is the first alphanumeric part not followed by ':' (which names a field as "/A:") */
+   vs = ve = e;
+   for (i = s; i < e; i = j) {
+      for (; i < e && HTS_is_token_char(pattern[i]) == FALSE; i++);
+      for (j = i; j < e && HTS_is_token_char(pattern[j]) == TRUE; j++);
+      if (i == j)
+         break;
+      if (vs == e || j == e || pattern[j] != ':') {
+         vs = i;
+         ve = j;
+      }
+      if (j == e || pattern[j] != ':')
+         break;
+   }
+   if (vs == e)
+      return FALSE;
+
+   /* value must be a whole token, i.e. delimited on both sides */
+   if ((head == FALSE && vs == s) || (tail == FALSE && ve == e))
+      return FALSE;
+   i = 0;
+   if (head == TRUE)
+      left[i++] = '\001';
+   memcpy(&left[i], &pattern[s], vs - s);
+   left[i + vs - s] = '\0';
+   memcpy(value, &pattern[vs], ve - vs);
+   value[ve - vs] = '\0';
+   memcpy(right, &pattern[ve], e - ve);
+   i = e - ve;
+   if (tail == TRUE)
+      right[i++] = '\002';
+   right[i] = '\0';
+
+   return TRUE;
 }
 
 /* HTS_Tree_initialize: initialize tree */
@@ -298,7 +497,9 @@ static void HTS_Tree_initialize(HTS_Tree * tree)
 {
    tree->head = NULL;
    tree->next = NULL;
-   tree->root = NULL;
+   tree->node = NULL;
+   tree->num_nodes = 0;
+   tree->pdf = 0;
    tree->state = 0;
 }
 
@@ -312,10 +513,8 @@ static void HTS_Tree_clear(HTS_Tree * tree)
       HTS_free(pattern->string);
       HTS_free(pattern);
    }
-   if (tree->root != NULL) {
-      HTS_Node_clear(tree->root);
-      HTS_free(tree->root);
-   }
+   if (tree->node != NULL)
+      HTS_free(tree->node);
    HTS_Tree_initialize(tree);
 }
 
@@ -355,11 +554,51 @@ static void HTS_Tree_parse_pattern(HTS_Tree * tree, char *string)
    }
 }
 
-/* HTS_Tree_load: load trees */
-static HTS_Boolean HTS_Tree_load(HTS_Tree * tree, HTS_File * fp, HTS_Question * question)
+/* HTS_Tree_check: check that root and all child nodes of tree are given */
+static HTS_Boolean HTS_Tree_check(HTS_Tree * tree)
+{
+   size_t i;
+   HTS_Node *node;
+
+   for (i = 0; i < tree->num_nodes; i++) {
+      node = &tree->node[i];
+      if (node->quest == NULL)
+         continue;
+      if ((node->no <= 0 && ((size_t) -node->no >= tree->num_nodes || tree->node[-node->no].quest == NULL))
+          || (node->yes <= 0 && ((size_t) -node->yes >= tree->num_nodes || tree->node[-node->yes].quest == NULL))) {
+         HTS_error(0, "HTS_Tree_check: Cannot find child node of node %d.\n", -(int) i);
+         return FALSE;
+      }
+   }
+   if (tree->num_nodes == 0 || tree->node[0].quest == NULL) {
+      HTS_error(0, "HTS_Tree_check: Cannot find node 0.\n");
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/* HTS_Tree_parse_child: parse child of node, i.e. number of node or name of PDF */
+static HTS_Boolean HTS_Tree_parse_child(const char *buff, int *child)
+{
+   if (HTS_is_num(buff)) {
+      *child = atoi(buff);
+      if (*child > 0) {
+         HTS_error(0, "HTS_Tree_load: Cannot find node %d.\n", *child);
+         return FALSE;
+      }
+   } else {
+      *child = (int) HTS_name2num(buff);
+   }
+   return TRUE;
+}
+
+/* HTS_Tree_load: load trees (node numbered -i is stored at i-th element of node array) */
+static HTS_Boolean HTS_Tree_load(HTS_Tree * tree, HTS_File * fp, HTS_Question ** question, size_t num_questions)
 {
    char buff[HTS_MAXBUFLEN];
-   HTS_Node *node, *last_node;
+   size_t index, size = 0;
+   int num;
+   HTS_Node *node;
 
    if (tree == NULL || fp == NULL)
       return FALSE;
@@ -368,85 +607,82 @@ static HTS_Boolean HTS_Tree_load(HTS_Tree * tree, HTS_File * fp, HTS_Question *
       HTS_Tree_clear(tree);
       return FALSE;
    }
-   node = (HTS_Node *) HTS_calloc(1, sizeof(HTS_Node));
-   HTS_Node_initialize(node);
-   tree->root = last_node = node;
 
-   if (strcmp(buff, "{") == 0) {
-      while (HTS_get_pattern_token(fp, buff) == TRUE && strcmp(buff, "}") != 0) {
-         node = HTS_Node_find(last_node, atoi(buff));
-         if (node == NULL) {
-            HTS_error(0, "HTS_Tree_load: Cannot find node %d.\n", atoi(buff));
-            HTS_Tree_clear(tree);
-            return FALSE;
-         }
-         if (HTS_get_pattern_token(fp, buff) == FALSE) {
-            HTS_Tree_clear(tree);
-            return FALSE;
-         }
-         node->quest = HTS_Question_find(question, buff);
-         if (node->quest == NULL) {
-            HTS_error(0, "HTS_Tree_load: Cannot find question %s.\n", buff);
-            HTS_Tree_clear(tree);
-            return FALSE;
-         }
-         node->yes = (HTS_Node *) HTS_calloc(1, sizeof(HTS_Node));
-         node->no = (HTS_Node *) HTS_calloc(1, sizeof(HTS_Node));
-         HTS_Node_initialize(node->yes);
-         HTS_Node_initialize(node->no);
+   if (strcmp(buff, "{") != 0) {
+      tree->pdf = HTS_name2num(buff);
+      return TRUE;
+   }
 
-         if (HTS_get_pattern_token(fp, buff) == FALSE) {
-            node->quest = NULL;
-            free(node->yes);
-            free(node->no);
-            HTS_Tree_clear(tree);
-            return FALSE;
+   while (HTS_get_pattern_token(fp, buff) == TRUE && strcmp(buff, "}") != 0) {
+      num = atoi(buff);
+      if (num > 0) {
+         HTS_error(0, "HTS_Tree_load: Cannot find node %d.\n", num);
+         HTS_Tree_clear(tree);
+         return FALSE;
+      }
+      index = (size_t) -num;
+      /* extend node array */
+      if (index >= size) {
+         size = (size == 0) ? 64 : size;
+         while (index >= size)
+            size *= 2;
+         node = (HTS_Node *) HTS_calloc(size, sizeof(HTS_Node));
+         if (tree->node != NULL) {
+            memcpy(node, tree->node, tree->num_nodes * sizeof(HTS_Node));
+            HTS_free(tree->node);
          }
-         if (HTS_is_num(buff))
-            node->no->index = atoi(buff);
-         else
-            node->no->pdf = HTS_name2num(buff);
-         node->no->next = last_node;
-         last_node = node->no;
+         tree->node = node;
+      }
+      if (index >= tree->num_nodes)
+         tree->num_nodes = index + 1;
+      node = &tree->node[index];
 
-         if (HTS_get_pattern_token(fp, buff) == FALSE) {
-            node->quest = NULL;
-            free(node->yes);
-            free(node->no);
-            HTS_Tree_clear(tree);
-            return FALSE;
-         }
-         if (HTS_is_num(buff))
-            node->yes->index = atoi(buff);
-         else
-            node->yes->pdf = HTS_name2num(buff);
-         node->yes->next = last_node;
-         last_node = node->yes;
+      if (HTS_get_pattern_token(fp, buff) == FALSE) {
+         HTS_Tree_clear(tree);
+         return FALSE;
       }
-   } else {
-      node->pdf = HTS_name2num(buff);
+      node->quest = HTS_Question_find(question, num_questions, buff);
+      if (node->quest == NULL) {
+         HTS_error(0, "HTS_Tree_load: Cannot find question %s.\n", buff);
+         HTS_Tree_clear(tree);
+         return FALSE;
+      }
+      if (HTS_get_pattern_token(fp, buff) == FALSE || HTS_Tree_parse_child(buff, &node->no) == FALSE) {
+         HTS_Tree_clear(tree);
+         return FALSE;
+      }
+      if (HTS_get_pattern_token(fp, buff) == FALSE || HTS_Tree_parse_child(buff, &node->yes) == FALSE) {
+         HTS_Tree_clear(tree);
+         return FALSE;
+      }
+   }
+
+   if (HTS_Tree_check(tree) == FALSE) {
+      HTS_Tree_clear(tree);
+      return FALSE;
    }
 
    return TRUE;
 }
 
-/* HTS_Node_search: tree search */
-static size_t HTS_Tree_search_node(HTS_Tree * tree, const char *string)
+/* HTS_Node_search: tree search (nquestion counts evaluated questions if not NULL) */
+static size_t HTS_Tree_search_node(HTS_Tree * tree, const HTS_Context * context, size_t * nquestion)
 {
-   HTS_Node *node = tree->root;
-
-   while (node != NULL) {
-      if (node->quest == NULL)
-         return node->pdf;
-      if (HTS_Question_match(node->quest, string)) {
-         if (node->yes->pdf > 0)
-            return node->yes->pdf;
-         node = node->yes;
-      } else {
-         if (node->no->pdf > 0)
-            return node->no->pdf;
-         node = node->no;
-      }
+   size_t i;
+   int child;
+   const HTS_Node *node;
+
+   if (tree->num_nodes == 0)
+      return tree->pdf;
+
+   node = tree->node;
+   for (i = 0; i < tree->num_nodes; i++) {
+      if (nquestion != NULL)
+         (*nquestion)++;
+      child = HTS_Question_match(node->quest, context) ? node->yes : node->no;
+      if (child > 0)
+         return (size_t) child;
+      node = &tree->node[-child];
    }
 
    HTS_error(0, "HTS_Tree_search_node: Cannot find node.\n");
@@ -487,7 +723,8 @@ static void HTS_Window_clear(HTS_Window * win)
 static HTS_Boolean HTS_Window_load(HTS_Window * win, HTS_File ** fp, size_t size)
 {
    size_t i, j;
-   size_t fsize, length;
+   size_t fsize, length, version;
+   uint32_t n;
    char buff[HTS_MAXBUFLEN];
    HTS_Boolean result = TRUE;
 
@@ -501,7 +738,17 @@ static HTS_Boolean HTS_Window_load(HTS_Window * win, HTS_File ** fp, size_t size
    win->coefficient = (double **) HTS_calloc(win->size, sizeof(double *));
    /* set delta coefficents */
    for (i = 0; i < win->size; i++) {
-      if (HTS_get_token_from_fp(fp[i], buff) == FALSE) {
+      version = HTS_get_binary_version(fp[i]);
+      if (version != 0) {
+         if (version != HTS_BINARY_VERSION)
+            HTS_error(0, "HTS_Window_load: Unsupported version of binary window.\n");
+         if (version != HTS_BINARY_VERSION || HTS_fread_little_endian(&n, sizeof(n), 1, fp[i]) != 1 || n == 0) {
+            result = FALSE;
+            fsize = 1;
+         } else {
+            fsize = (size_t) n;
+         }
+      } else if (HTS_get_token_from_fp(fp[i], buff) == FALSE) {
          result = FALSE;
          fsize = 1;
       } else {
@@ -513,12 +760,17 @@ static HTS_Boolean HTS_Window_load(HTS_Window * win, HTS_File ** fp, size_t size
       }
       /* read coefficients */
       win->coefficient[i] = (double *) HTS_calloc(fsize, sizeof(double));
-      for (j = 0; j < fsize; j++) {
-         if (HTS_get_token_from_fp(fp[i], buff) == FALSE) {
+      if (version != 0) {
+         if (HTS_fread_little_endian(win->coefficient[i], sizeof(double), fsize, fp[i]) != fsize)
             result = FALSE;
-            win->coefficient[i][j] = 0.0;
-         } else {
-            win->coefficient[i][j] = (double) atof(buff);
+      } else {
+         for (j = 0; j < fsize; j++) {
+            if (HTS_get_token_from_fp(fp[i], buff) == FALSE) {
+               result = FALSE;
+               win->coefficient[i][j] = 0.0;
+            } else {
+               win->coefficient[i][j] = (double) atof(buff);
+            }
          }
       }
       /* set pointer */
@@ -553,7 +805,11 @@ static void HTS_Model_initialize(HTS_Model * model)
    model->is_msd = FALSE;
    model->ntree = 0;
    model->npdf = NULL;
+   model->pdf_type = HTS_PDF_FLOAT;
    model->pdf = NULL;
+   model->pdf_block = NULL;
+   model->pdf_scale = NULL;
+   model->pdf_offset = NULL;
    model->tree = NULL;
    model->question = NULL;
 }
@@ -561,7 +817,6 @@ static void HTS_Model_initialize(HTS_Model * model)
 /* HTS_Model_clear: free pdfs and trees */
 static void HTS_Model_clear(HTS_Model * model)
 {
-   size_t i, j;
    HTS_Question *question, *next_question;
    HTS_Tree *tree, *next_tree;
 
@@ -576,16 +831,15 @@ static void HTS_Model_clear(HTS_Model * model)
       HTS_free(tree);
    }
    if (model->pdf) {
-      for (i = 2; i <= model->ntree + 1; i++) {
-         for (j = 1; j <= model->npdf[i]; j++) {
-            HTS_free(model->pdf[i][j]);
-         }
-         model->pdf[i]++;
-         HTS_free(model->pdf[i]);
-      }
       model->pdf += 2;
       HTS_free(model->pdf);
    }
+   if (model->pdf_block)
+      HTS_free(model->pdf_block);
+   if (model->pdf_scale)
+      HTS_free(model->pdf_scale);
+   if (model->pdf_offset)
+      HTS_free(model->pdf_offset);
    if (model->npdf) {
       model->npdf += 2;
       HTS_free(model->npdf);
@@ -593,13 +847,88 @@ static void HTS_Model_clear(HTS_Model * model)
    HTS_Model_initialize(model);
 }
 
+/* HTS_Model_load_binary_tree: load questions and trees from binary section */
+static HTS_Boolean HTS_Model_load_binary_tree(HTS_Model * model, HTS_File * fp)
+{
+   uint32_t i, j, num_questions, num_trees, value[3];
+   HTS_Question **question = NULL;
+   HTS_Tree *tree, *last_tree = NULL;
+   HTS_Boolean result = TRUE;
+
+   /* questions */
+   if (HTS_fread_little_endian(&num_questions, sizeof(num_questions), 1, fp) != 1)
+      return FALSE;
+   if (num_questions > 0)
+      question = (HTS_Question **) HTS_calloc(num_questions, sizeof(HTS_Question *));
+   for (i = 0; i < num_questions && result == TRUE; i++) {
+      question[i] = (HTS_Question *) HTS_calloc(1, sizeof(HTS_Question));
+      HTS_Question_initialize(question[i]);
+      if (i > 0)
+         question[i - 1]->next = question[i];
+      else
+         model->question = question[i];
+      question[i]->string = HTS_get_binary_string(fp);
+      if (question[i]->string == NULL || HTS_Pattern_load_binary(&question[i]->head, fp) == FALSE)
+         result = FALSE;
+   }
+
+   /* trees: state, patterns, PDF of tree without node and nodes (question or num_questions if unused, no, yes) */
+   if (result == TRUE && HTS_fread_little_endian(&num_trees, sizeof(num_trees), 1, fp) != 1)
+      result = FALSE;
+   for (i = 0; i < num_trees && result == TRUE; i++) {
+      tree = (HTS_Tree *) HTS_calloc(1, sizeof(HTS_Tree));
+      HTS_Tree_initialize(tree);
+      if (last_tree != NULL)
+         last_tree->next = tree;
+      else
+         model->tree = tree;
+      last_tree = tree;
+      model->ntree++;
+      if (HTS_fread_little_endian(value, sizeof(uint32_t), 1, fp) != 1 || HTS_Pattern_load_binary(&tree->head, fp) == FALSE || HTS_fread_little_endian(&value[1], sizeof(uint32_t), 2, fp) != 2) {
+         result = FALSE;
+         break;
+      }
+      tree->state = (size_t) value[0];
+      tree->pdf = (size_t) value[1];
+      tree->num_nodes = (size_t) value[2];
+      if (tree->num_nodes == 0)
+         continue;
+      tree->node = (HTS_Node *) HTS_calloc(tree->num_nodes, sizeof(HTS_Node));
+      for (j = 0; j < tree->num_nodes; j++) {
+         if (HTS_fread_little_endian(value, sizeof(uint32_t), 3, fp) != 3 || value[0] > num_questions) {
+            result = FALSE;
+            break;
+         }
+         tree->node[j].quest = (value[0] < num_questions) ? question[value[0]] : NULL;
+         tree->node[j].no = (int) (int32_t) value[1];
+         tree->node[j].yes = (int) (int32_t) value[2];
+      }
+      if (result == TRUE && HTS_Tree_check(tree) == FALSE)
+         result = FALSE;
+   }
+
+   if (question != NULL)
+      HTS_free(question);
+   if (result == FALSE) {
+      HTS_error(0, "HTS_Model_load_binary_tree: Failed to load binary trees.\n");
+      HTS_Model_clear(model);
+      return FALSE;
+   }
+   /* No Tree information in tree file */
+   if (model->tree == NULL)
+      model->ntree = 1;
+
+   return TRUE;
+}
+
 /* HTS_Model_load_tree: load trees */
 static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
 {
    char buff[HTS_MAXBUFLEN];
    HTS_Question *question, *last_question;
    HTS_Tree *tree, *last_tree;
-   size_t state;
+   HTS_Question **index = NULL;
+   size_t i, state, version, num_questions = 0, num_indexed = 0;
 
    /* check */
    if (model == NULL) {
@@ -613,6 +942,13 @@ static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
    }
 
    model->ntree = 0;
+   version = HTS_get_binary_version(fp);
+   if (version != 0) {
+      if (version == HTS_BINARY_VERSION)
+         return HTS_Model_load_binary_tree(model, fp);
+      HTS_error(0, "HTS_Model_load_tree: Unsupported version of binary trees.\n");
+      return FALSE;
+   }
    last_question = NULL;
    last_tree = NULL;
    while (!HTS_feof(fp)) {
@@ -623,6 +959,8 @@ static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
          HTS_Question_initialize(question);
          if (HTS_Question_load(question, fp) == FALSE) {
             free(question);
+            if (index != NULL)
+               HTS_free(index);
             HTS_Model_clear(model);
             return FALSE;
          }
@@ -632,16 +970,29 @@ static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
             model->question = question;
          question->next = NULL;
          last_question = question;
+         num_questions++;
       }
       /* parse trees */
       state = HTS_get_state_num(buff);
       if (state != 0) {
+         /* sort questions by name to find them by binary search */
+         if (num_indexed != num_questions) {
+            if (index != NULL)
+               HTS_free(index);
+            index = (HTS_Question **) HTS_calloc(num_questions, sizeof(HTS_Question *));
+            for (i = 0, question = model->question; question; question = question->next)
+               index[i++] = question;
+            qsort(index, num_questions, sizeof(HTS_Question *), HTS_compare_question_name);
+            num_indexed = num_questions;
+         }
          tree = (HTS_Tree *) HTS_calloc(1, sizeof(HTS_Tree));
          HTS_Tree_initialize(tree);
          tree->state = state;
          HTS_Tree_parse_pattern(tree, buff);
-         if (HTS_Tree_load(tree, fp, model->question) == FALSE) {
+         if (HTS_Tree_load(tree, fp, index, num_indexed) == FALSE) {
             free(tree);
+            if (index != NULL)
+               HTS_free(index);
             HTS_Model_clear(model);
             return FALSE;
          }
@@ -654,6 +1005,9 @@ static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
          model->ntree++;
       }
    }
+   if (index != NULL)
+      HTS_free(index);
+
    /* No Tree information in tree file */
    if (model->tree == NULL)
       model->ntree = 1;
@@ -661,13 +1015,27 @@ static HTS_Boolean HTS_Model_load_tree(HTS_Model * model, HTS_File * fp)
    return TRUE;
 }
 
+/* HTS_Model_get_pdf_size: get size of a value of PDFs */
+static size_t HTS_Model_get_pdf_size(size_t pdf_type)
+{
+   if (pdf_type == HTS_PDF_HALF)
+      return sizeof(uint16_t);
+   if (pdf_type == HTS_PDF_BYTE)
+      return sizeof(unsigned char);
+   return sizeof(float);
+}
+
 /* HTS_Model_load_pdf: load pdfs */
 static HTS_Boolean HTS_Model_load_pdf(HTS_Model * model, HTS_File * fp, size_t vector_length, size_t num_windows, HTS_Boolean is_msd)
 {
    uint32_t i;
-   size_t j, k;
+   size_t j;
    HTS_Boolean result = TRUE;
    size_t len;
+   size_t total = 0;
+   size_t version;
+   size_t value_size;
+   const char *data = NULL;
 
    /* check */
    if (model == NULL || fp == NULL || model->ntree <= 0) {
@@ -679,6 +1047,15 @@ static HTS_Boolean HTS_Model_load_pdf(HTS_Model * model, HTS_File * fp, size_t v
    model->vector_length = vector_length;
    model->num_windows = num_windows;
    model->is_msd = is_msd;
+   /* quantized PDFs are stored in binary section with their type */
+   version = HTS_get_binary_version(fp);
+   if (version != 0) {
+      if (version != HTS_BINARY_VERSION || HTS_fread_little_endian(&i, sizeof(i), 1, fp) != 1 || (i != HTS_PDF_HALF && i != HTS_PDF_BYTE)) {
+         HTS_error(1, "HTS_Model_load_pdf: Unsupported PDFs.\n");
+         return FALSE;
+      }
+      model->pdf_type = (size_t) i;
+   }
    model->npdf = (size_t *) HTS_calloc(model->ntree, sizeof(size_t));
    model->npdf -= 2;
    /* read the number of pdfs */
@@ -702,22 +1079,44 @@ static HTS_Boolean HTS_Model_load_pdf(HTS_Model * model, HTS_File * fp, size_t v
       HTS_Model_initialize(model);
       return FALSE;
    }
-   model->pdf = (float ***) HTS_calloc(model->ntree, sizeof(float **));
+   model->pdf = (void **) HTS_calloc(model->ntree, sizeof(void *));
    model->pdf -= 2;
    /* read means and variances */
    if (is_msd)                  /* for MSD */
       len = model->vector_length * model->num_windows * 2 + 1;
    else
       len = model->vector_length * model->num_windows * 2;
-   for (j = 2; j <= model->ntree + 1; j++) {
-      model->pdf[j] = (float **) HTS_calloc(model->npdf[j], sizeof(float *));
-      model->pdf[j]--;
-      for (k = 1; k <= model->npdf[j]; k++) {
-         model->pdf[j][k] = (float *) HTS_calloc(len, sizeof(float));
-         if (HTS_fread_little_endian(model->pdf[j][k], sizeof(float), len, fp) != len)
-            result = FALSE;
+   for (j = 2; j <= model->ntree + 1; j++)
+      total += model->npdf[j] * len;
+   /* read scale and offset of each dimension of quantized PDFs */
+   if (model->pdf_type != HTS_PDF_FLOAT) {
+      model->pdf_scale = (float *) HTS_calloc(len, sizeof(float));
+      model->pdf_offset = (float *) HTS_calloc(len, sizeof(float));
+      if (HTS_fread_little_endian(model->pdf_scale, sizeof(float), len, fp) != len || HTS_fread_little_endian(model->pdf_offset, sizeof(float), len, fp) != len) {
+         HTS_Model_clear(model);
+         return FALSE;
       }
    }
+   value_size = HTS_Model_get_pdf_size(model->pdf_type);
+#ifndef WORDS_BIGENDIAN
+   /* refer to memory-mapped voice directly if PDFs are aligned */
+   data = (const char *) HTS_fdata(fp, total * value_size);
+   if (data != NULL && (uintptr_t) data % value_size != 0) {
+      HTS_fseek(fp, -(long) (total * value_size), SEEK_CUR);
+      data = NULL;
+   }
+#endif                          /* !WORDS_BIGENDIAN */
+   /* otherwise read all PDFs into one block */
+   if (data == NULL) {
+      model->pdf_block = HTS_calloc(total, value_size);
+      if (HTS_fread_little_endian(model->pdf_block, value_size, total, fp) != total)
+         result = FALSE;
+      data = (const char *) model->pdf_block;
+   }
+   for (j = 2; j <= model->ntree + 1; j++) {
+      model->pdf[j] = (void *) data;
+      data += model->npdf[j] * len * value_size;
+   }
    if (result == FALSE) {
       HTS_Model_clear(model);
       return FALSE;
@@ -725,6 +1124,27 @@ static HTS_Boolean HTS_Model_load_pdf(HTS_Model * model, HTS_File * fp, size_t v
    return TRUE;
 }
 
+/* HTS_Model_get_pdf_value: get value of PDF at dimension of mean, variance and MSD weight */
+static double HTS_Model_get_pdf_value(HTS_Model * model, size_t tree_index, size_t pdf_index, size_t dimension)
+{
+   size_t len = model->vector_length * model->num_windows;
+   /* PDFs of a tree are stored as mean, variance (and MSD weight) of each leaf in turn */
+   size_t k = (pdf_index - 1) * (len + len + (model->is_msd == TRUE ? 1 : 0)) + dimension;
+   double x;
+
+   switch (model->pdf_type) {
+   case HTS_PDF_HALF:
+      return model->pdf_scale[dimension] * HTS_half_to_float(((const uint16_t *) model->pdf[tree_index])[k]);
+   case HTS_PDF_BYTE:
+      x = model->pdf_offset[dimension] + model->pdf_scale[dimension] * ((const unsigned char *) model->pdf[tree_index])[k];
+      if (dimension >= len && dimension < len + len)
+         x *= x;                /* standard deviation */
+      return x;
+   default:
+      return ((const float *) model->pdf[tree_index])[k];
+   }
+}
+
 /* HTS_Model_load: load pdf and tree */
 static HTS_Boolean HTS_Model_load(HTS_Model * model, HTS_File * pdf, HTS_File * tree, size_t vector_length, size_t num_windows, HTS_Boolean is_msd)
 {
@@ -752,7 +1172,7 @@ static HTS_Boolean HTS_Model_load(HTS_Model * model, HTS_File * pdf, HTS_File *
 
 
 /* HTS_Model_get_index: get index of tree and PDF */
-static void HTS_Model_get_index(HTS_Model * model, size_t state_index, const char *string, size_t * tree_index, size_t * pdf_index)
+static void HTS_Model_get_index(HTS_Model * model, size_t state_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index, size_t * nquestion)
 {
    HTS_Tree *tree;
    HTS_Pattern *pattern;
@@ -771,7 +1191,7 @@ static void HTS_Model_get_index(HTS_Model * model, size_t state_index, const cha
          if (!pattern)
             find = TRUE;
          for (; pattern; pattern = pattern->next)
-            if (HTS_pattern_match(string, pattern->string)) {
+            if (HTS_pattern_match(context->string, pattern->string)) {
                find = TRUE;
                break;
             }
@@ -782,9 +1202,38 @@ static void HTS_Model_get_index(HTS_Model * model, size_t state_index, const cha
    }
 
    if (tree != NULL) {
-      (*pdf_index) = HTS_Tree_search_node(tree, string);
+      (*pdf_index) = HTS_Tree_search_node(tree, context, nquestion);
+   } else {
+      (*pdf_index) = HTS_Tree_search_node(model->tree, context, nquestion);
+   }
+}
+
+/* HTS_ModelSet_get_parameter_slot: get position of parameter model in tree and PDF indices of context (after duration models of all voices, which are at voice index) */
+static size_t HTS_ModelSet_get_parameter_slot(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, size_t state_index)
+{
+   return ms->num_voices + (voice_index * ms->num_streams + stream_index) * ms->num_states + state_index - 2;
+}
+
+/* HTS_ModelSet_get_gv_slot: get position of GV model in tree and PDF indices of context (after parameter models of all voices) */
+static size_t HTS_ModelSet_get_gv_slot(HTS_ModelSet * ms, size_t voice_index, size_t stream_index)
+{
+   return HTS_ModelSet_get_parameter_slot(ms, ms->num_voices, 0, 2) + voice_index * ms->num_streams + stream_index;
+}
+
+/* HTS_ModelSet_get_num_indices: get # of tree and PDF indices of all models and GV switch */
+static size_t HTS_ModelSet_get_num_indices(HTS_ModelSet * ms)
+{
+   return 2 * HTS_ModelSet_get_gv_slot(ms, ms->num_voices, 0) + 1;
+}
+
+/* HTS_Model_get_context_index: get index of tree and PDF, resolved beforehand if context has them */
+static void HTS_Model_get_context_index(HTS_Model * model, size_t state_index, const HTS_Context * context, size_t slot, size_t * tree_index, size_t * pdf_index, size_t * nquestion)
+{
+   if (context->index != NULL) {
+      (*tree_index) = context->index[2 * slot];
+      (*pdf_index) = context->index[2 * slot + 1];
    } else {
-      (*pdf_index) = HTS_Tree_search_node(model->tree, string);
+      HTS_Model_get_index(model, state_index, context, tree_index, pdf_index, nquestion);
    }
 }
 
@@ -807,12 +1256,23 @@ void HTS_ModelSet_initialize(HTS_ModelSet * ms)
    ms->window = NULL;
    ms->stream = NULL;
    ms->gv = NULL;
+   ms->reference_count = 0;
+   ms->voice_file = NULL;
+   ms->num_context_fields = 0;
+   ms->context_field = NULL;
+   ms->num_context_values = 0;
+   ms->context_value = NULL;
+   ms->num_questions = 0;
+   ms->question = NULL;
+   ms->num_pattern_strings = 0;
+   ms->pattern_string = NULL;
 }
 
 /* HTS_ModelSet_clear: free model set */
 void HTS_ModelSet_clear(HTS_ModelSet * ms)
 {
    size_t i, j;
+   HTS_Pattern *pattern;
 
    if (ms->hts_voice_version != NULL)
       free(ms->hts_voice_version);
@@ -822,10 +1282,24 @@ void HTS_ModelSet_clear(HTS_ModelSet * ms)
       free(ms->fullcontext_format);
    if (ms->fullcontext_version != NULL)
       free(ms->fullcontext_version);
-   if (ms->gv_off_context != NULL) {
+   if (ms->question != NULL) {
+      /* shared questions include GV switch, and their pattern strings are freed below */
+      for (i = 0; i < ms->num_questions; i++) {
+         for (pattern = ms->question[i]->head; pattern; pattern = pattern->next)
+            pattern->string = NULL;
+         HTS_Question_clear(ms->question[i]);
+         free(ms->question[i]);
+      }
+      free(ms->question);
+   } else if (ms->gv_off_context != NULL) {
       HTS_Question_clear(ms->gv_off_context);
       free(ms->gv_off_context);
    }
+   if (ms->pattern_string != NULL) {
+      for (i = 0; i < ms->num_pattern_strings; i++)
+         free(ms->pattern_string[i]);
+      free(ms->pattern_string);
+   }
    if (ms->option != NULL) {
       for (i = 0; i < ms->num_streams; i++)
          if (ms->option[i] != NULL)
@@ -859,9 +1333,248 @@ void HTS_ModelSet_clear(HTS_ModelSet * ms)
       }
       free(ms->gv);
    }
+   if (ms->voice_file != NULL) {
+      for (i = 0; i < ms->num_voices; i++)
+         HTS_fclose((HTS_File *) ms->voice_file[i]);
+      free(ms->voice_file);
+   }
+   if (ms->context_field != NULL) {
+      for (i = 0; i < ms->num_context_fields; i++) {
+         free(ms->context_field[i].left);
+         free(ms->context_field[i].right);
+      }
+      free(ms->context_field);
+   }
+   if (ms->context_value != NULL) {
+      for (i = 0; i < ms->num_context_values; i++)
+         free(ms->context_value[i]);
+      free(ms->context_value);
+   }
    HTS_ModelSet_initialize(ms);
 }
 
+/* HTS_compare_string: compare strings for qsort */
+static int HTS_compare_string(const void *a, const void *b)
+{
+   return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* HTS_ModelSet_find_context_value: find token value of compiled patterns (0 if not found) */
+static size_t HTS_ModelSet_find_context_value(HTS_ModelSet * ms, const char *token, size_t length)
+{
+   size_t lower = 0, upper = ms->num_context_values, middle;
+   int result;
+
+   while (lower < upper) {
+      middle = (lower + upper) / 2;
+      result = strncmp(ms->context_value[middle], token, length);
+      if (result == 0 && ms->context_value[middle][length] != '\0')
+         result = 1;
+      if (result == 0)
+         return middle + 1;
+      if (result < 0)
+         lower = middle + 1;
+      else
+         upper = middle;
+   }
+   return 0;
+}
+
+/* HTS_ModelSet_compile_question: count (pass 0), register (pass 1) or compile (pass 2) patterns answered by a field */
+static size_t HTS_ModelSet_compile_question(HTS_ModelSet * ms, HTS_Question * question, int pass)
+{
+   char left[HTS_MAXBUFLEN];
+   char value[HTS_MAXBUFLEN];
+   char right[HTS_MAXBUFLEN];
+   HTS_Pattern *pattern;
+   HTS_ContextField *field;
+   size_t i, n = 0;
+
+   for (pattern = question->head; pattern; pattern = pattern->next) {
+      if (HTS_split_pattern(pattern->string, left, value, right) == FALSE)
+         continue;
+      n++;
+      if (pass == 0)
+         continue;
+      for (i = 0; i < ms->num_context_fields; i++)
+         if (strcmp(ms->context_field[i].left, left) == 0 && strcmp(ms->context_field[i].right, right) == 0)
+            break;
+      if (pass == 1) {
+         if (i == ms->num_context_fields) {
+            field = &ms->context_field[ms->num_context_fields++];
+            field->left = HTS_strdup(left);
+            field->right = HTS_strdup(right);
+            field->left_length = strlen(left);
+            field->right_length = strlen(right);
+         }
+         ms->context_value[ms->num_context_values++] = HTS_strdup(value);
+      } else {
+         pattern->field = i + 1;
+         pattern->value = HTS_ModelSet_find_context_value(ms, value, strlen(value));
+      }
+   }
+   return n;
+}
+
+/* HTS_ModelSet_compile_questions: compile patterns of distinct questions into token values of fields of full-context label */
+static void HTS_ModelSet_compile_questions(HTS_ModelSet * ms)
+{
+   size_t i, j, n;
+   int pass;
+
+   for (pass = 0; pass < 3; pass++) {
+      for (i = 0, n = 0; i < ms->num_questions; i++)
+         n += HTS_ModelSet_compile_question(ms, ms->question[i], pass);
+      if (pass == 0) {
+         if (n == 0)
+            return;
+         ms->context_field = (HTS_ContextField *) HTS_calloc(n, sizeof(HTS_ContextField));
+         ms->context_value = (char **) HTS_calloc(n, sizeof(char *));
+      } else if (pass == 1) {
+         /* sort and unique values */
+         qsort(ms->context_value, ms->num_context_values, sizeof(char *), HTS_compare_string);
+         for (i = 0, j = 0; i < ms->num_context_values; i++) {
+            if (j > 0 && strcmp(ms->context_value[j - 1], ms->context_value[i]) == 0)
+               free(ms->context_value[i]);
+            else
+               ms->context_value[j++] = ms->context_value[i];
+         }
+         ms->num_context_values = j;
+      }
+   }
+}
+
+/* HTS_compare_question: compare questions by name and patterns for qsort */
+static int HTS_compare_question(const void *a, const void *b)
+{
+   const HTS_Question *qa = *(HTS_Question * const *) a;
+   const HTS_Question *qb = *(HTS_Question * const *) b;
+   const HTS_Pattern *pa, *pb;
+   int result = strcmp(qa->string, qb->string);
+
+   for (pa = qa->head, pb = qb->head; result == 0 && pa && pb; pa = pa->next, pb = pb->next)
+      result = strcmp(pa->string, pb->string);
+   if (result == 0 && pa != pb)
+      result = pa ? 1 : -1;
+   return result;
+}
+
+/* HTS_compare_pattern_string: compare patterns by string for qsort */
+static int HTS_compare_pattern_string(const void *a, const void *b)
+{
+   return strcmp((*(HTS_Pattern * const *) a)->string, (*(HTS_Pattern * const *) b)->string);
+}
+
+/* HTS_ModelSet_get_model: get j-th model of i-th voice (duration, streams and GV in order, NULL if not exist) */
+static HTS_Model *HTS_ModelSet_get_model(HTS_ModelSet * ms, size_t i, size_t j)
+{
+   if (j == 0)
+      return &ms->duration[i];
+   if (j <= ms->num_streams)
+      return &ms->stream[i][j - 1];
+   if (ms->gv != NULL && j <= ms->num_streams * 2)
+      return &ms->gv[i][j - 1 - ms->num_streams];
+   return NULL;
+}
+
+/* HTS_ModelSet_list_questions: store questions in list (if not NULL) and return their number */
+static size_t HTS_ModelSet_list_questions(HTS_ModelSet * ms, HTS_Question ** list)
+{
+   size_t i, j, n = 0;
+   HTS_Question *question;
+   HTS_Model *model;
+
+   if (ms->gv_off_context != NULL) {
+      if (list != NULL)
+         list[n] = ms->gv_off_context;
+      n++;
+   }
+   for (i = 0; i < ms->num_voices; i++) {
+      for (j = 0; (model = HTS_ModelSet_get_model(ms, i, j)) != NULL; j++) {
+         for (question = model->question; question; question = question->next) {
+            if (list != NULL)
+               list[n] = question;
+            n++;
+         }
+      }
+   }
+   return n;
+}
+
+/* HTS_ModelSet_intern_patterns: share identical pattern strings among distinct questions */
+static void HTS_ModelSet_intern_patterns(HTS_ModelSet * ms)
+{
+   size_t i, n = 0;
+   HTS_Pattern *pattern, **list;
+
+   for (i = 0; i < ms->num_questions; i++)
+      for (pattern = ms->question[i]->head; pattern; pattern = pattern->next)
+         n++;
+   if (n == 0)
+      return;
+   list = (HTS_Pattern **) HTS_calloc(n, sizeof(HTS_Pattern *));
+   for (i = 0, n = 0; i < ms->num_questions; i++)
+      for (pattern = ms->question[i]->head; pattern; pattern = pattern->next)
+         list[n++] = pattern;
+   qsort(list, n, sizeof(HTS_Pattern *), HTS_compare_pattern_string);
+   ms->pattern_string = (char **) HTS_calloc(n, sizeof(char *));
+   for (i = 0; i < n; i++) {
+      if (ms->num_pattern_strings > 0 && strcmp(ms->pattern_string[ms->num_pattern_strings - 1], list[i]->string) == 0) {
+         HTS_free(list[i]->string);
+         list[i]->string = ms->pattern_string[ms->num_pattern_strings - 1];
+      } else {
+         ms->pattern_string[ms->num_pattern_strings++] = list[i]->string;
+      }
+   }
+   HTS_free(list);
+}
+
+/* HTS_ModelSet_intern_questions: share identical questions in duration, stream and GV trees of all voices, and index them */
+static void HTS_ModelSet_intern_questions(HTS_ModelSet * ms)
+{
+   size_t i, j, k, n;
+   HTS_Question **list;
+   HTS_Model *model;
+   HTS_Tree *tree;
+
+   n = HTS_ModelSet_list_questions(ms, NULL);
+   if (n == 0)
+      return;
+   list = (HTS_Question **) HTS_calloc(n, sizeof(HTS_Question *));
+   HTS_ModelSet_list_questions(ms, list);
+   qsort(list, n, sizeof(HTS_Question *), HTS_compare_question);
+   ms->question = (HTS_Question **) HTS_calloc(n, sizeof(HTS_Question *));
+   for (i = 0; i < n; i++) {
+      if (ms->num_questions == 0 || HTS_compare_question(&ms->question[ms->num_questions - 1], &list[i]) != 0)
+         ms->question[ms->num_questions++] = list[i];
+      list[i]->id = ms->num_questions - 1;
+   }
+
+   /* refer to shared questions from nodes, and free the others */
+   for (i = 0; i < ms->num_voices; i++) {
+      for (j = 0; (model = HTS_ModelSet_get_model(ms, i, j)) != NULL; j++) {
+         for (tree = model->tree; tree; tree = tree->next)
+            for (k = 0; k < tree->num_nodes; k++)
+               if (tree->node[k].quest != NULL)
+                  tree->node[k].quest = ms->question[tree->node[k].quest->id];
+         model->question = NULL;
+      }
+   }
+   if (ms->gv_off_context != NULL)
+      ms->gv_off_context = ms->question[ms->gv_off_context->id];
+   for (i = 0; i < n; i++) {
+      if (ms->question[list[i]->id] != list[i]) {
+         HTS_Question_clear(list[i]);
+         HTS_free(list[i]);
+      }
+   }
+   for (i = 0; i < ms->num_questions; i++)
+      ms->question[i]->next = NULL;
+   HTS_free(list);
+
+   HTS_ModelSet_intern_patterns(ms);
+}
+
 /* HTS_match_head_string: return true if head of str is equal to pattern */
 static HTS_Boolean HTS_match_head_string(const char *str, const char *pattern, size_t * matched_size)
 {
@@ -946,10 +1659,11 @@ HTS_Boolean HTS_ModelSet_load(HTS_ModelSet * ms, char **voices, size_t num_voice
       return FALSE;
 
    ms->num_voices = num_voices;
+   ms->voice_file = (void **) HTS_calloc(num_voices, sizeof(void *));
 
    for (i = 0; i < num_voices && error == FALSE; i++) {
       /* open file */
-      fp = HTS_fopen_from_fn(voices[i], "rb");
+      fp = HTS_fmap_from_fn(voices[i]);
       if (fp == NULL) {
          error = TRUE;
          break;
@@ -1458,9 +2172,9 @@ HTS_Boolean HTS_ModelSet_load(HTS_ModelSet * ms, char **voices, size_t num_voice
          if (temp_gv_tree[j] != NULL)
             free(temp_gv_tree[j]);
       free(temp_gv_tree);
-      /* fclose */
+      /* keep file while PDFs refer to it */
       if (fp != NULL) {
-         HTS_fclose(fp);
+         ms->voice_file[i] = (void *) fp;
          fp = NULL;
       }
       if (error != FALSE)
@@ -1493,9 +2207,753 @@ HTS_Boolean HTS_ModelSet_load(HTS_ModelSet * ms, char **voices, size_t num_voice
    if (use_gv != NULL)
       free(use_gv);
 
+   if (error == FALSE) {
+      HTS_ModelSet_intern_questions(ms);
+      HTS_ModelSet_compile_questions(ms);
+   }
+
    return !error;
 }
 
+/* HTS_print: fprintf which only counts characters if fp is NULL */
+static size_t HTS_print(FILE * fp, const char *format, ...)
+{
+   int n;
+   va_list ap;
+
+   va_start(ap, format);
+   if (fp != NULL)
+      n = vfprintf(fp, format, ap);
+   else
+      n = vsnprintf(NULL, 0, format, ap);
+   va_end(ap);
+
+   return n > 0 ? (size_t) n : 0;
+}
+
+/* HTS_write_uint32: write 32-bit integer in little endian (only count size if fp is NULL) */
+static size_t HTS_write_uint32(uint32_t value, FILE * fp)
+{
+   if (fp != NULL)
+      HTS_fwrite_little_endian(&value, sizeof(value), 1, fp);
+   return sizeof(value);
+}
+
+/* HTS_write_uint16: write 16-bit integer in little endian (only count size if fp is NULL) */
+static size_t HTS_write_uint16(uint16_t value, FILE * fp)
+{
+   if (fp != NULL)
+      HTS_fwrite_little_endian(&value, sizeof(value), 1, fp);
+   return sizeof(value);
+}
+
+/* HTS_write_float: write float in little endian (only count size if fp is NULL) */
+static size_t HTS_write_float(float value, FILE * fp)
+{
+   if (fp != NULL)
+      HTS_fwrite_little_endian(&value, sizeof(value), 1, fp);
+   return sizeof(value);
+}
+
+/* HTS_write_double: write double in little endian (only count size if fp is NULL) */
+static size_t HTS_write_double(double value, FILE * fp)
+{
+   if (fp != NULL)
+      HTS_fwrite_little_endian(&value, sizeof(value), 1, fp);
+   return sizeof(value);
+}
+
+/* HTS_write_string: write length and characters of string (only count size if fp is NULL) */
+static size_t HTS_write_string(const char *string, FILE * fp)
+{
+   size_t length = strlen(string);
+
+   if (fp != NULL) {
+      HTS_write_uint32((uint32_t) length, fp);
+      fwrite(string, sizeof(char), length, fp);
+   }
+   return sizeof(uint32_t) + length;
+}
+
+/* HTS_write_binary_head: write magic number and version of binary section (only count size if fp is NULL) */
+static size_t HTS_write_binary_head(FILE * fp)
+{
+   if (fp != NULL)
+      fwrite(HTS_BINARY_MAGIC, sizeof(char), strlen(HTS_BINARY_MAGIC), fp);
+   return strlen(HTS_BINARY_MAGIC) + HTS_write_uint32(HTS_BINARY_VERSION, fp);
+}
+
+/* HTS_Pattern_save: write list of patterns to binary section */
+static size_t HTS_Pattern_save(const HTS_Pattern * head, FILE * fp)
+{
+   const HTS_Pattern *pattern;
+   uint32_t num_patterns = 0;
+   size_t size;
+
+   for (pattern = head; pattern; pattern = pattern->next)
+      num_patterns++;
+   size = HTS_write_uint32(num_patterns, fp);
+   for (pattern = head; pattern; pattern = pattern->next)
+      size += HTS_write_string(pattern->string, fp);
+
+   return size;
+}
+
+/* HTS_Window_save: write window as binary section */
+static size_t HTS_Window_save(HTS_Window * win, size_t index, FILE * fp)
+{
+   int i;
+   size_t size = HTS_write_binary_head(fp);
+
+   size += HTS_write_uint32((uint32_t) (win->r_width[index] - win->l_width[index] + 1), fp);
+   for (i = win->l_width[index]; i <= win->r_width[index]; i++)
+      size += HTS_write_double(win->coefficient[index][i], fp);
+
+   return size;
+}
+
+/* HTS_Model_get_quantizer: get scale and offset of each dimension of PDFs for quantization */
+static void HTS_Model_get_quantizer(HTS_Model * model, size_t pdf_type, float *scale, float *offset)
+{
+   size_t i, j, k;
+   size_t len = model->vector_length * model->num_windows;
+   size_t width = len + len + (model->is_msd ? 1 : 0);
+   double x, *min, *max;
+   int e;
+
+   min = (double *) HTS_calloc(width, sizeof(double));
+   max = (double *) HTS_calloc(width, sizeof(double));
+   /* trees may have no PDF */
+   for (k = 0; k < width; k++) {
+      min[k] = HUGE_VAL;
+      max[k] = -HUGE_VAL;
+   }
+   for (i = 2; i <= model->ntree + 1; i++) {
+      for (j = 1; j <= model->npdf[i]; j++) {
+         for (k = 0; k < width; k++) {
+            x = HTS_Model_get_pdf_value(model, i, j, k);
+            if (min[k] > x)
+               min[k] = x;
+            if (max[k] < x)
+               max[k] = x;
+         }
+      }
+   }
+   for (k = 0; k < width; k++) {
+      if (min[k] > max[k]) {
+         min[k] = 0.0;
+         max[k] = 0.0;
+      }
+      if (pdf_type == HTS_PDF_HALF) {
+         /* power of two which keeps all values below 2^15 */
+         x = (max[k] > -min[k]) ? max[k] : -min[k];
+         frexp(x, &e);
+         scale[k] = (x > 0.0) ? (float) ldexp(1.0, e - 15) : 1.0f;
+         offset[k] = 0.0f;
+      } else {
+         /* standard deviations are quantized instead of variances */
+         if (k >= len && k < len + len) {
+            min[k] = sqrt(min[k]);
+            max[k] = sqrt(max[k]);
+         }
+         offset[k] = (float) min[k];
+         scale[k] = (float) ((max[k] - min[k]) / 255.0);
+      }
+   }
+   HTS_free(min);
+   HTS_free(max);
+}
+
+/* HTS_Model_save_pdf: write PDFs in the same format as HTS voice, or quantized PDFs as binary section */
+static size_t HTS_Model_save_pdf(HTS_Model * model, size_t pdf_type, FILE * fp)
+{
+   size_t i, j, k, len, width, size = 0;
+   float *scale, *offset;
+   double x;
+
+   if (model->npdf == NULL)
+      return 0;
+
+   len = model->vector_length * model->num_windows;
+   width = len + len + (model->is_msd ? 1 : 0);
+   if (pdf_type != HTS_PDF_HALF && pdf_type != HTS_PDF_BYTE) {
+      for (i = 2; i <= model->ntree + 1; i++)
+         size += HTS_write_uint32((uint32_t) model->npdf[i], fp);
+      for (i = 2; i <= model->ntree + 1; i++)
+         for (j = 1; j <= model->npdf[i]; j++)
+            for (k = 0; k < width; k++)
+               size += HTS_write_float((float) HTS_Model_get_pdf_value(model, i, j, k), fp);
+      return size;
+   }
+
+   scale = (float *) HTS_calloc(width, sizeof(float));
+   offset = (float *) HTS_calloc(width, sizeof(float));
+   HTS_Model_get_quantizer(model, pdf_type, scale, offset);
+   size = HTS_write_binary_head(fp);
+   size += HTS_write_uint32((uint32_t) pdf_type, fp);
+   for (i = 2; i <= model->ntree + 1; i++)
+      size += HTS_write_uint32((uint32_t) model->npdf[i], fp);
+   for (k = 0; k < width; k++)
+      size += HTS_write_float(scale[k], fp);
+   for (k = 0; k < width; k++)
+      size += HTS_write_float(offset[k], fp);
+   for (i = 2; i <= model->ntree + 1; i++) {
+      for (j = 1; j <= model->npdf[i]; j++) {
+         for (k = 0; k < width; k++) {
+            if (pdf_type == HTS_PDF_HALF) {
+               size += HTS_write_uint16(HTS_float_to_half((float) (HTS_Model_get_pdf_value(model, i, j, k) / scale[k])), fp);
+               continue;
+            }
+            if (fp != NULL) {
+               x = HTS_Model_get_pdf_value(model, i, j, k);
+               if (k >= len && k < len + len)
+                  x = sqrt(x);
+               x = (scale[k] > 0.0f) ? (x - offset[k]) / scale[k] + 0.5 : 0.0;
+               fputc(x < 0.0 ? 0 : (x >= 255.0 ? 255 : (int) x), fp);
+            }
+            size++;
+         }
+      }
+   }
+   HTS_free(scale);
+   HTS_free(offset);
+
+   return size;
+}
+
+/* HTS_Model_save_tree: write questions and trees as binary section (nodes refer to questions by index) */
+static size_t HTS_Model_save_tree(HTS_Model * model, FILE * fp)
+{
+   size_t i, j, size, num_questions = 0;
+   uint32_t num_trees = 0;
+   HTS_Question **list = NULL;
+   HTS_Tree *tree;
+
+   if (model->tree == NULL)
+      return 0;
+
+   /* questions asked by nodes (shared among trees), sorted by name to find their indices */
+   for (tree = model->tree; tree; tree = tree->next)
+      num_questions += tree->num_nodes;
+   if (num_questions > 0)
+      list = (HTS_Question **) HTS_calloc(num_questions, sizeof(HTS_Question *));
+   num_questions = 0;
+   for (tree = model->tree; tree; tree = tree->next)
+      for (i = 0; i < tree->num_nodes; i++)
+         if (tree->node[i].quest != NULL)
+            list[num_questions++] = tree->node[i].quest;
+   if (num_questions > 0)
+      qsort(list, num_questions, sizeof(HTS_Question *), HTS_compare_question);
+   for (i = 0, j = 0; i < num_questions; i++)
+      if (j == 0 || list[j - 1] != list[i])
+         list[j++] = list[i];
+   num_questions = j;
+
+   size = HTS_write_binary_head(fp);
+   size += HTS_write_uint32((uint32_t) num_questions, fp);
+   for (i = 0; i < num_questions; i++) {
+      size += HTS_write_string(list[i]->string, fp);
+      size += HTS_Pattern_save(list[i]->head, fp);
+   }
+
+   for (tree = model->tree; tree; tree = tree->next)
+      num_trees++;
+   size += HTS_write_uint32(num_trees, fp);
+   for (tree = model->tree; tree; tree = tree->next) {
+      size += HTS_write_uint32((uint32_t) tree->state, fp);
+      size += HTS_Pattern_save(tree->head, fp);
+      size += HTS_write_uint32((uint32_t) tree->pdf, fp);
+      size += HTS_write_uint32((uint32_t) tree->num_nodes, fp);
+      for (i = 0; i < tree->num_nodes; i++) {
+         if (tree->node[i].quest != NULL)
+            size += HTS_write_uint32((uint32_t) HTS_Question_find_index(list, num_questions, tree->node[i].quest->string), fp);
+         else
+            size += HTS_write_uint32((uint32_t) num_questions, fp);
+         size += HTS_write_uint32((uint32_t) tree->node[i].no, fp);
+         size += HTS_write_uint32((uint32_t) tree->node[i].yes, fp);
+      }
+   }
+
+   if (list != NULL)
+      HTS_free(list);
+   return size;
+}
+
+/* HTS_ModelSet_get_stream_name: get name of stream from stream type */
+static void HTS_ModelSet_get_stream_name(HTS_ModelSet * ms, size_t stream_index, char *buff)
+{
+   size_t i, index = 0;
+
+   buff[0] = '\0';
+   for (i = 0; i <= stream_index; i++)
+      if (HTS_get_token_from_string_with_separator(ms->stream_type, &index, buff, ',') == FALSE)
+         buff[0] = '\0';
+}
+
+/* HTS_ModelSet_save_section: write i-th section of data (duration, windows and streams in order of HTS voice) */
+static size_t HTS_ModelSet_save_section(HTS_ModelSet * ms, size_t voice_index, size_t pdf_type, size_t section, FILE * fp)
+{
+   size_t j;
+
+   /* only PDFs of streams are quantized */
+   if (section == 0)
+      return HTS_Model_save_pdf(&ms->duration[voice_index], HTS_PDF_FLOAT, fp);
+   if (section == 1)
+      return HTS_Model_save_tree(&ms->duration[voice_index], fp);
+   section -= 2;
+   for (j = 0; j < ms->num_streams; j++) {
+      if (section < ms->window[j].size)
+         return HTS_Window_save(&ms->window[j], section, fp);
+      section -= ms->window[j].size;
+   }
+   j = section / 4;
+   switch (section % 4) {
+   case 0:
+      return HTS_Model_save_pdf(&ms->stream[voice_index][j], pdf_type, fp);
+   case 1:
+      return HTS_Model_save_tree(&ms->stream[voice_index][j], fp);
+   case 2:
+      return HTS_Model_save_pdf(&ms->gv[voice_index][j], HTS_PDF_FLOAT, fp);
+   default:
+      return HTS_Model_save_tree(&ms->gv[voice_index][j], fp);
+   }
+}
+
+/* HTS_print_position: print position of section if it is not empty */
+static size_t HTS_print_position(FILE * fp, const char *name, const char *stream_name, const size_t * position, size_t section)
+{
+   if (position[2 * section] == position[2 * section + 1])
+      return 0;
+   if (stream_name != NULL)
+      return HTS_print(fp, "%s[%s]:%lu-%lu\n", name, stream_name, (unsigned long) position[2 * section], (unsigned long) position[2 * section + 1] - 1);
+   return HTS_print(fp, "%s:%lu-%lu\n", name, (unsigned long) position[2 * section], (unsigned long) position[2 * section + 1] - 1);
+}
+
+/* HTS_ModelSet_save_header: write header of HTS voice (only count its length if fp is NULL) */
+static size_t HTS_ModelSet_save_header(HTS_ModelSet * ms, size_t voice_index, const size_t * position, size_t padding, FILE * fp)
+{
+   size_t i, j, section, size = 0;
+   char name[HTS_MAXBUFLEN];
+   HTS_Pattern *pattern;
+   HTS_Model *model;
+
+   size += HTS_print(fp, "[GLOBAL]\n");
+   size += HTS_print(fp, "HTS_VOICE_VERSION:%s\n", ms->hts_voice_version != NULL ? ms->hts_voice_version : "");
+   size += HTS_print(fp, "SAMPLING_FREQUENCY:%lu\n", (unsigned long) ms->sampling_frequency);
+   size += HTS_print(fp, "FRAME_PERIOD:%lu\n", (unsigned long) ms->frame_period);
+   size += HTS_print(fp, "NUM_STATES:%lu\n", (unsigned long) ms->num_states);
+   size += HTS_print(fp, "NUM_STREAMS:%lu\n", (unsigned long) ms->num_streams);
+   if (ms->stream_type != NULL)
+      size += HTS_print(fp, "STREAM_TYPE:%s\n", ms->stream_type);
+   if (ms->fullcontext_format != NULL)
+      size += HTS_print(fp, "FULLCONTEXT_FORMAT:%s\n", ms->fullcontext_format);
+   if (ms->fullcontext_version != NULL)
+      size += HTS_print(fp, "FULLCONTEXT_VERSION:%s\n", ms->fullcontext_version);
+   if (ms->gv_off_context != NULL) {
+      size += HTS_print(fp, "GV_OFF_CONTEXT:");
+      for (pattern = ms->gv_off_context->head; pattern; pattern = pattern->next)
+         size += HTS_print(fp, "\"%s\"%s", pattern->string, pattern->next != NULL ? "," : "");
+      size += HTS_print(fp, "\n");
+   }
+   size += HTS_print(fp, "COMMENT:%*s\n", (int) padding, "");
+
+   size += HTS_print(fp, "[STREAM]\n");
+   for (j = 0; j < ms->num_streams; j++) {
+      model = &ms->stream[voice_index][j];
+      HTS_ModelSet_get_stream_name(ms, j, name);
+      size += HTS_print(fp, "VECTOR_LENGTH[%s]:%lu\n", name, (unsigned long) model->vector_length);
+      size += HTS_print(fp, "IS_MSD[%s]:%d\n", name, model->is_msd ? 1 : 0);
+      size += HTS_print(fp, "NUM_WINDOWS[%s]:%lu\n", name, (unsigned long) ms->window[j].size);
+      size += HTS_print(fp, "USE_GV[%s]:%d\n", name, ms->gv[voice_index][j].vector_length != 0 ? 1 : 0);
+      if (ms->option[j] != NULL)
+         size += HTS_print(fp, "OPTION[%s]:%s\n", name, ms->option[j]);
+   }
+
+   size += HTS_print(fp, "[POSITION]\n");
+   size += HTS_print_position(fp, "DURATION_PDF", NULL, position, 0);
+   size += HTS_print_position(fp, "DURATION_TREE", NULL, position, 1);
+   section = 2;
+   for (j = 0; j < ms->num_streams; j++) {
+      HTS_ModelSet_get_stream_name(ms, j, name);
+      size += HTS_print(fp, "STREAM_WIN[%s]:", name);
+      for (i = 0; i < ms->window[j].size; i++, section++)
+         size += HTS_print(fp, "%lu-%lu%s", (unsigned long) position[2 * section], (unsigned long) position[2 * section + 1] - 1, i + 1 < ms->window[j].size ? "," : "\n");
+   }
+   for (j = 0; j < ms->num_streams; j++, section += 4) {
+      HTS_ModelSet_get_stream_name(ms, j, name);
+      size += HTS_print_position(fp, "STREAM_PDF", name, position, section);
+      size += HTS_print_position(fp, "STREAM_TREE", name, position, section + 1);
+      size += HTS_print_position(fp, "GV_PDF", name, position, section + 2);
+      size += HTS_print_position(fp, "GV_TREE", name, position, section + 3);
+   }
+   size += HTS_print(fp, "[DATA]\n");
+
+   return size;
+}
+
+/* HTS_ModelSet_save: save voice with trees and windows in binary sections, aligning sections to 8 bytes */
+HTS_Boolean HTS_ModelSet_save(HTS_ModelSet * ms, size_t voice_index, size_t pdf_type, FILE * fp)
+{
+   size_t i, j, size, offset, padding, num_sections;
+   size_t *position;
+
+   if (ms == NULL || fp == NULL || voice_index >= ms->num_voices || ms->duration == NULL)
+      return FALSE;
+
+   /* locate sections */
+   num_sections = 2 + 4 * ms->num_streams;
+   for (j = 0; j < ms->num_streams; j++)
+      num_sections += ms->window[j].size;
+   position = (size_t *) HTS_calloc(2 * num_sections, sizeof(size_t));
+   for (i = 0, offset = 0; i < num_sections; i++) {
+      size = HTS_ModelSet_save_section(ms, voice_index, pdf_type, i, NULL);
+      position[2 * i] = offset;
+      position[2 * i + 1] = offset + size;
+      if (size > 0)
+         offset = (offset + size + 7) / 8 * 8;
+   }
+
+   /* header padded so that data starts at multiple of 8 bytes */
+   padding = HTS_ModelSet_save_header(ms, voice_index, position, 0, NULL) % 8;
+   padding = (padding == 0) ? 0 : 8 - padding;
+   HTS_ModelSet_save_header(ms, voice_index, position, padding, fp);
+
+   /* data */
+   for (i = 0, offset = 0; i < num_sections; i++) {
+      for (; offset < position[2 * i]; offset++)
+         fputc('\0', fp);
+      offset += HTS_ModelSet_save_section(ms, voice_index, pdf_type, i, fp);
+   }
+
+   HTS_free(position);
+   return ferror(fp) ? FALSE : TRUE;
+}
+
+/* HTS_Context_initialize: initialize context */
+void HTS_Context_initialize(HTS_Context * context)
+{
+   context->string = NULL;
+   context->num_fields = 0;
+   context->start = NULL;
+   context->value = NULL;
+   context->size = 0;
+   context->token = NULL;
+   context->token_size = 0;
+   context->num_questions = 0;
+   context->answer = NULL;
+   context->index = NULL;
+}
+
+/* HTS_Context_set: split full-context label into fields used by model set */
+void HTS_Context_set(HTS_Context * context, HTS_ModelSet * ms, const char *string)
+{
+   size_t i, j, k, n;
+   size_t length = strlen(string);
+   size_t ntoken = 0;
+   size_t s, e;
+   HTS_ContextField *field;
+
+   context->string = string;
+   if (context->answer == NULL || context->num_questions != ms->num_questions) {
+      if (context->answer != NULL)
+         HTS_free(context->answer);
+      context->num_questions = ms->num_questions;
+      context->answer = (unsigned char *) HTS_calloc(context->num_questions + 1, sizeof(unsigned char));
+   } else {
+      memset(context->answer, 0, context->num_questions);
+   }
+   if (context->start == NULL || context->num_fields != ms->num_context_fields) {
+      if (context->start != NULL)
+         HTS_free(context->start);
+      context->num_fields = ms->num_context_fields;
+      context->start = (size_t *) HTS_calloc(context->num_fields + 2, sizeof(size_t));
+   }
+   if (context->num_fields == 0)
+      return;
+
+   /* find tokens having values of compiled patterns */
+   if (context->token_size < (length / 2 + 1) * 3) {
+      if (context->token != NULL)
+         HTS_free(context->token);
+      context->token_size = (length / 2 + 1) * 3;
+      context->token = (size_t *) HTS_calloc(context->token_size, sizeof(size_t));
+   }
+   for (i = 0; i < length; i = j) {
+      for (; i < length && HTS_is_token_char(string[i]) == FALSE; i++);
+      for (j = i; j < length && HTS_is_token_char(string[j]) == TRUE; j++);
+      if (i == j)
+         break;
+      k = HTS_ModelSet_find_context_value(ms, &string[i], j - i);
+      if (k > 0) {
+         context->token[ntoken * 3] = i;
+         context->token[ntoken * 3 + 1] = j;
+         context->token[ntoken * 3 + 2] = k;
+         ntoken++;
+      }
+   }
+
+   /* collect token values delimited by each field */
+   n = 0;
+   for (i = 1; i <= context->num_fields; i++) {
+      field = &ms->context_field[i - 1];
+      context->start[i] = n;
+      for (k = 0; k < ntoken; k++) {
+         s = context->token[k * 3];
+         e = context->token[k * 3 + 1];
+         /* left delimiter */
+         if (field->left_length > s + 1)
+            continue;
+         if (field->left_length == s + 1) {
+            if (field->left[0] != '\001' || memcmp(field->left + 1, string, s) != 0)
+               continue;
+         } else if (string[s - 1] != field->left[field->left_length - 1] || memcmp(field->left, &string[s - field->left_length], field->left_length) != 0) {
+            continue;
+         }
+         /* right delimiter */
+         if (field->right_length > length - e + 1)
+            continue;
+         if (field->right_length == length - e + 1) {
+            if (field->right[field->right_length - 1] != '\002' || memcmp(field->right, &string[e], length - e) != 0)
+               continue;
+         } else if (string[e] != field->right[0] || memcmp(field->right, &string[e], field->right_length) != 0) {
+            continue;
+         }
+         if (n == context->size) {
+            size_t *value = (size_t *) HTS_calloc(n * 2 + 16, sizeof(size_t));
+            if (context->value != NULL) {
+               memcpy(value, context->value, n * sizeof(size_t));
+               HTS_free(context->value);
+            }
+            context->value = value;
+            context->size = n * 2 + 16;
+         }
+         context->value[n++] = context->token[k * 3 + 2];
+      }
+   }
+   context->start[context->num_fields + 1] = n;
+}
+
+/* HTS_Context_clear: free context */
+void HTS_Context_clear(HTS_Context * context)
+{
+   if (context->start != NULL)
+      HTS_free(context->start);
+   if (context->value != NULL)
+      HTS_free(context->value);
+   if (context->token != NULL)
+      HTS_free(context->token);
+   if (context->answer != NULL)
+      HTS_free(context->answer);
+   if (context->index != NULL)
+      HTS_free(context->index);
+   HTS_Context_initialize(context);
+}
+
+/* HTS_Context_resolve: search decision trees of all models for context */
+static void HTS_Context_resolve(HTS_Context * context, HTS_ModelSet * ms, size_t * nquestion)
+{
+   size_t i, j, k;
+   size_t num_indices = HTS_ModelSet_get_num_indices(ms);
+   size_t *index = (size_t *) HTS_calloc(num_indices, sizeof(size_t));
+   size_t slot;
+
+   for (i = 0; i < ms->num_voices; i++) {
+      slot = i;                 /* duration models come first */
+      HTS_Model_get_index(&ms->duration[i], 2, context, &index[2 * slot], &index[2 * slot + 1], nquestion);
+      for (j = 0; j < ms->num_streams; j++) {
+         for (k = 2; k <= ms->num_states + 1; k++) {
+            slot = HTS_ModelSet_get_parameter_slot(ms, i, j, k);
+            HTS_Model_get_index(&ms->stream[i][j], k, context, &index[2 * slot], &index[2 * slot + 1], nquestion);
+         }
+         slot = HTS_ModelSet_get_gv_slot(ms, i, j);
+         HTS_Model_get_index(&ms->gv[i][j], 2, context, &index[2 * slot], &index[2 * slot + 1], nquestion);
+      }
+   }
+   index[num_indices - 1] = (size_t) HTS_ModelSet_get_gv_flag(ms, context, nquestion);
+   context->index = index;
+}
+
+/* HTS_PdfCache_initialize: initialize PDF cache */
+void HTS_PdfCache_initialize(HTS_PdfCache * cache)
+{
+   cache->max_size = 0;
+   cache->size = 0;
+   cache->num_indices = 0;
+   cache->num_buckets = 0;
+   cache->bucket = NULL;
+   cache->head = NULL;
+   cache->tail = NULL;
+   cache->hits = 0;
+   cache->misses = 0;
+}
+
+/* HTS_PdfCache_hash: get hash value of label */
+static size_t HTS_PdfCache_hash(const char *string)
+{
+   size_t hash = 2166136261u;
+
+   for (; *string != '\0'; string++)
+      hash = (hash ^ (unsigned char) *string) * 16777619u;
+   return hash;
+}
+
+/* HTS_PdfCache_find: find link to entry of label in hash bucket */
+static HTS_PdfCacheEntry **HTS_PdfCache_find(HTS_PdfCache * cache, const char *string, size_t hash)
+{
+   HTS_PdfCacheEntry **link = &cache->bucket[hash % cache->num_buckets];
+
+   while (*link != NULL && ((*link)->hash != hash || strcmp((*link)->string, string) != 0))
+      link = &(*link)->chain;
+   return link;
+}
+
+/* HTS_PdfCache_unlink: remove entry from list of recently used entries */
+static void HTS_PdfCache_unlink(HTS_PdfCache * cache, HTS_PdfCacheEntry * entry)
+{
+   if (entry->prev != NULL)
+      entry->prev->next = entry->next;
+   else
+      cache->head = entry->next;
+   if (entry->next != NULL)
+      entry->next->prev = entry->prev;
+   else
+      cache->tail = entry->prev;
+   entry->prev = NULL;
+   entry->next = NULL;
+}
+
+/* HTS_PdfCache_push: add entry to head of list of recently used entries */
+static void HTS_PdfCache_push(HTS_PdfCache * cache, HTS_PdfCacheEntry * entry)
+{
+   entry->prev = NULL;
+   entry->next = cache->head;
+   if (cache->head != NULL)
+      cache->head->prev = entry;
+   cache->head = entry;
+   if (cache->tail == NULL)
+      cache->tail = entry;
+}
+
+/* HTS_PdfCache_remove: free entry */
+static void HTS_PdfCache_remove(HTS_PdfCache * cache, HTS_PdfCacheEntry * entry)
+{
+   HTS_PdfCacheEntry **link = HTS_PdfCache_find(cache, entry->string, entry->hash);
+
+   *link = entry->chain;
+   HTS_PdfCache_unlink(cache, entry);
+   HTS_free(entry->index);
+   HTS_free(entry);
+   cache->size--;
+}
+
+/* HTS_PdfCache_grow: double hash buckets */
+static void HTS_PdfCache_grow(HTS_PdfCache * cache)
+{
+   size_t i;
+   size_t num_buckets = (cache->num_buckets == 0) ? 64 : cache->num_buckets * 2;
+   HTS_PdfCacheEntry **bucket = (HTS_PdfCacheEntry **) HTS_calloc(num_buckets, sizeof(HTS_PdfCacheEntry *));
+   HTS_PdfCacheEntry *entry, *chain;
+
+   for (i = 0; i < cache->num_buckets; i++) {
+      for (entry = cache->bucket[i]; entry != NULL; entry = chain) {
+         chain = entry->chain;
+         entry->chain = bucket[entry->hash % num_buckets];
+         bucket[entry->hash % num_buckets] = entry;
+      }
+   }
+   if (cache->bucket != NULL)
+      HTS_free(cache->bucket);
+   cache->bucket = bucket;
+   cache->num_buckets = num_buckets;
+}
+
+/* HTS_PdfCache_set_size: set max number of entries, removing least recently used ones */
+void HTS_PdfCache_set_size(HTS_PdfCache * cache, size_t max_size)
+{
+   cache->max_size = max_size;
+   while (cache->size > cache->max_size)
+      HTS_PdfCache_remove(cache, cache->tail);
+}
+
+/* HTS_PdfCache_set_context: set context of label, taking tree and PDF indices from cache if possible */
+void HTS_PdfCache_set_context(HTS_PdfCache * cache, HTS_ModelSet * ms, HTS_Context * context, const char *string, size_t * nquestion)
+{
+   size_t hash;
+   size_t length;
+   HTS_PdfCacheEntry *entry;
+   HTS_PdfCacheEntry **link;
+
+   if (cache->max_size == 0) {
+      HTS_Context_set(context, ms, string);
+      return;
+   }
+   if (cache->num_indices != HTS_ModelSet_get_num_indices(ms)) {
+      /* entries of other model set are useless */
+      while (cache->tail != NULL)
+         HTS_PdfCache_remove(cache, cache->tail);
+      cache->num_indices = HTS_ModelSet_get_num_indices(ms);
+   }
+   if (cache->num_buckets == 0)
+      HTS_PdfCache_grow(cache);
+
+   hash = HTS_PdfCache_hash(string);
+   link = HTS_PdfCache_find(cache, string, hash);
+   if (*link != NULL) {
+      /* decision trees are not searched, so label need not be split */
+      entry = *link;
+      HTS_PdfCache_unlink(cache, entry);
+      HTS_PdfCache_push(cache, entry);
+      context->string = string;
+      context->index = (size_t *) HTS_calloc(cache->num_indices, sizeof(size_t));
+      memcpy(context->index, entry->index, cache->num_indices * sizeof(size_t));
+      cache->hits++;
+      return;
+   }
+
+   HTS_Context_set(context, ms, string);
+   HTS_Context_resolve(context, ms, nquestion);
+   cache->misses++;
+
+   /* indices and label are stored in one block */
+   length = strlen(string);
+   entry = (HTS_PdfCacheEntry *) HTS_calloc(1, sizeof(HTS_PdfCacheEntry));
+   entry->index = (size_t *) HTS_calloc(cache->num_indices * sizeof(size_t) + length + 1, sizeof(char));
+   memcpy(entry->index, context->index, cache->num_indices * sizeof(size_t));
+   entry->string = (char *) (entry->index + cache->num_indices);
+   memcpy(entry->string, string, length + 1);
+   entry->hash = hash;
+
+   if (cache->size >= cache->max_size)
+      HTS_PdfCache_remove(cache, cache->tail);
+   if (cache->size >= cache->num_buckets)
+      HTS_PdfCache_grow(cache);
+   link = &cache->bucket[hash % cache->num_buckets];
+   entry->chain = *link;
+   *link = entry;
+   HTS_PdfCache_push(cache, entry);
+   cache->size++;
+}
+
+/* HTS_PdfCache_clear: free PDF cache */
+void HTS_PdfCache_clear(HTS_PdfCache * cache)
+{
+   HTS_PdfCache_set_size(cache, 0);
+   if (cache->bucket != NULL)
+      HTS_free(cache->bucket);
+   HTS_PdfCache_initialize(cache);
+}
+
+/* HTS_ModelSet_prefetch: advise that memory-mapped HTS voices will be used soon */
+void HTS_ModelSet_prefetch(HTS_ModelSet * ms)
+{
+   size_t i;
+
+   if (ms->voice_file == NULL)
+      return;
+   for (i = 0; i < ms->num_voices; i++)
+      HTS_fprefetch((HTS_File *) ms->voice_file[i]);
+}
+
 /* HTS_ModelSet_get_sampling_frequency: get sampling frequency of HTS voices */
 size_t HTS_ModelSet_get_sampling_frequency(HTS_ModelSet * ms)
 {
@@ -1515,11 +2973,15 @@ const char *HTS_ModelSet_get_option(HTS_ModelSet * ms, size_t stream_index)
 }
 
 /* HTS_ModelSet_get_gv_flag: get GV flag */
-HTS_Boolean HTS_ModelSet_get_gv_flag(HTS_ModelSet * ms, const char *string)
+HTS_Boolean HTS_ModelSet_get_gv_flag(HTS_ModelSet * ms, const HTS_Context * context, size_t * nquestion)
 {
+   if (context->index != NULL)
+      return (HTS_Boolean) context->index[HTS_ModelSet_get_num_indices(ms) - 1];
    if (ms->gv_off_context == NULL)
       return TRUE;
-   else if (HTS_Question_match(ms->gv_off_context, string) == TRUE)
+   if (nquestion != NULL)
+      (*nquestion)++;
+   if (HTS_Question_match(ms->gv_off_context, context) == TRUE)
       return FALSE;
    else
       return TRUE;
@@ -1607,29 +3069,29 @@ HTS_Boolean HTS_ModelSet_use_gv(HTS_ModelSet * ms, size_t stream_index)
 }
 
 /* HTS_Model_add_parameter: get parameter using interpolation weight */
-static void HTS_Model_add_parameter(HTS_Model * model, size_t state_index, const char *string, double *mean, double *vari, double *msd, double weight)
+static void HTS_Model_add_parameter(HTS_Model * model, size_t state_index, const HTS_Context * context, size_t slot, double *mean, double *vari, double *msd, double weight, size_t * nquestion)
 {
    size_t i;
    size_t tree_index, pdf_index;
    size_t len = model->vector_length * model->num_windows;
 
-   HTS_Model_get_index(model, state_index, string, &tree_index, &pdf_index);
+   HTS_Model_get_context_index(model, state_index, context, slot, &tree_index, &pdf_index, nquestion);
    for (i = 0; i < len; i++) {
-      mean[i] += weight * model->pdf[tree_index][pdf_index][i];
-      vari[i] += weight * model->pdf[tree_index][pdf_index][i + len];
+      mean[i] += weight * HTS_Model_get_pdf_value(model, tree_index, pdf_index, i);
+      vari[i] += weight * HTS_Model_get_pdf_value(model, tree_index, pdf_index, i + len);
    }
    if (msd != NULL && model->is_msd == TRUE)
-      *msd += weight * model->pdf[tree_index][pdf_index][len + len];
+      *msd += weight * HTS_Model_get_pdf_value(model, tree_index, pdf_index, len + len);
 }
 
 /* HTS_ModelSet_get_duration_index: get duration PDF & tree index */
-void HTS_ModelSet_get_duration_index(HTS_ModelSet * ms, size_t voice_index, const char *string, size_t * tree_index, size_t * pdf_index)
+void HTS_ModelSet_get_duration_index(HTS_ModelSet * ms, size_t voice_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index)
 {
-   HTS_Model_get_index(&ms->duration[voice_index], 2, string, tree_index, pdf_index);
+   HTS_Model_get_context_index(&ms->duration[voice_index], 2, context, voice_index, tree_index, pdf_index, NULL);
 }
 
 /* HTS_ModelSet_get_duration: get duration using interpolation weight */
-void HTS_ModelSet_get_duration(HTS_ModelSet * ms, const char *string, const double *iw, double *mean, double *vari)
+void HTS_ModelSet_get_duration(HTS_ModelSet * ms, const HTS_Context * context, const double *iw, double *mean, double *vari, size_t * nquestion)
 {
    size_t i;
    size_t len = ms->num_states;
@@ -1640,17 +3102,17 @@ void HTS_ModelSet_get_duration(HTS_ModelSet * ms, const char *string, const doub
    }
    for (i = 0; i < ms->num_voices; i++)
       if (iw[i] != 0.0)
-         HTS_Model_add_parameter(&ms->duration[i], 2, string, mean, vari, NULL, iw[i]);
+         HTS_Model_add_parameter(&ms->duration[i], 2, context, i, mean, vari, NULL, iw[i], nquestion);
 }
 
 /* HTS_ModelSet_get_parameter_index: get paramter PDF & tree index */
-void HTS_ModelSet_get_parameter_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, size_t state_index, const char *string, size_t * tree_index, size_t * pdf_index)
+void HTS_ModelSet_get_parameter_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, size_t state_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index)
 {
-   HTS_Model_get_index(&ms->stream[voice_index][stream_index], state_index, string, tree_index, pdf_index);
+   HTS_Model_get_context_index(&ms->stream[voice_index][stream_index], state_index, context, HTS_ModelSet_get_parameter_slot(ms, voice_index, stream_index, state_index), tree_index, pdf_index, NULL);
 }
 
 /* HTS_ModelSet_get_parameter: get parameter using interpolation weight */
-void HTS_ModelSet_get_parameter(HTS_ModelSet * ms, size_t stream_index, size_t state_index, const char *string, const double *const *iw, double *mean, double *vari, double *msd)
+void HTS_ModelSet_get_parameter(HTS_ModelSet * ms, size_t stream_index, size_t state_index, const HTS_Context * context, const double *const *iw, double *mean, double *vari, double *msd, size_t * nquestion)
 {
    size_t i;
    size_t len = ms->stream[0][stream_index].vector_length * ms->stream[0][stream_index].num_windows;
@@ -1664,17 +3126,17 @@ void HTS_ModelSet_get_parameter(HTS_ModelSet * ms, size_t stream_index, size_t s
 
    for (i = 0; i < ms->num_voices; i++)
       if (iw[i][stream_index] != 0.0)
-         HTS_Model_add_parameter(&ms->stream[i][stream_index], state_index, string, mean, vari, msd, iw[i][stream_index]);
+         HTS_Model_add_parameter(&ms->stream[i][stream_index], state_index, context, HTS_ModelSet_get_parameter_slot(ms, i, stream_index, state_index), mean, vari, msd, iw[i][stream_index], nquestion);
 }
 
 /* HTS_ModelSet_get_gv_index: get gv PDF & tree index */
-void HTS_ModelSet_get_gv_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, const char *string, size_t * tree_index, size_t * pdf_index)
+void HTS_ModelSet_get_gv_index(HTS_ModelSet * ms, size_t voice_index, size_t stream_index, const HTS_Context * context, size_t * tree_index, size_t * pdf_index)
 {
-   HTS_Model_get_index(&ms->gv[voice_index][stream_index], 2, string, tree_index, pdf_index);
+   HTS_Model_get_context_index(&ms->gv[voice_index][stream_index], 2, context, HTS_ModelSet_get_gv_slot(ms, voice_index, stream_index), tree_index, pdf_index, NULL);
 }
 
 /* HTS_ModelSet_get_gv: get GV using interpolation weight */
-void HTS_ModelSet_get_gv(HTS_ModelSet * ms, size_t stream_index, const char *string, const double *const *iw, double *mean, double *vari)
+void HTS_ModelSet_get_gv(HTS_ModelSet * ms, size_t stream_index, const HTS_Context * context, const double *const *iw, double *mean, double *vari, size_t * nquestion)
 {
    size_t i;
    size_t len = ms->stream[0][stream_index].vector_length;
@@ -1685,7 +3147,7 @@ void HTS_ModelSet_get_gv(HTS_ModelSet * ms, size_t stream_index, const char *str
    }
    for (i = 0; i < ms->num_voices; i++)
       if (iw[i][stream_index] != 0.0)
-         HTS_Model_add_parameter(&ms->gv[i][stream_index], 2, string, mean, vari, NULL, iw[i][stream_index]);
+         HTS_Model_add_parameter(&ms->gv[i][stream_index], 2, context, HTS_ModelSet_get_gv_slot(ms, i, stream_index), mean, vari, NULL, iw[i][stream_index], nquestion);
 }
 
 HTS_MODEL_C_END;
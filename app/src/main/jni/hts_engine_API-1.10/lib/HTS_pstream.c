@@ -55,7 +55,7 @@
 
 HTS_PSTREAM_C_START;
 
-#include <math.h>               /* for sqrt() */
+#include <math.h>               /* for sqrt(),fabs() */
 
 /* hts_engine libraries */
 #include "HTS_hidden.h"
@@ -75,192 +75,320 @@ static double HTS_finv(const double x)
    return (1.0 / x);
 }
 
-/* HTS_PStream_calc_wuw_and_wum: calcurate W'U^{-1}W and W'U^{-1}M */
-static void HTS_PStream_calc_wuw_and_wum(HTS_PStream * pst, size_t m)
+/* HTS_PStream_calc_wuw_and_wum: calcurate W'U^{-1}W and W'U^{-1}M of dimensions m0 ... m1 - 1 */
+static void HTS_PStream_calc_wuw_and_wum(HTS_PStream * pst, size_t m0, size_t m1)
 {
-   size_t t, i, j;
+   const size_t vl = pst->vector_length;
+   size_t t, i, j, m;
    int shift;
-   double wu;
+   double c, d;
+   double *wuw, *wum;
+   const double *ivar, *mean;
 
    for (t = 0; t < pst->length; t++) {
+      wuw = &pst->sm.wuw[t * pst->width * vl];
+      wum = &pst->sm.wum[t * vl];
+
       /* initialize */
-      pst->sm.wum[t] = 0.0;
-      for (i = 0; i < pst->width; i++)
-         pst->sm.wuw[t][i] = 0.0;
+      for (m = m0; m < m1; m++)
+         wum[m] = 0.0;
+      for (j = 0; j < pst->width; j++)
+         for (m = m0; m < m1; m++)
+            wuw[j * vl + m] = 0.0;
 
       /* calc WUW & WUM */
       for (i = 0; i < pst->win_size; i++)
          for (shift = pst->win_l_width[i]; shift <= pst->win_r_width[i]; shift++)
             if (((int) t + shift >= 0) && ((int) t + shift < pst->length) && (pst->win_coefficient[i][-shift] != 0.0)) {
-               wu = pst->win_coefficient[i][-shift] * pst->sm.ivar[t + shift][i * pst->vector_length + m];
-               pst->sm.wum[t] += wu * pst->sm.mean[t + shift][i * pst->vector_length + m];
+               c = pst->win_coefficient[i][-shift];
+               ivar = &pst->sm.ivar[t + shift][i * vl];
+               mean = &pst->sm.mean[t + shift][i * vl];
+               for (m = m0; m < m1; m++)
+                  wum[m] += c * ivar[m] * mean[m];
                for (j = 0; (j < pst->width) && (t + j < pst->length); j++)
-                  if (((int) j <= pst->win_r_width[i] + shift) && (pst->win_coefficient[i][j - shift] != 0.0))
-                     pst->sm.wuw[t][j] += wu * pst->win_coefficient[i][j - shift];
+                  if (((int) j <= pst->win_r_width[i] + shift) && (pst->win_coefficient[i][j - shift] != 0.0)) {
+                     d = pst->win_coefficient[i][j - shift];
+                     for (m = m0; m < m1; m++)
+                        wuw[j * vl + m] += c * ivar[m] * d;
+                  }
             }
    }
 }
 
-
-/* HTS_PStream_ldl_factorization: Factorize W'*U^{-1}*W to L*D*L' (L: lower triangular, D: diagonal) */
-static void HTS_PStream_ldl_factorization(HTS_PStream * pst)
+/* HTS_PStream_ldl_factorization: Factorize W'*U^{-1}*W to L*D*L' (L: lower triangular, D: diagonal) for dimensions m0 ... m1 - 1 */
+static void HTS_PStream_ldl_factorization(HTS_PStream * pst, size_t m0, size_t m1)
 {
-   size_t t, i, j;
+   const size_t vl = pst->vector_length;
+   const size_t band = pst->width * vl;
+   size_t t, i, j, m;
+   double *wuw;
+   const double *prev;
 
    for (t = 0; t < pst->length; t++) {
-      for (i = 1; (i < pst->width) && (t >= i); i++)
-         pst->sm.wuw[t][0] -= pst->sm.wuw[t - i][i] * pst->sm.wuw[t - i][i] * pst->sm.wuw[t - i][0];
+      wuw = &pst->sm.wuw[t * band];
+      for (i = 1; (i < pst->width) && (t >= i); i++) {
+         prev = &pst->sm.wuw[(t - i) * band];
+         for (m = m0; m < m1; m++)
+            wuw[m] -= prev[i * vl + m] * prev[i * vl + m] * prev[m];
+      }
 
       for (i = 1; i < pst->width; i++) {
-         for (j = 1; (i + j < pst->width) && (t >= j); j++)
-            pst->sm.wuw[t][i] -= pst->sm.wuw[t - j][j] * pst->sm.wuw[t - j][i + j] * pst->sm.wuw[t - j][0];
-         pst->sm.wuw[t][i] /= pst->sm.wuw[t][0];
+         for (j = 1; (i + j < pst->width) && (t >= j); j++) {
+            prev = &pst->sm.wuw[(t - j) * band];
+            for (m = m0; m < m1; m++)
+               wuw[i * vl + m] -= prev[j * vl + m] * prev[(i + j) * vl + m] * prev[m];
+         }
+         for (m = m0; m < m1; m++)
+            wuw[i * vl + m] /= wuw[m];
       }
    }
 }
 
 /* HTS_PStream_forward_substitution: forward subtitution for mlpg */
-static void HTS_PStream_forward_substitution(HTS_PStream * pst)
+static void HTS_PStream_forward_substitution(HTS_PStream * pst, size_t m0, size_t m1)
 {
-   size_t t, i;
+   const size_t vl = pst->vector_length;
+   const size_t band = pst->width * vl;
+   size_t t, i, m;
+   double *g;
+   const double *wuw, *prev;
 
    for (t = 0; t < pst->length; t++) {
-      pst->sm.g[t] = pst->sm.wum[t];
-      for (i = 1; (i < pst->width) && (t >= i); i++)
-         pst->sm.g[t] -= pst->sm.wuw[t - i][i] * pst->sm.g[t - i];
+      g = &pst->sm.g[t * vl];
+      for (m = m0; m < m1; m++)
+         g[m] = pst->sm.wum[t * vl + m];
+      for (i = 1; (i < pst->width) && (t >= i); i++) {
+         wuw = &pst->sm.wuw[(t - i) * band + i * vl];
+         prev = &pst->sm.g[(t - i) * vl];
+         for (m = m0; m < m1; m++)
+            g[m] -= wuw[m] * prev[m];
+      }
    }
 }
 
 /* HTS_PStream_backward_substitution: backward subtitution for mlpg */
-static void HTS_PStream_backward_substitution(HTS_PStream * pst, size_t m)
+static void HTS_PStream_backward_substitution(HTS_PStream * pst, size_t m0, size_t m1)
 {
-   size_t rev, t, i;
+   const size_t vl = pst->vector_length;
+   size_t rev, t, i, m;
+   double *par;
+   const double *wuw, *g, *next;
 
    for (rev = 0; rev < pst->length; rev++) {
       t = pst->length - 1 - rev;
-      pst->par[t][m] = pst->sm.g[t] / pst->sm.wuw[t][0];
-      for (i = 1; (i < pst->width) && (t + i < pst->length); i++)
-         pst->par[t][m] -= pst->sm.wuw[t][i] * pst->par[t + i][m];
+      par = pst->par[t];
+      wuw = &pst->sm.wuw[t * pst->width * vl];
+      g = &pst->sm.g[t * vl];
+      for (m = m0; m < m1; m++)
+         par[m] = g[m] / wuw[m];
+      for (i = 1; (i < pst->width) && (t + i < pst->length); i++) {
+         next = pst->par[t + i];
+         for (m = m0; m < m1; m++)
+            par[m] -= wuw[i * vl + m] * next[m];
+      }
    }
 }
 
 /* HTS_PStream_calc_gv: subfunction for mlpg using GV */
-static void HTS_PStream_calc_gv(HTS_PStream * pst, size_t m, double *mean, double *vari)
+static void HTS_PStream_calc_gv(HTS_PStream * pst, size_t m0, size_t m1, double *mean, double *vari)
 {
-   size_t t;
+   size_t t, m;
+   double x;
 
-   *mean = 0.0;
+   for (m = m0; m < m1; m++)
+      mean[m] = 0.0;
    for (t = 0; t < pst->length; t++)
       if (pst->gv_switch[t])
-         *mean += pst->par[t][m];
-   *mean /= pst->gv_length;
-   *vari = 0.0;
+         for (m = m0; m < m1; m++)
+            mean[m] += pst->par[t][m];
+   for (m = m0; m < m1; m++) {
+      mean[m] /= pst->gv_length;
+      vari[m] = 0.0;
+   }
    for (t = 0; t < pst->length; t++)
       if (pst->gv_switch[t])
-         *vari += (pst->par[t][m] - *mean) * (pst->par[t][m] - *mean);
-   *vari /= pst->gv_length;
+         for (m = m0; m < m1; m++) {
+            x = pst->par[t][m] - mean[m];
+            vari[m] += x * x;
+         }
+   for (m = m0; m < m1; m++)
+      vari[m] /= pst->gv_length;
 }
 
-/* HTS_PStream_conv_gv: subfunction for mlpg using GV */
-static void HTS_PStream_conv_gv(HTS_PStream * pst, size_t m)
+/* HTS_PStream_scale_gv: scale parameters of frames using GV by ratio around mean */
+static void HTS_PStream_scale_gv(HTS_PStream * pst, size_t m0, size_t m1, const double *mean, const double *ratio)
 {
-   size_t t;
-   double ratio;
-   double mean;
-   double vari;
+   size_t t, m;
 
-   HTS_PStream_calc_gv(pst, m, &mean, &vari);
-   ratio = sqrt(pst->gv_mean[m] / vari);
    for (t = 0; t < pst->length; t++)
       if (pst->gv_switch[t])
-         pst->par[t][m] = ratio * (pst->par[t][m] - mean) + mean;
+         for (m = m0; m < m1; m++)
+            pst->par[t][m] = ratio[m] * (pst->par[t][m] - mean[m]) + mean[m];
+}
+
+/* HTS_PStream_conv_gv: subfunction for mlpg using GV */
+static void HTS_PStream_conv_gv(HTS_PStream * pst, size_t m0, size_t m1, double *mean, double *ratio)
+{
+   size_t m;
+
+   HTS_PStream_calc_gv(pst, m0, m1, mean, ratio);
+   for (m = m0; m < m1; m++)
+      ratio[m] = sqrt(pst->gv_mean[m] / ratio[m]);
+   HTS_PStream_scale_gv(pst, m0, m1, mean, ratio);
 }
 
-/* HTS_PStream_calc_derivative: subfunction for mlpg using GV */
-static double HTS_PStream_calc_derivative(HTS_PStream * pst, size_t m)
+/* HTS_PStream_calc_derivative: subfunction for mlpg using GV (work holds mean, variance, derivative of variance and HMM objective of each dimension) */
+static void HTS_PStream_calc_derivative(HTS_PStream * pst, size_t m0, size_t m1, double *work, double *obj)
 {
-   size_t t, i;
-   double mean;
-   double vari;
-   double dv;
-   double h;
-   double gvobj;
-   double hmmobj;
+   const size_t vl = pst->vector_length;
+   const size_t band = pst->width * vl;
+   size_t t, i, m;
+   double *mean = work;
+   double *vari = work + vl;
+   double *dv = work + 2 * vl;
+   double *hmmobj = work + 3 * vl;
+   double *g, h, x;
+   const double *wuw, *wum, *par, *near;
    double w = 1.0 / (pst->win_size * pst->length);
 
-   HTS_PStream_calc_gv(pst, m, &mean, &vari);
-   gvobj = -0.5 * W2 * vari * pst->gv_vari[m] * (vari - 2.0 * pst->gv_mean[m]);
-   dv = -2.0 * pst->gv_vari[m] * (vari - pst->gv_mean[m]) / pst->length;
+   HTS_PStream_calc_gv(pst, m0, m1, mean, vari);
+   for (m = m0; m < m1; m++) {
+      obj[m] = -0.5 * W2 * vari[m] * pst->gv_vari[m] * (vari[m] - 2.0 * pst->gv_mean[m]);
+      dv[m] = -2.0 * pst->gv_vari[m] * (vari[m] - pst->gv_mean[m]) / pst->length;
+      hmmobj[m] = 0.0;
+   }
 
+   /* g of each frame depends on parameters only, so W'U^{-1}W*par and the gradient are computed in one pass */
    for (t = 0; t < pst->length; t++) {
-      pst->sm.g[t] = pst->sm.wuw[t][0] * pst->par[t][m];
+      g = &pst->sm.g[t * vl];
+      wuw = &pst->sm.wuw[t * band];
+      wum = &pst->sm.wum[t * vl];
+      par = pst->par[t];
+      for (m = m0; m < m1; m++)
+         g[m] = wuw[m] * par[m];
       for (i = 1; i < pst->width; i++) {
-         if (t + i < pst->length)
-            pst->sm.g[t] += pst->sm.wuw[t][i] * pst->par[t + i][m];
-         if (t + 1 > i)
-            pst->sm.g[t] += pst->sm.wuw[t - i][i] * pst->par[t - i][m];
+         if (t + i < pst->length) {
+            near = pst->par[t + i];
+            for (m = m0; m < m1; m++)
+               g[m] += wuw[i * vl + m] * near[m];
+         }
+         if (t + 1 > i) {
+            near = pst->par[t - i];
+            for (m = m0; m < m1; m++)
+               g[m] += pst->sm.wuw[(t - i) * band + i * vl + m] * near[m];
+         }
+      }
+      for (m = m0; m < m1; m++) {
+         x = par[m] - mean[m];
+         hmmobj[m] += W1 * w * par[m] * (wum[m] - 0.5 * g[m]);
+         h = -W1 * w * wuw[m] - W2 * 2.0 / (pst->length * pst->length) * ((pst->length - 1) * pst->gv_vari[m] * (vari[m] - pst->gv_mean[m]) + 2.0 * pst->gv_vari[m] * x * x);
+         if (pst->gv_switch[t])
+            g[m] = 1.0 / h * (W1 * w * (-g[m] + wum[m]) + W2 * dv[m] * x);
+         else
+            g[m] = 1.0 / h * (W1 * w * (-g[m] + wum[m]));
       }
    }
 
-   for (t = 0, hmmobj = 0.0; t < pst->length; t++) {
-      hmmobj += W1 * w * pst->par[t][m] * (pst->sm.wum[t] - 0.5 * pst->sm.g[t]);
-      h = -W1 * w * pst->sm.wuw[t][1 - 1] - W2 * 2.0 / (pst->length * pst->length) * ((pst->length - 1) * pst->gv_vari[m] * (vari - pst->gv_mean[m]) + 2.0 * pst->gv_vari[m] * (pst->par[t][m] - mean) * (pst->par[t][m] - mean));
-      if (pst->gv_switch[t])
-         pst->sm.g[t] = 1.0 / h * (W1 * w * (-pst->sm.g[t] + pst->sm.wum[t]) + W2 * dv * (pst->par[t][m] - mean));
-      else
-         pst->sm.g[t] = 1.0 / h * (W1 * w * (-pst->sm.g[t] + pst->sm.wum[t]));
-   }
-
-   return (-(hmmobj + gvobj));
+   for (m = m0; m < m1; m++)
+      obj[m] = -(hmmobj[m] + obj[m]);
 }
 
-/* HTS_PStream_gv_parmgen: function for mlpg using GV */
-static void HTS_PStream_gv_parmgen(HTS_PStream * pst, size_t m)
+/* HTS_PStream_gv_parmgen: function for mlpg using GV (step size is adapted for each dimension, and a dimension stops when relative change of its objective is within gv_tolerance) */
+static void HTS_PStream_gv_parmgen(HTS_PStream * pst, size_t m0, size_t m1)
 {
-   size_t t, i;
-   double step = STEPINIT;
-   double prev = 0.0;
-   double obj;
+   const size_t vl = pst->vector_length;
+   size_t t, i, m, lo, hi, end;
+   double *work, *step, *prev, *obj;
 
-   if (pst->gv_length == 0)
+   /* variance of less than two frames is zero (short MSD segments in a window) */
+   if (pst->gv_length < 2)
       return;
 
-   HTS_PStream_conv_gv(pst, m);
+   work = (double *) HTS_calloc(7 * vl, sizeof(double));
+   step = work + 4 * vl;
+   prev = work + 5 * vl;
+   obj = work + 6 * vl;
+
+   HTS_PStream_conv_gv(pst, m0, m1, work, work + vl);
+   for (m = m0; m < m1; m++)
+      pst->gv_iteration[m] = 0;
    if (GV_MAX_ITERATION > 0) {
-      HTS_PStream_calc_wuw_and_wum(pst, m);
-      for (i = 1; i <= GV_MAX_ITERATION; i++) {
-         obj = HTS_PStream_calc_derivative(pst, m);
+      HTS_PStream_calc_wuw_and_wum(pst, m0, m1);
+      for (m = m0; m < m1; m++) {
+         step[m] = STEPINIT;
+         prev[m] = 0.0;
+      }
+      /* converged dimensions have zero step, and lo ... hi - 1 covers the others */
+      lo = m0;
+      hi = m1;
+      for (i = 1; i <= GV_MAX_ITERATION && lo < hi; i++) {
+         /* derivative is computed for each run of consecutive dimensions not converged yet */
+         for (m = lo; m < hi; m = end) {
+            for (end = m; end < hi && step[end] != 0.0; end++);
+            if (end > m)
+               HTS_PStream_calc_derivative(pst, m, end, work, obj);
+            else
+               end++;
+         }
          if (i > 1) {
-            if (obj > prev)
-               step *= STEPDEC;
-            if (obj < prev)
-               step *= STEPINC;
+            for (m = lo; m < hi; m++) {
+               if (pst->gv_tolerance > 0.0 && fabs(obj[m] - prev[m]) <= pst->gv_tolerance * fabs(prev[m]))
+                  step[m] = 0.0;
+               if (obj[m] > prev[m])
+                  step[m] *= STEPDEC;
+               if (obj[m] < prev[m])
+                  step[m] *= STEPINC;
+            }
+            while (lo < hi && step[lo] == 0.0)
+               lo++;
+            while (lo < hi && step[hi - 1] == 0.0)
+               hi--;
          }
          for (t = 0; t < pst->length; t++) {
             if (pst->gv_switch[t])
-               pst->par[t][m] += step * pst->sm.g[t];
+               for (m = lo; m < hi; m++)
+                  pst->par[t][m] += step[m] * pst->sm.g[t * vl + m];
+         }
+         for (m = lo; m < hi; m++) {
+            if (step[m] != 0.0)
+               pst->gv_iteration[m]++;
+            prev[m] = obj[m];
          }
-         prev = obj;
       }
    }
+
+   HTS_free(work);
 }
 
-/* HTS_PStream_mlpg: generate sequence of speech parameter vector maximizing its output probability for given pdf sequence */
-static void HTS_PStream_mlpg(HTS_PStream * pst)
+/* HTS_PStream_mlpg: generate sequence of speech parameter vector maximizing its output probability for given pdf sequence (dimensions m0 ... m1 - 1 only, and GV is not used unless use_gv) */
+static void HTS_PStream_mlpg(HTS_PStream * pst, size_t m0, size_t m1, HTS_Boolean use_gv)
 {
-   size_t m;
-
    if (pst->length == 0)
       return;
 
-   for (m = 0; m < pst->vector_length; m++) {
-      HTS_PStream_calc_wuw_and_wum(pst, m);
-      HTS_PStream_ldl_factorization(pst);       /* LDL factorization */
-      HTS_PStream_forward_substitution(pst);    /* forward substitution   */
-      HTS_PStream_backward_substitution(pst, m);        /* backward substitution  */
-      if (pst->gv_length > 0)
-         HTS_PStream_gv_parmgen(pst, m);
-   }
+   /* the band structure is shared, so all dimensions in range are solved at once */
+   HTS_PStream_calc_wuw_and_wum(pst, m0, m1);
+   HTS_PStream_ldl_factorization(pst, m0, m1);  /* LDL factorization */
+   HTS_PStream_forward_substitution(pst, m0, m1);       /* forward substitution   */
+   HTS_PStream_backward_substitution(pst, m0, m1);      /* backward substitution  */
+   if (use_gv && pst->gv_length > 0)
+      HTS_PStream_gv_parmgen(pst, m0, m1);
+}
+
+/* HTS_PStreamJob: dimensions of parameter stream solved by one thread */
+typedef struct _HTS_PStreamJob {
+   HTS_PStream *pst;
+   size_t m0;                   /* first dimension */
+   size_t m1;                   /* last dimension + 1 */
+   HTS_Boolean use_gv;          /* solve GV or not */
+} HTS_PStreamJob;
+
+/* HTS_PStream_run_job: run i-th parameter generation job (called from thread pool) */
+static void HTS_PStream_run_job(void *data, size_t i)
+{
+   HTS_PStreamJob *job = (HTS_PStreamJob *) data + i;
+
+   HTS_PStream_mlpg(job->pst, job->m0, job->m1, job->use_gv);
 }
 
 /* HTS_PStreamSet_initialize: initialize parameter stream set */
@@ -269,64 +397,123 @@ void HTS_PStreamSet_initialize(HTS_PStreamSet * pss)
    pss->pstream = NULL;
    pss->nstream = 0;
    pss->total_frame = 0;
+   pss->nbuffer = 0;
+}
+
+/* HTS_PStream_free_buffers: free buffers of frames of stream */
+static void HTS_PStream_free_buffers(HTS_PStream * pst)
+{
+   if (pst->sm.wum)
+      HTS_free(pst->sm.wum);
+   if (pst->sm.g)
+      HTS_free(pst->sm.g);
+   if (pst->sm.wuw)
+      HTS_free(pst->sm.wuw);
+   if (pst->sm.ivar)
+      HTS_free_matrix(pst->sm.ivar, pst->capacity);
+   if (pst->sm.mean)
+      HTS_free_matrix(pst->sm.mean, pst->capacity);
+   if (pst->par)
+      HTS_free_matrix(pst->par, pst->capacity);
+   pst->sm.wum = NULL;
+   pst->sm.g = NULL;
+   pst->sm.wuw = NULL;
+   pst->sm.ivar = NULL;
+   pst->sm.mean = NULL;
+   pst->par = NULL;
+   pst->capacity = 0;
 }
 
 /* HTS_PStreamSet_create: parameter generation using GV weight */
-HTS_Boolean HTS_PStreamSet_create(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight)
+HTS_Boolean HTS_PStreamSet_create(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool)
+{
+   return HTS_PStreamSet_create_window(pss, sss, msd_threshold, gv_weight, gv_tolerance, pool, 0, HTS_SStreamSet_get_total_frame(sss), TRUE);
+}
+
+/* HTS_PStreamSet_create_window: parameter generation of frames first_frame ... first_frame + num_frames - 1 only (window edges are treated as utterance edges, and GV is solved in window if use_gv is TRUE) */
+HTS_Boolean HTS_PStreamSet_create_window(HTS_PStreamSet * pss, HTS_SStreamSet * sss, double *msd_threshold, double *gv_weight, double gv_tolerance, HTS_ThreadPool * pool, size_t first_frame, size_t num_frames, HTS_Boolean use_gv)
 {
    size_t i, j, k, l, m;
    int shift;
    size_t frame, msd_frame, state;
+   size_t first_state, state_frame, last_frame;
+   size_t num_threads, num_blocks, num_splits, num_jobs;
 
    HTS_PStream *pst;
+   HTS_PStreamJob *job;
    HTS_Boolean not_bound;
 
    if (pss->nstream != 0) {
       HTS_error(1, "HTS_PstreamSet_create: HTS_PStreamSet should be clear.\n");
       return FALSE;
    }
+   if (first_frame + num_frames > HTS_SStreamSet_get_total_frame(sss)) {
+      HTS_error(1, "HTS_PStreamSet_create: Window exceeds total frame.\n");
+      return FALSE;
+   }
 
-   /* initialize */
+   /* initialize (buffers kept by reset are reused if they are large enough for same streams) */
+   if (pss->pstream != NULL && pss->nbuffer != HTS_SStreamSet_get_nstream(sss))
+      HTS_PStreamSet_clear(pss);
    pss->nstream = HTS_SStreamSet_get_nstream(sss);
-   pss->pstream = (HTS_PStream *) HTS_calloc(pss->nstream, sizeof(HTS_PStream));
-   pss->total_frame = HTS_SStreamSet_get_total_frame(sss);
+   if (pss->pstream == NULL) {
+      pss->pstream = (HTS_PStream *) HTS_calloc(pss->nstream, sizeof(HTS_PStream));
+      pss->nbuffer = pss->nstream;
+   }
+   pss->total_frame = num_frames;
+
+   /* state containing first frame of window, and first frame of that state (loops below walk states of window only) */
+   last_frame = first_frame + num_frames;
+   for (first_state = 0, state_frame = 0; first_state < HTS_SStreamSet_get_total_state(sss); first_state++) {
+      if (state_frame + HTS_SStreamSet_get_duration(sss, first_state) > first_frame)
+         break;
+      state_frame += HTS_SStreamSet_get_duration(sss, first_state);
+   }
 
-   /* create */
+   /* create (frame counts frames of utterance, and frame - first_frame is index in window) */
    for (i = 0; i < pss->nstream; i++) {
       pst = &pss->pstream[i];
+      if (pst->vector_length != HTS_SStreamSet_get_vector_length(sss, i) || pst->width != HTS_SStreamSet_get_window_max_width(sss, i) * 2 + 1 || pst->win_size != HTS_SStreamSet_get_window_size(sss, i))
+         HTS_PStream_free_buffers(pst);
+      pst->vector_length = HTS_SStreamSet_get_vector_length(sss, i);
+      pst->width = HTS_SStreamSet_get_window_max_width(sss, i) * 2 + 1; /* band width of R */
+      pst->win_size = HTS_SStreamSet_get_window_size(sss, i);
       if (HTS_SStreamSet_is_msd(sss, i) == TRUE) {      /* for MSD */
          pst->length = 0;
-         for (state = 0; state < HTS_SStreamSet_get_total_state(sss); state++)
-            if (HTS_SStreamSet_get_msd(sss, i, state) > msd_threshold[i])
-               pst->length += HTS_SStreamSet_get_duration(sss, state);
-         pst->msd_flag = (HTS_Boolean *) HTS_calloc(pss->total_frame, sizeof(HTS_Boolean));
-         for (state = 0, frame = 0; state < HTS_SStreamSet_get_total_state(sss); state++) {
-            if (HTS_SStreamSet_get_msd(sss, i, state) > msd_threshold[i]) {
-               for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++) {
-                  pst->msd_flag[frame] = TRUE;
-                  frame++;
-               }
-            } else {
-               for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++) {
-                  pst->msd_flag[frame] = FALSE;
-                  frame++;
+         if (pst->msd_capacity < pss->total_frame) {
+            if (pst->msd_flag)
+               HTS_free(pst->msd_flag);
+            pst->msd_flag = (HTS_Boolean *) HTS_calloc(pss->total_frame, sizeof(HTS_Boolean));
+            pst->msd_capacity = pss->total_frame;
+         }
+         for (state = first_state, frame = state_frame; state < HTS_SStreamSet_get_total_state(sss) && frame < last_frame; state++) {
+            for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++, frame++) {
+               if (frame < first_frame || frame >= last_frame)
+                  continue;
+               if (HTS_SStreamSet_get_msd(sss, i, state) > msd_threshold[i]) {
+                  pst->msd_flag[frame - first_frame] = TRUE;
+                  pst->length++;
+               } else {
+                  pst->msd_flag[frame - first_frame] = FALSE;
                }
             }
          }
       } else {                  /* for non MSD */
          pst->length = pss->total_frame;
+         if (pst->msd_flag)
+            HTS_free(pst->msd_flag);
          pst->msd_flag = NULL;
+         pst->msd_capacity = 0;
       }
-      pst->vector_length = HTS_SStreamSet_get_vector_length(sss, i);
-      pst->width = HTS_SStreamSet_get_window_max_width(sss, i) * 2 + 1; /* band width of R */
-      pst->win_size = HTS_SStreamSet_get_window_size(sss, i);
-      if (pst->length > 0) {
+      if (pst->length > pst->capacity) {
+         HTS_PStream_free_buffers(pst);
          pst->sm.mean = HTS_alloc_matrix(pst->length, pst->vector_length * pst->win_size);
          pst->sm.ivar = HTS_alloc_matrix(pst->length, pst->vector_length * pst->win_size);
-         pst->sm.wum = (double *) HTS_calloc(pst->length, sizeof(double));
-         pst->sm.wuw = HTS_alloc_matrix(pst->length, pst->width);
-         pst->sm.g = (double *) HTS_calloc(pst->length, sizeof(double));
+         pst->sm.wum = (double *) HTS_calloc(pst->length * pst->vector_length, sizeof(double));
+         pst->sm.wuw = (double *) HTS_calloc(pst->length * pst->width * pst->vector_length, sizeof(double));
+         pst->sm.g = (double *) HTS_calloc(pst->length * pst->vector_length, sizeof(double));
          pst->par = HTS_alloc_matrix(pst->length, pst->vector_length);
+         pst->capacity = pst->length;
       }
       /* copy dynamic window */
       pst->win_l_width = (int *) HTS_calloc(pst->win_size, sizeof(int));
@@ -354,82 +541,162 @@ HTS_Boolean HTS_PStreamSet_create(HTS_PStreamSet * pss, HTS_SStreamSet * sss, do
             pst->gv_vari[j] = HTS_SStreamSet_get_gv_vari(sss, i, j);
          }
          pst->gv_switch = (HTS_Boolean *) HTS_calloc(pst->length, sizeof(HTS_Boolean));
-         if (HTS_SStreamSet_is_msd(sss, i) == TRUE) {   /* for MSD */
-            for (state = 0, frame = 0, msd_frame = 0; state < HTS_SStreamSet_get_total_state(sss); state++)
-               for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++, frame++)
-                  if (pst->msd_flag[frame] == TRUE)
-                     pst->gv_switch[msd_frame++] = HTS_SStreamSet_get_gv_switch(sss, i, state);
-         } else {               /* for non MSD */
-            for (state = 0, frame = 0; state < HTS_SStreamSet_get_total_state(sss); state++)
-               for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++)
-                  pst->gv_switch[frame++] = HTS_SStreamSet_get_gv_switch(sss, i, state);
-         }
+         for (state = first_state, frame = state_frame, msd_frame = 0; state < HTS_SStreamSet_get_total_state(sss) && frame < last_frame; state++)
+            for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++, frame++)
+               if (frame >= first_frame && frame < last_frame && (pst->msd_flag == NULL || pst->msd_flag[frame - first_frame] == TRUE))
+                  pst->gv_switch[msd_frame++] = HTS_SStreamSet_get_gv_switch(sss, i, state);
          for (j = 0, pst->gv_length = 0; j < pst->length; j++)
             if (pst->gv_switch[j])
                pst->gv_length++;
+         pst->gv_iteration = (size_t *) HTS_calloc(pst->vector_length, sizeof(size_t));
       } else {
          pst->gv_switch = NULL;
          pst->gv_length = 0;
          pst->gv_mean = NULL;
          pst->gv_vari = NULL;
+         pst->gv_iteration = NULL;
       }
-      /* copy pdfs */
-      if (HTS_SStreamSet_is_msd(sss, i) == TRUE) {      /* for MSD */
-         for (state = 0, frame = 0, msd_frame = 0; state < HTS_SStreamSet_get_total_state(sss); state++) {
-            for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++) {
-               if (pst->msd_flag[frame] == TRUE) {
-                  /* check current frame is MSD boundary or not */
-                  for (k = 0; k < pst->win_size; k++) {
-                     not_bound = TRUE;
-                     for (shift = pst->win_l_width[k]; shift <= pst->win_r_width[k]; shift++)
-                        if ((int) frame + shift < 0 || (int) pss->total_frame <= (int) frame + shift || pst->msd_flag[frame + shift] != TRUE) {
-                           not_bound = FALSE;
-                           break;
-                        }
-                     for (l = 0; l < pst->vector_length; l++) {
-                        m = pst->vector_length * k + l;
-                        pst->sm.mean[msd_frame][m] = HTS_SStreamSet_get_mean(sss, i, state, m);
-                        if (not_bound || k == 0)
-                           pst->sm.ivar[msd_frame][m] = HTS_finv(HTS_SStreamSet_get_vari(sss, i, state, m));
-                        else
-                           pst->sm.ivar[msd_frame][m] = 0.0;
-                     }
+      pst->gv_tolerance = gv_tolerance;
+      /* copy pdfs (msd_frame counts frames of stream in window) */
+      for (state = first_state, frame = state_frame, msd_frame = 0; state < HTS_SStreamSet_get_total_state(sss) && frame < last_frame; state++) {
+         for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++, frame++) {
+            if (frame < first_frame || frame >= last_frame)
+               continue;
+            if (pst->msd_flag != NULL && pst->msd_flag[frame - first_frame] != TRUE)
+               continue;
+            /* check current frame is MSD boundary or not */
+            for (k = 0; k < pst->win_size; k++) {
+               not_bound = TRUE;
+               for (shift = pst->win_l_width[k]; shift <= pst->win_r_width[k]; shift++)
+                  if ((int) (frame - first_frame) + shift < 0 || (int) pss->total_frame <= (int) (frame - first_frame) + shift || (pst->msd_flag != NULL && pst->msd_flag[frame - first_frame + shift] != TRUE)) {
+                     not_bound = FALSE;
+                     break;
                   }
-                  msd_frame++;
+               for (l = 0; l < pst->vector_length; l++) {
+                  m = pst->vector_length * k + l;
+                  pst->sm.mean[msd_frame][m] = HTS_SStreamSet_get_mean(sss, i, state, m);
+                  if (not_bound || k == 0)
+                     pst->sm.ivar[msd_frame][m] = HTS_finv(HTS_SStreamSet_get_vari(sss, i, state, m));
+                  else
+                     pst->sm.ivar[msd_frame][m] = 0.0;
                }
-               frame++;
             }
+            msd_frame++;
          }
-      } else {                  /* for non MSD */
-         for (state = 0, frame = 0; state < HTS_SStreamSet_get_total_state(sss); state++) {
-            for (j = 0; j < HTS_SStreamSet_get_duration(sss, state); j++) {
-               for (k = 0; k < pst->win_size; k++) {
-                  not_bound = TRUE;
-                  for (shift = pst->win_l_width[k]; shift <= pst->win_r_width[k]; shift++)
-                     if ((int) frame + shift < 0 || (int) pss->total_frame <= (int) frame + shift) {
-                        not_bound = FALSE;
-                        break;
-                     }
-                  for (l = 0; l < pst->vector_length; l++) {
-                     m = pst->vector_length * k + l;
-                     pst->sm.mean[frame][m] = HTS_SStreamSet_get_mean(sss, i, state, m);
-                     if (not_bound || k == 0)
-                        pst->sm.ivar[frame][m] = HTS_finv(HTS_SStreamSet_get_vari(sss, i, state, m));
-                     else
-                        pst->sm.ivar[frame][m] = 0.0;
-                  }
-               }
-               frame++;
-            }
+      }
+   }
+
+   /* parameter generation (dimensions are independent, so each stream is split into ranges of dimensions; streams shorter than JOB_MIN_DIMENSION such as lf0 are one job each, run alongside the others) */
+   num_threads = HTS_ThreadPool_get_num_threads(pool);
+   for (i = 0, num_jobs = 0; i < pss->nstream; i++) {
+      pst = &pss->pstream[i];
+      if (pst->length > 0) {
+         num_blocks = (pst->vector_length + JOB_MIN_DIMENSION - 1) / JOB_MIN_DIMENSION;
+         num_jobs += num_blocks < num_threads ? num_blocks : num_threads;
+      }
+   }
+   if (num_jobs > 0) {
+      job = (HTS_PStreamJob *) HTS_calloc(num_jobs, sizeof(HTS_PStreamJob));
+      for (i = 0, num_jobs = 0; i < pss->nstream; i++) {
+         pst = &pss->pstream[i];
+         if (pst->length == 0)
+            continue;
+         num_blocks = (pst->vector_length + JOB_MIN_DIMENSION - 1) / JOB_MIN_DIMENSION;
+         num_splits = num_blocks < num_threads ? num_blocks : num_threads;
+         for (j = 0; j < num_splits; j++, num_jobs++) {
+            job[num_jobs].pst = pst;
+            job[num_jobs].m0 = num_blocks * j / num_splits * JOB_MIN_DIMENSION;
+            job[num_jobs].m1 = num_blocks * (j + 1) / num_splits * JOB_MIN_DIMENSION;
+            if (job[num_jobs].m1 > pst->vector_length)
+               job[num_jobs].m1 = pst->vector_length;
+            job[num_jobs].use_gv = use_gv;
          }
       }
-      /* parameter generation */
-      HTS_PStream_mlpg(pst);
+      HTS_ThreadPool_run(pool, HTS_PStream_run_job, job, num_jobs);
+      HTS_free(job);
    }
 
    return TRUE;
 }
 
+/* HTS_PStreamSet_get_gv_scaling: get mean and ratio to scale parameters of stream generated without GV so that their variance matches GV (mean and variance are taken from static means of states weighted by durations, and no parameter is generated) */
+HTS_Boolean HTS_PStreamSet_get_gv_scaling(HTS_SStreamSet * sss, size_t stream_index, double msd_threshold, double gv_weight, double *mean, double *ratio)
+{
+   size_t state, m;
+   size_t vector_length = HTS_SStreamSet_get_vector_length(sss, stream_index);
+   size_t duration, gv_length = 0;
+   double x;
+
+   if (!HTS_SStreamSet_use_gv(sss, stream_index))
+      return FALSE;
+   for (m = 0; m < vector_length; m++) {
+      mean[m] = 0.0;
+      ratio[m] = 0.0;
+   }
+   for (state = 0; state < HTS_SStreamSet_get_total_state(sss); state++) {
+      if (HTS_SStreamSet_get_gv_switch(sss, stream_index, state) != TRUE)
+         continue;
+      if (HTS_SStreamSet_is_msd(sss, stream_index) == TRUE && HTS_SStreamSet_get_msd(sss, stream_index, state) <= msd_threshold)
+         continue;
+      duration = HTS_SStreamSet_get_duration(sss, state);
+      for (m = 0; m < vector_length; m++)
+         mean[m] += duration * HTS_SStreamSet_get_mean(sss, stream_index, state, m);
+      gv_length += duration;
+   }
+   /* variance of less than two frames is zero */
+   if (gv_length < 2)
+      return FALSE;
+   for (m = 0; m < vector_length; m++)
+      mean[m] /= gv_length;
+   for (state = 0; state < HTS_SStreamSet_get_total_state(sss); state++) {
+      if (HTS_SStreamSet_get_gv_switch(sss, stream_index, state) != TRUE)
+         continue;
+      if (HTS_SStreamSet_is_msd(sss, stream_index) == TRUE && HTS_SStreamSet_get_msd(sss, stream_index, state) <= msd_threshold)
+         continue;
+      duration = HTS_SStreamSet_get_duration(sss, state);
+      for (m = 0; m < vector_length; m++) {
+         x = HTS_SStreamSet_get_mean(sss, stream_index, state, m) - mean[m];
+         ratio[m] += duration * x * x;
+      }
+   }
+   /* dimension whose static means do not vary is not scaled */
+   for (m = 0; m < vector_length; m++)
+      ratio[m] = ratio[m] > 0.0 ? sqrt(HTS_SStreamSet_get_gv_mean(sss, stream_index, m) * gv_weight * gv_length / ratio[m]) : 1.0;
+   return TRUE;
+}
+
+/* HTS_PStreamSet_accumulate_gv: accumulate squared deviations from mean of parameters and of static means of their states over frames of window from first_frame */
+void HTS_PStreamSet_accumulate_gv(HTS_PStreamSet * pss, size_t stream_index, size_t first_frame, const double *mean, double *par_sum, double *state_sum)
+{
+   HTS_PStream *pst = &pss->pstream[stream_index];
+   size_t t, m, msd_frame;
+   double x;
+
+   if (pst->gv_switch == NULL)
+      return;
+   for (t = 0, msd_frame = 0; t < pss->total_frame; t++) {
+      if (pst->msd_flag != NULL && pst->msd_flag[t] != TRUE)
+         continue;
+      if (t >= first_frame && pst->gv_switch[msd_frame])
+         for (m = 0; m < pst->vector_length; m++) {
+            x = pst->par[msd_frame][m] - mean[m];
+            par_sum[m] += x * x;
+            x = pst->sm.mean[msd_frame][m] - mean[m];
+            state_sum[m] += x * x;
+         }
+      msd_frame++;
+   }
+}
+
+/* HTS_PStreamSet_scale_gv: scale parameters of stream using GV by ratio around mean */
+void HTS_PStreamSet_scale_gv(HTS_PStreamSet * pss, size_t stream_index, const double *mean, const double *ratio)
+{
+   HTS_PStream *pst = &pss->pstream[stream_index];
+
+   if (pst->gv_length > 0)
+      HTS_PStream_scale_gv(pst, 0, pst->vector_length, mean, ratio);
+}
+
 /* HTS_PStreamSet_get_nstream: get number of stream */
 size_t HTS_PStreamSet_get_nstream(HTS_PStreamSet * pss)
 {
@@ -472,47 +739,65 @@ HTS_Boolean HTS_PStreamSet_is_msd(HTS_PStreamSet * pss, size_t stream_index)
    return pss->pstream[stream_index].msd_flag ? TRUE : FALSE;
 }
 
-/* HTS_PStreamSet_clear: free parameter stream set */
-void HTS_PStreamSet_clear(HTS_PStreamSet * pss)
+/* HTS_PStreamSet_get_gv_iteration: get number of GV iterations used for dimension of stream */
+size_t HTS_PStreamSet_get_gv_iteration(HTS_PStreamSet * pss, size_t stream_index, size_t vector_index)
+{
+   if (pss->pstream[stream_index].gv_iteration == NULL)
+      return 0;
+   return pss->pstream[stream_index].gv_iteration[vector_index];
+}
+
+/* HTS_PStreamSet_reset: free parameter stream set for next utterance, keeping buffers of frames */
+void HTS_PStreamSet_reset(HTS_PStreamSet * pss)
 {
    size_t i, j;
    HTS_PStream *pstream;
 
-   if (pss->pstream) {
-      for (i = 0; i < pss->nstream; i++) {
-         pstream = &pss->pstream[i];
-         if (pstream->sm.wum)
-            HTS_free(pstream->sm.wum);
-         if (pstream->sm.g)
-            HTS_free(pstream->sm.g);
-         if (pstream->sm.wuw)
-            HTS_free_matrix(pstream->sm.wuw, pstream->length);
-         if (pstream->sm.ivar)
-            HTS_free_matrix(pstream->sm.ivar, pstream->length);
-         if (pstream->sm.mean)
-            HTS_free_matrix(pstream->sm.mean, pstream->length);
-         if (pstream->par)
-            HTS_free_matrix(pstream->par, pstream->length);
-         if (pstream->msd_flag)
-            HTS_free(pstream->msd_flag);
-         if (pstream->win_coefficient) {
-            for (j = 0; j < pstream->win_size; j++) {
-               pstream->win_coefficient[j] += pstream->win_l_width[j];
-               HTS_free(pstream->win_coefficient[j]);
-            }
+   for (i = 0; i < pss->nbuffer; i++) {
+      pstream = &pss->pstream[i];
+      if (pstream->win_coefficient) {
+         for (j = 0; j < pstream->win_size; j++) {
+            pstream->win_coefficient[j] += pstream->win_l_width[j];
+            HTS_free(pstream->win_coefficient[j]);
          }
-         if (pstream->gv_mean)
-            HTS_free(pstream->gv_mean);
-         if (pstream->gv_vari)
-            HTS_free(pstream->gv_vari);
-         if (pstream->win_coefficient)
-            HTS_free(pstream->win_coefficient);
-         if (pstream->win_l_width)
-            HTS_free(pstream->win_l_width);
-         if (pstream->win_r_width)
-            HTS_free(pstream->win_r_width);
-         if (pstream->gv_switch)
-            HTS_free(pstream->gv_switch);
+         HTS_free(pstream->win_coefficient);
+      }
+      if (pstream->gv_mean)
+         HTS_free(pstream->gv_mean);
+      if (pstream->gv_vari)
+         HTS_free(pstream->gv_vari);
+      if (pstream->win_l_width)
+         HTS_free(pstream->win_l_width);
+      if (pstream->win_r_width)
+         HTS_free(pstream->win_r_width);
+      if (pstream->gv_switch)
+         HTS_free(pstream->gv_switch);
+      if (pstream->gv_iteration)
+         HTS_free(pstream->gv_iteration);
+      pstream->win_coefficient = NULL;
+      pstream->gv_mean = NULL;
+      pstream->gv_vari = NULL;
+      pstream->win_l_width = NULL;
+      pstream->win_r_width = NULL;
+      pstream->gv_switch = NULL;
+      pstream->gv_iteration = NULL;
+      pstream->length = 0;
+   }
+   pss->nstream = 0;
+   pss->total_frame = 0;
+}
+
+/* HTS_PStreamSet_clear: free parameter stream set */
+void HTS_PStreamSet_clear(HTS_PStreamSet * pss)
+{
+   size_t i;
+
+   HTS_PStreamSet_reset(pss);
+   if (pss->pstream) {
+      for (i = 0; i < pss->nbuffer; i++) {
+         HTS_PStream_free_buffers(&pss->pstream[i]);
+         if (pss->pstream[i].msd_flag)
+            HTS_free(pss->pstream[i].msd_flag);
       }
       HTS_free(pss->pstream);
    }
@@ -57,6 +57,7 @@ HTS_SSTREAM_C_START;
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>             /* for memset() */
 
 /* hts_engine libraries */
 #include "HTS_hidden.h"
@@ -166,10 +167,89 @@ void HTS_SStreamSet_initialize(HTS_SStreamSet * sss)
    sss->duration = NULL;
    sss->total_state = 0;
    sss->total_frame = 0;
+   sss->total_question = 0;
+   sss->capacity = 0;
+}
+
+/* HTS_SStreamSet_free_buffers: free buffers of states */
+static void HTS_SStreamSet_free_buffers(HTS_SStreamSet * sss)
+{
+   size_t i, j;
+   HTS_SStream *sst;
+
+   if (sss->sstream) {
+      for (i = 0; i < sss->nstream; i++) {
+         sst = &sss->sstream[i];
+         for (j = 0; j < sss->capacity; j++) {
+            HTS_free(sst->mean[j]);
+            HTS_free(sst->vari[j]);
+         }
+         if (sst->msd)
+            HTS_free(sst->msd);
+         HTS_free(sst->mean);
+         HTS_free(sst->vari);
+         if (sst->gv_switch)
+            HTS_free(sst->gv_switch);
+      }
+      HTS_free(sss->sstream);
+      sss->sstream = NULL;
+   }
+   if (sss->duration) {
+      HTS_free(sss->duration);
+      sss->duration = NULL;
+   }
+   sss->capacity = 0;
+}
+
+/* HTS_SStreamSet_alloc_buffers: allocate buffers of states for model set (buffers kept by reset are reused if they are large enough for same model set) */
+static void HTS_SStreamSet_alloc_buffers(HTS_SStreamSet * sss, HTS_ModelSet * ms, size_t total_state)
+{
+   size_t i, j;
+   HTS_SStream *sst;
+
+   if (sss->sstream != NULL) {
+      if (sss->capacity >= total_state && sss->nstream == HTS_ModelSet_get_nstream(ms)) {
+         for (i = 0; i < sss->nstream; i++) {
+            sst = &sss->sstream[i];
+            if (sst->vector_length != HTS_ModelSet_get_vector_length(ms, i) || sst->win_size != HTS_ModelSet_get_window_size(ms, i)
+                || (sst->msd != NULL) != (HTS_ModelSet_is_msd(ms, i) == TRUE) || (sst->gv_switch != NULL) != (HTS_ModelSet_use_gv(ms, i) == TRUE))
+               break;
+         }
+         if (i == sss->nstream) {
+            memset(sss->duration, 0, total_state * sizeof(size_t));
+            return;
+         }
+      }
+      HTS_SStreamSet_free_buffers(sss);
+   }
+
+   sss->nstream = HTS_ModelSet_get_nstream(ms);
+   sss->capacity = total_state;
+   sss->duration = (size_t *) HTS_calloc(total_state, sizeof(size_t));
+   sss->sstream = (HTS_SStream *) HTS_calloc(sss->nstream, sizeof(HTS_SStream));
+   for (i = 0; i < sss->nstream; i++) {
+      sst = &sss->sstream[i];
+      sst->vector_length = HTS_ModelSet_get_vector_length(ms, i);
+      sst->win_size = HTS_ModelSet_get_window_size(ms, i);
+      sst->mean = (double **) HTS_calloc(total_state, sizeof(double *));
+      sst->vari = (double **) HTS_calloc(total_state, sizeof(double *));
+      if (HTS_ModelSet_is_msd(ms, i))
+         sst->msd = (double *) HTS_calloc(total_state, sizeof(double));
+      else
+         sst->msd = NULL;
+      for (j = 0; j < total_state; j++) {
+         sst->mean[j] = (double *) HTS_calloc(sst->vector_length * sst->win_size, sizeof(double));
+         sst->vari[j] = (double *) HTS_calloc(sst->vector_length * sst->win_size, sizeof(double));
+      }
+      if (HTS_ModelSet_use_gv(ms, i))
+         sst->gv_switch = (HTS_Boolean *) HTS_calloc(total_state, sizeof(HTS_Boolean));
+      else
+         sst->gv_switch = NULL;
+   }
 }
 
 /* HTS_SStreamSet_create: parse label and determine state duration */
-HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_Label * label, HTS_Boolean phoneme_alignment_flag, double speed, double *duration_iw, double **parameter_iw, double **gv_iw)
+HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_PdfCache * cache, HTS_Label * label, HTS_Boolean phoneme_alignment_flag, double speed, double *duration_iw, double **parameter_iw, double **gv_iw)
 {
    size_t i, j, k;
    double temp;
@@ -180,6 +260,7 @@ HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_L
    double frame_length;
    size_t next_time;
    size_t next_state;
+   HTS_Context *context;
 
    if (HTS_Label_get_size(label) == 0)
       return FALSE;
@@ -219,38 +300,29 @@ HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_L
 
    /* initialize state sequence */
    sss->nstate = HTS_ModelSet_get_nstate(ms);
-   sss->nstream = HTS_ModelSet_get_nstream(ms);
    sss->total_frame = 0;
+   sss->total_question = 0;
    sss->total_state = HTS_Label_get_size(label) * sss->nstate;
-   sss->duration = (size_t *) HTS_calloc(sss->total_state, sizeof(size_t));
-   sss->sstream = (HTS_SStream *) HTS_calloc(sss->nstream, sizeof(HTS_SStream));
+   HTS_SStreamSet_alloc_buffers(sss, ms, sss->total_state);
    for (i = 0; i < sss->nstream; i++) {
       sst = &sss->sstream[i];
-      sst->vector_length = HTS_ModelSet_get_vector_length(ms, i);
-      sst->mean = (double **) HTS_calloc(sss->total_state, sizeof(double *));
-      sst->vari = (double **) HTS_calloc(sss->total_state, sizeof(double *));
-      if (HTS_ModelSet_is_msd(ms, i))
-         sst->msd = (double *) HTS_calloc(sss->total_state, sizeof(double));
-      else
-         sst->msd = NULL;
-      for (j = 0; j < sss->total_state; j++) {
-         sst->mean[j] = (double *) HTS_calloc(sst->vector_length * HTS_ModelSet_get_window_size(ms, i), sizeof(double));
-         sst->vari[j] = (double *) HTS_calloc(sst->vector_length * HTS_ModelSet_get_window_size(ms, i), sizeof(double));
-      }
-      if (HTS_ModelSet_use_gv(ms, i)) {
-         sst->gv_switch = (HTS_Boolean *) HTS_calloc(sss->total_state, sizeof(HTS_Boolean));
+      if (sst->gv_switch != NULL)
          for (j = 0; j < sss->total_state; j++)
             sst->gv_switch[j] = TRUE;
-      } else {
-         sst->gv_switch = NULL;
-      }
+   }
+
+   /* split labels into fields once for all models (or find their PDFs in cache) */
+   context = (HTS_Context *) HTS_calloc(HTS_Label_get_size(label), sizeof(HTS_Context));
+   for (i = 0; i < HTS_Label_get_size(label); i++) {
+      HTS_Context_initialize(&context[i]);
+      HTS_PdfCache_set_context(cache, ms, &context[i], HTS_Label_get_string(label, i), &sss->total_question);
    }
 
    /* determine state duration */
    duration_mean = (double *) HTS_calloc(sss->total_state, sizeof(double));
    duration_vari = (double *) HTS_calloc(sss->total_state, sizeof(double));
    for (i = 0; i < HTS_Label_get_size(label); i++)
-      HTS_ModelSet_get_duration(ms, HTS_Label_get_string(label, i), duration_iw, &duration_mean[i * sss->nstate], &duration_vari[i * sss->nstate]);
+      HTS_ModelSet_get_duration(ms, &context[i], duration_iw, &duration_mean[i * sss->nstate], &duration_vari[i * sss->nstate], &sss->total_question);
    if (phoneme_alignment_flag == TRUE) {
       /* use duration set by user */
       next_time = 0;
@@ -290,9 +362,9 @@ HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_L
          for (k = 0; k < sss->nstream; k++) {
             sst = &sss->sstream[k];
             if (sst->msd)
-               HTS_ModelSet_get_parameter(ms, k, j, HTS_Label_get_string(label, i), (const double *const *) parameter_iw, sst->mean[state], sst->vari[state], &sst->msd[state]);
+               HTS_ModelSet_get_parameter(ms, k, j, &context[i], (const double *const *) parameter_iw, sst->mean[state], sst->vari[state], &sst->msd[state], &sss->total_question);
             else
-               HTS_ModelSet_get_parameter(ms, k, j, HTS_Label_get_string(label, i), (const double *const *) parameter_iw, sst->mean[state], sst->vari[state], NULL);
+               HTS_ModelSet_get_parameter(ms, k, j, &context[i], (const double *const *) parameter_iw, sst->mean[state], sst->vari[state], NULL, &sss->total_question);
          }
          state++;
       }
@@ -325,7 +397,7 @@ HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_L
       if (HTS_ModelSet_use_gv(ms, i)) {
          sst->gv_mean = (double *) HTS_calloc(sst->vector_length, sizeof(double));
          sst->gv_vari = (double *) HTS_calloc(sst->vector_length, sizeof(double));
-         HTS_ModelSet_get_gv(ms, i, HTS_Label_get_string(label, 0), (const double *const *) gv_iw, sst->gv_mean, sst->gv_vari);
+         HTS_ModelSet_get_gv(ms, i, &context[0], (const double *const *) gv_iw, sst->gv_mean, sst->gv_vari, &sss->total_question);
       } else {
          sst->gv_mean = NULL;
          sst->gv_vari = NULL;
@@ -333,12 +405,16 @@ HTS_Boolean HTS_SStreamSet_create(HTS_SStreamSet * sss, HTS_ModelSet * ms, HTS_L
    }
 
    for (i = 0; i < HTS_Label_get_size(label); i++)
-      if (HTS_ModelSet_get_gv_flag(ms, HTS_Label_get_string(label, i)) == FALSE)
+      if (HTS_ModelSet_get_gv_flag(ms, &context[i], &sss->total_question) == FALSE)
          for (j = 0; j < sss->nstream; j++)
             if (HTS_ModelSet_use_gv(ms, j) == TRUE)
                for (k = 0; k < sss->nstate; k++)
                   sss->sstream[j].gv_switch[i * sss->nstate + k] = FALSE;
 
+   for (i = 0; i < HTS_Label_get_size(label); i++)
+      HTS_Context_clear(&context[i]);
+   HTS_free(context);
+
    return TRUE;
 }
 
@@ -372,6 +448,12 @@ size_t HTS_SStreamSet_get_total_frame(HTS_SStreamSet * sss)
    return sss->total_frame;
 }
 
+/* HTS_SStreamSet_get_total_question: get total number of evaluated questions */
+size_t HTS_SStreamSet_get_total_question(HTS_SStreamSet * sss)
+{
+   return sss->total_question;
+}
+
 /* HTS_SStreamSet_get_msd: get MSD parameter */
 double HTS_SStreamSet_get_msd(HTS_SStreamSet * sss, size_t stream_index, size_t state_index)
 {
@@ -468,8 +550,8 @@ HTS_Boolean HTS_SStreamSet_get_gv_switch(HTS_SStreamSet * sss, size_t stream_ind
    return sss->sstream[stream_index].gv_switch[state_index];
 }
 
-/* HTS_SStreamSet_clear: free state stream set */
-void HTS_SStreamSet_clear(HTS_SStreamSet * sss)
+/* HTS_SStreamSet_reset: free state stream set for next utterance, keeping buffers of states */
+void HTS_SStreamSet_reset(HTS_SStreamSet * sss)
 {
    size_t i, j;
    HTS_SStream *sst;
@@ -477,33 +559,38 @@ void HTS_SStreamSet_clear(HTS_SStreamSet * sss)
    if (sss->sstream) {
       for (i = 0; i < sss->nstream; i++) {
          sst = &sss->sstream[i];
-         for (j = 0; j < sss->total_state; j++) {
-            HTS_free(sst->mean[j]);
-            HTS_free(sst->vari[j]);
-         }
-         if (sst->msd)
-            HTS_free(sst->msd);
-         HTS_free(sst->mean);
-         HTS_free(sst->vari);
-         for (j = 0; j < sst->win_size; j++) {
-            sst->win_coefficient[j] += sst->win_l_width[j];
-            HTS_free(sst->win_coefficient[j]);
+         if (sst->win_coefficient) {
+            for (j = 0; j < sst->win_size; j++) {
+               sst->win_coefficient[j] += sst->win_l_width[j];
+               HTS_free(sst->win_coefficient[j]);
+            }
+            HTS_free(sst->win_coefficient);
+            HTS_free(sst->win_l_width);
+            HTS_free(sst->win_r_width);
+            sst->win_coefficient = NULL;
+            sst->win_l_width = NULL;
+            sst->win_r_width = NULL;
          }
-         HTS_free(sst->win_coefficient);
-         HTS_free(sst->win_l_width);
-         HTS_free(sst->win_r_width);
-         if (sst->gv_mean)
+         if (sst->gv_mean) {
             HTS_free(sst->gv_mean);
-         if (sst->gv_vari)
+            sst->gv_mean = NULL;
+         }
+         if (sst->gv_vari) {
             HTS_free(sst->gv_vari);
-         if (sst->gv_switch)
-            HTS_free(sst->gv_switch);
+            sst->gv_vari = NULL;
+         }
       }
-      HTS_free(sss->sstream);
    }
-   if (sss->duration)
-      HTS_free(sss->duration);
+   sss->total_state = 0;
+   sss->total_frame = 0;
+   sss->total_question = 0;
+}
 
+/* HTS_SStreamSet_clear: free state stream set */
+void HTS_SStreamSet_clear(HTS_SStreamSet * sss)
+{
+   HTS_SStreamSet_reset(sss);
+   HTS_SStreamSet_free_buffers(sss);
    HTS_SStreamSet_initialize(sss);
 }
 
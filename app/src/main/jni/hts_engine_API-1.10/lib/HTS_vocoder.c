@@ -862,8 +862,44 @@ void HTS_Vocoder_initialize(HTS_Vocoder * v, size_t m, size_t stage, HTS_Boolean
    }
 }
 
-/* HTS_Vocoder_synthesize: pulse/noise excitation and MLSA/MGLSA filster based waveform synthesis */
-void HTS_Vocoder_synthesize(HTS_Vocoder * v, size_t m, double lf0, double *spectrum, size_t nlpf, double *lpf, double alpha, double beta, double volume, double *rawdata, HTS_Audio * audio)
+/* HTS_Vocoder_convert_first_frame: convert spectral parameters of first frame to filter coefficients (without postfiltering) */
+void HTS_Vocoder_convert_first_frame(HTS_Vocoder * v, size_t m, double *spectrum, double alpha, double *c)
+{
+   size_t i;
+
+   if (v->stage == 0) {         /* for MCP */
+      HTS_mc2b(spectrum, c, m, alpha);
+   } else {                     /* for LSP */
+      HTS_movem(spectrum, c, m + 1);
+      HTS_lsp2mgc(v, c, c, m, alpha);
+      HTS_mc2b(c, c, m, alpha);
+      HTS_gnorm(c, c, m, v->gamma);
+      for (i = 1; i <= m; i++)
+         c[i] *= v->gamma;
+   }
+}
+
+/* HTS_Vocoder_convert_frame: postfilter spectral parameters of frame in place and convert them to filter coefficients */
+void HTS_Vocoder_convert_frame(HTS_Vocoder * v, size_t m, double *spectrum, double alpha, double beta, double *c)
+{
+   size_t i;
+
+   if (v->stage == 0) {         /* for MCP */
+      HTS_Vocoder_postfilter_mcp(v, spectrum, m, alpha, beta);
+      HTS_mc2b(spectrum, c, m, alpha);
+   } else {                     /* for LSP */
+      HTS_Vocoder_postfilter_lsp(v, spectrum, m, alpha, beta);
+      HTS_check_lsp_stability(spectrum, m);
+      HTS_lsp2mgc(v, spectrum, c, m, alpha);
+      HTS_mc2b(c, c, m, alpha);
+      HTS_gnorm(c, c, m, v->gamma);
+      for (i = 1; i <= m; i++)
+         c[i] *= v->gamma;
+   }
+}
+
+/* HTS_Vocoder_filter: pulse/noise excitation and MLSA/MGLSA filter whose coefficients move from c0 to c1 over frame */
+void HTS_Vocoder_filter(HTS_Vocoder * v, size_t m, double lf0, double *c0, double *c1, size_t nlpf, double *lpf, double alpha, double volume, double *rawdata, HTS_Audio * audio)
 {
    double x;
    int i, j;
@@ -884,36 +920,13 @@ void HTS_Vocoder_synthesize(HTS_Vocoder * v, size_t m, double lf0, double *spect
    /* first time */
    if (v->is_first == TRUE) {
       HTS_Vocoder_initialize_excitation(v, p, nlpf);
-      if (v->stage == 0) {      /* for MCP */
-         HTS_mc2b(spectrum, v->c, m, alpha);
-      } else {                  /* for LSP */
-         HTS_movem(spectrum, v->c, m + 1);
-         HTS_lsp2mgc(v, v->c, v->c, m, alpha);
-         HTS_mc2b(v->c, v->c, m, alpha);
-         HTS_gnorm(v->c, v->c, m, v->gamma);
-         for (i = 1; i <= m; i++)
-            v->c[i] *= v->gamma;
-      }
       v->is_first = FALSE;
    }
 
    HTS_Vocoder_start_excitation(v, p);
-   if (v->stage == 0) {         /* for MCP */
-      HTS_Vocoder_postfilter_mcp(v, spectrum, m, alpha, beta);
-      HTS_mc2b(spectrum, v->cc, m, alpha);
-      for (i = 0; i <= m; i++)
-         v->cinc[i] = (v->cc[i] - v->c[i]) / v->fprd;
-   } else {                     /* for LSP */
-      HTS_Vocoder_postfilter_lsp(v, spectrum, m, alpha, beta);
-      HTS_check_lsp_stability(spectrum, m);
-      HTS_lsp2mgc(v, spectrum, v->cc, m, alpha);
-      HTS_mc2b(v->cc, v->cc, m, alpha);
-      HTS_gnorm(v->cc, v->cc, m, v->gamma);
-      for (i = 1; i <= m; i++)
-         v->cc[i] *= v->gamma;
-      for (i = 0; i <= m; i++)
-         v->cinc[i] = (v->cc[i] - v->c[i]) / v->fprd;
-   }
+   HTS_movem(c0, v->c, m + 1);
+   for (i = 0; i <= m; i++)
+      v->cinc[i] = (c1[i] - v->c[i]) / v->fprd;
 
    for (j = 0; j < v->fprd; j++) {
       x = HTS_Vocoder_get_excitation(v, lpf);
@@ -946,7 +959,16 @@ void HTS_Vocoder_synthesize(HTS_Vocoder * v, size_t m, double lf0, double *spect
    }
 
    HTS_Vocoder_end_excitation(v, p);
-   HTS_movem(v->cc, v->c, m + 1);
+   HTS_movem(c1, v->c, m + 1);
+}
+
+/* HTS_Vocoder_synthesize: pulse/noise excitation and MLSA/MGLSA filster based waveform synthesis */
+void HTS_Vocoder_synthesize(HTS_Vocoder * v, size_t m, double lf0, double *spectrum, size_t nlpf, double *lpf, double alpha, double beta, double volume, double *rawdata, HTS_Audio * audio)
+{
+   if (v->is_first == TRUE)
+      HTS_Vocoder_convert_first_frame(v, m, spectrum, alpha, v->c);
+   HTS_Vocoder_convert_frame(v, m, spectrum, alpha, beta, v->cc);
+   HTS_Vocoder_filter(v, m, lf0, v->c, v->cc, nlpf, lpf, alpha, volume, rawdata, audio);
 }
 
 /* HTS_Vocoder_clear: clear vocoder */
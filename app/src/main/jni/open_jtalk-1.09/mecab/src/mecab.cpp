@@ -66,6 +66,8 @@ BOOL Mecab_initialize(Mecab *m){
   m->feature = NULL;
   m->size = 0;
   m->mecab = NULL;
+  m->lattice = NULL;
+  m->lattice_size = 0;
   return TRUE;
 }
 
@@ -102,8 +104,26 @@ BOOL Mecab_load(Mecab *m, const char *dicdir){
   return TRUE;
 }
 
+BOOL Mecab_load_from_model(Mecab *m, mecab_model_t *model){
+  if(m == NULL || model == NULL)
+    return FALSE;
+
+  if(m->mecab != NULL)
+    Mecab_clear(m);
+
+  /* the tagger refers to the dictionary of the model and does not own it */
+  m->mecab = mecab_model_new_tagger(model);
+
+  if(m->mecab == NULL){
+    fprintf(stderr,"ERROR: Mecab_load_from_model() in mecab.cpp: Cannot create tagger.\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
 BOOL Mecab_analysis(Mecab *m, const char *str){
   int i = 0;
+  size_t pos;
   mecab_node_t *head;
   mecab_node_t *node;
 
@@ -113,8 +133,19 @@ BOOL Mecab_analysis(Mecab *m, const char *str){
   if(m->size > 0 || m->feature != NULL)
     Mecab_refresh(m);
 
-  head = (mecab_node_t *) mecab_sparse_tonode(m->mecab, str);
+  /* parse on an own lattice so that its candidates can be counted */
+  if(m->lattice == NULL)
+    m->lattice = mecab_lattice_new();
+  if(m->lattice == NULL) return FALSE;
+  mecab_lattice_set_sentence(m->lattice, str);
+  if(!mecab_parse_lattice(m->mecab, m->lattice)) return FALSE;
+  head = mecab_lattice_get_bos_node(m->lattice);
   if(head == NULL) return FALSE;
+  m->lattice_size = 0;
+  for (pos = 0; pos < mecab_lattice_get_size(m->lattice); pos++) {
+    for (node = mecab_lattice_get_begin_nodes(m->lattice, pos); node != NULL; node = node->bnext)
+      m->lattice_size++;
+  }
   for (node = head; node != NULL; node = node->next) {
     if(node->stat != MECAB_BOS_NODE && node->stat != MECAB_EOS_NODE)
       m->size++;
@@ -145,6 +176,10 @@ int Mecab_get_size(Mecab *m){
   return m->size;
 }
 
+int Mecab_get_lattice_size(Mecab *m){
+  return m->lattice_size;
+}
+
 char **Mecab_get_feature(Mecab *m){
   return m->feature;
 }
@@ -159,6 +194,7 @@ BOOL Mecab_refresh(Mecab *m){
     m->feature = NULL;
     m->size = 0;
   }
+  m->lattice_size = 0;
 
   return TRUE;
 }
@@ -169,6 +205,10 @@ BOOL Mecab_clear(Mecab *m){
     mecab_destroy(m->mecab);
     m->mecab = NULL;
   }
+  if(m->lattice != NULL){
+    mecab_lattice_destroy(m->lattice);
+    m->lattice = NULL;
+  }
   return TRUE;
 }
 
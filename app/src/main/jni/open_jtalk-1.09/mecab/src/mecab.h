@@ -1585,13 +1585,17 @@ typedef struct _Mecab{
    char **feature;
    int size;
    mecab_t *mecab;
+   mecab_lattice_t *lattice;
+   int lattice_size;
 } Mecab;
 
 BOOL Mecab_initialize(Mecab *m);
 BOOL Mecab_load(Mecab *m, const char *dicdir);
+BOOL Mecab_load_from_model(Mecab *m, mecab_model_t *model);
 BOOL Mecab_analysis(Mecab *m, const char *str);
 BOOL Mecab_print(Mecab *m);
 int Mecab_get_size(Mecab *m);
+int Mecab_get_lattice_size(Mecab *m);
 char **Mecab_get_feature(Mecab *m);
 BOOL Mecab_refresh(Mecab *m);
 BOOL Mecab_clear(Mecab *m);
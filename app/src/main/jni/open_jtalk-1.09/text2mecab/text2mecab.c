@@ -92,12 +92,14 @@ static int strtopcmp(const char *str, const char *pattern)
    }
 }
 
-void text2mecab(char *output, const char *input)
+/* text2mecab_n: convert text into at most size bytes of output (including '\0') and return the length of the whole conversion */
+size_t text2mecab_n(char *output, size_t size, const char *input)
 {
    int i, j;
    const int length = strlen(input);
    const char *str;
-   int index = 0;
+   size_t index = 0;
+   size_t full = 0;
    int s, e = -1;
 
    for (s = 0; s < length;) {
@@ -112,11 +114,11 @@ void text2mecab(char *output, const char *input)
          /* convert */
          s += e;
          str = text2mecab_conv_list[i + 1];
-         for (j = 0; str[j] != '\0'; j++)
-            output[index++] = str[j];
+         e = strlen(str);
       } else if (text2mecab_control_range[0] <= str[0] && str[0] <= text2mecab_control_range[1]) {
          /* control character */
          s++;
+         continue;
       } else {
          /* multi byte character */
          e = -1;
@@ -126,17 +128,32 @@ void text2mecab(char *output, const char *input)
                break;
             }
          }
-         if (e > 0) {
-            for (j = 0; j < e; j++)
-               output[index++] = input[s++];
-         } else {
+         if (e <= 0 || s + e > length) {
             /* unknown */
             fprintf(stderr, "WARNING: text2mecab() in text2mecab.c: Wrong character.\n");
             s++;
+            continue;
          }
+         s += e;
       }
+      /* never split a character when the output is full */
+      if (full == 0 && index + e < size) {
+         for (j = 0; j < e; j++)
+            output[index + j] = str[j];
+      } else if (full == 0) {
+         full = index + 1;
+      }
+      index += e;
    }
-   output[index] = '\0';
+   if (size > 0)
+      output[full > 0 ? full - 1 : index] = '\0';
+   return index;
+}
+
+/* text2mecab: convert text without bounds (output must be large enough) */
+void text2mecab(char *output, const char *input)
+{
+   text2mecab_n(output, (size_t) -1, input);
 }
 
 TEXT2MECAB_C_END;
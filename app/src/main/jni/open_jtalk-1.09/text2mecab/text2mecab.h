@@ -51,8 +51,12 @@
 
 TEXT2MECAB_H_START;
 
+#include <stddef.h>
+
 void text2mecab(char *output, const char *input);
 
+size_t text2mecab_n(char *output, size_t size, const char *input);
+
 TEXT2MECAB_H_END;
 
 #endif                          /* !TEXT2MECAB_H */